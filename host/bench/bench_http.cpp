@@ -0,0 +1,114 @@
+//                  *****  HTTPRequest benchmarks  *****
+
+#include "bench_util.h"
+#include "httprequest.h"
+
+namespace
+{
+    //  Headers as sent by a desktop browser
+    const char browser_get[] =
+        "GET /status.html?sensor=attic&units=metric&range=24h&refresh=30 HTTP/1.1\r\n"
+        "Host: picow.local\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+        "Referer: http://picow.local/index.html\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; lang=en; last=%2Fstatus.html\r\n"
+        "\r\n";
+
+    const char browser_post[] =
+        "POST /config HTTP/1.1\r\n"
+        "Host: picow.local\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Length: 98\r\n"
+        "Origin: http://picow.local\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Referer: http://picow.local/config.html\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "\r\n"
+        "hostname=picow&ssid=Home+Network&password=s3cr%21t&tz=-5&dst=on&units=metric&refresh=30&led=on&x=1";
+
+    void HTTP_ParseGet(benchmark::State &state)
+    {
+        std::string rqst;
+        HTTPRequest http;
+        measure(state, [&]
+        {
+            rqst = browser_get;
+            http.parseRequest(rqst);
+            benchmark::DoNotOptimize(http.isComplete());
+        });
+    }
+    BENCHMARK(HTTP_ParseGet);
+
+    void HTTP_ParsePost(benchmark::State &state)
+    {
+        std::string rqst;
+        HTTPRequest http;
+        measure(state, [&]
+        {
+            rqst = browser_post;
+            http.parseRequest(rqst);
+            benchmark::DoNotOptimize(http.postValue("password"));
+        });
+    }
+    BENCHMARK(HTTP_ParsePost);
+
+    void HTTP_Header(benchmark::State &state)
+    {
+        std::string rqst = browser_get;
+        HTTPRequest http;
+        http.parseRequest(rqst);
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(http.header("Accept-Language"));
+            benchmark::DoNotOptimize(http.header("X-Not-Present"));
+        });
+    }
+    BENCHMARK(HTTP_Header);
+
+    void HTTP_Cookie(benchmark::State &state)
+    {
+        std::string rqst = browser_get;
+        HTTPRequest http;
+        http.parseRequest(rqst);
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(http.cookie("lang"));
+        });
+    }
+    BENCHMARK(HTTP_Cookie);
+
+    void HTTP_Query(benchmark::State &state)
+    {
+        std::string rqst = browser_get;
+        HTTPRequest http;
+        measure(state, [&]
+        {
+            //  Reset the URL so the query is parsed on each iteration
+            http.setURL("/status.html?sensor=attic&units=metric&range=24h&refresh=30");
+            benchmark::DoNotOptimize(http.query("range"));
+            benchmark::DoNotOptimize(http.query("refresh"));
+        });
+    }
+    BENCHMARK(HTTP_Query);
+
+    void HTTP_URIDecode(benchmark::State &state)
+    {
+        std::string uri;
+        for (int ii = 0; ii < state.range(0); ii++)
+        {
+            uri += ii % 4 == 0 ? "%2F" : ii % 4 == 1 ? "+" : "ab";
+        }
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(HTTPRequest::uri_decode(uri));
+        });
+    }
+    BENCHMARK(HTTP_URIDecode)->Arg(16)->Arg(256);
+}
@@ -0,0 +1,197 @@
+//                  *****  JSONMap benchmarks  *****
+
+#include "bench_util.h"
+#include "jsonmap.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char config[] =
+        "{\"hostname\":\"picow\",\"ssid\":\"Home Network\",\"password\":\"s3cr!t\","
+        "\"tz\":-5,\"dst\":true,\"units\":\"metric\",\"refresh\":30,\"led\":false,"
+        "\"latitude\":42.3601,\"longitude\":-71.0589,\"sensors\":[\"attic\",\"garage\",\"porch\"]}";
+
+    void JSON_LoadString(benchmark::State &state)
+    {
+        JSONMap map;
+        measure(state, [&]
+        {
+            map.loadString(config);
+            benchmark::DoNotOptimize(map.intValue("refresh"));
+        });
+    }
+    BENCHMARK(JSON_LoadString);
+
+    void JSON_LoadArena(benchmark::State &state)
+    {
+        static char storage[2048];
+        JSONArena arena(storage, sizeof(storage));
+        JSONMap map(arena);
+        measure(state, [&]
+        {
+            map.loadString(config);
+            benchmark::DoNotOptimize(map.intValue("refresh"));
+        });
+    }
+    BENCHMARK(JSON_LoadArena);
+
+    void JSON_LoadInPlace(benchmark::State &state)
+    {
+        static char storage[2048];
+        JSONArena arena(storage, sizeof(storage));
+        JSONMap map(arena);
+        char buffer[sizeof(config)];
+        measure(state, [&]
+        {
+            memcpy(buffer, config, sizeof(config));     // Stands in for a receive buffer
+            map.loadInPlace(buffer);
+            benchmark::DoNotOptimize(map.intValue("refresh"));
+        });
+    }
+    BENCHMARK(JSON_LoadInPlace);
+
+    void JSON_Lookup(benchmark::State &state)
+    {
+        JSONMap map(config);
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(map.strValue("units"));
+            benchmark::DoNotOptimize(map.realValue("longitude"));
+            benchmark::DoNotOptimize(map.boolValue("dst"));
+        });
+    }
+    BENCHMARK(JSON_Lookup);
+
+    //  A configuration object of 50 integer properties
+    struct Config
+    {
+        std::string                     json;
+        std::vector<std::string>        names;
+        std::vector<JSONSchema::Field>  fields;
+
+        Config()
+        {
+            json = "{";
+            for (int ii = 0; ii < 50; ii++)
+            {
+                names.push_back("setting_" + std::to_string(ii));
+                json += (ii > 0 ? ",\"" : "\"") + names.back() + "\":" + std::to_string(ii);
+            }
+            json += "}";
+            for (const std::string &name : names)
+            {
+                fields.push_back({ name.c_str(), JSONSchema::INTEGER });
+            }
+        }
+    };
+
+    void JSON_ConfigLookup(benchmark::State &state)
+    {
+        Config config;
+        JSONMap map(config.json.c_str());
+        measure(state, [&]
+        {
+            int sum = 0;
+            for (const std::string &name : config.names)
+            {
+                sum += map.intValue(name.c_str());
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+    }
+    BENCHMARK(JSON_ConfigLookup);
+
+    void JSON_ConfigDecode(benchmark::State &state)
+    {
+        Config config;
+        JSONMap map(config.json.c_str());
+        JSONSchema schema(config.fields.data(), config.fields.size());
+        JSONSchema::Value values[50];
+        measure(state, [&]
+        {
+            map.decode(schema, values);
+            int sum = 0;
+            for (int ii = 0; ii < 50; ii++)
+            {
+                sum += values[ii].intValue();
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+    }
+    BENCHMARK(JSON_ConfigDecode);
+
+    const char nested[] =
+        "{\"wifi\":{\"hostname\":\"picow\",\"ssid\":\"Home Network\",\"password\":\"s3cr!t\"},"
+        "\"clock\":{\"tz\":-5,\"dst\":true},\"display\":{\"units\":\"metric\",\"refresh\":30,\"led\":false},"
+        "\"ir\":{\"codes\":[{\"address\":1,\"command\":16},{\"address\":1,\"command\":17},{\"address\":2,\"command\":4}]}}";
+
+    void JSON_PathLookup(benchmark::State &state)
+    {
+        JSONMap map(nested);
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(map.strValue("/wifi/ssid"));
+            benchmark::DoNotOptimize(map.intValue("/display/refresh"));
+            benchmark::DoNotOptimize(map.intValue("/ir/codes/2/command"));
+        });
+    }
+    BENCHMARK(JSON_PathLookup);
+
+    void JSON_PathCached(benchmark::State &state)
+    {
+        static const JSONMap::Path ssid("/wifi/ssid");
+        static const JSONMap::Path refresh("/display/refresh");
+        static const JSONMap::Path command("/ir/codes/2/command");
+        JSONMap map(nested);
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(map.node(ssid).strValue());
+            benchmark::DoNotOptimize(map.node(refresh).intValue());
+            benchmark::DoNotOptimize(map.node(command).intValue());
+        });
+    }
+    BENCHMARK(JSON_PathCached);
+
+    void JSON_FromMap(benchmark::State &state)
+    {
+        JSONMap::JMAP jmap;
+        for (int ii = 0; ii < state.range(0); ii++)
+        {
+            jmap["key" + std::to_string(ii)] = "value " + std::to_string(ii);
+        }
+        std::string str;
+        measure(state, [&]
+        {
+            JSONMap::fromMap(jmap, str);
+            benchmark::DoNotOptimize(str.data());
+        });
+    }
+    BENCHMARK(JSON_FromMap)->Arg(4)->Arg(32);
+
+    //  The whole body is collected before it is parsed, as by the WEB body buffer
+    void JSON_LoadBatch(benchmark::State &state)
+    {
+        const std::string body = ir_batch(state.range(0));
+        const uint32_t segment = 1460;      // TCP segment size
+        measure(state, [&]
+        {
+            std::string rqst;
+            for (uint32_t pos = 0; pos < body.size(); pos += segment)
+            {
+                rqst.append(body.data() + pos, std::min<uint32_t>(segment, body.size() - pos));
+            }
+            JSONMap map(rqst.c_str());
+            long sum = 0;
+            for (JSONMap::Node code : map.node("/codes"))
+            {
+                sum += code.intValue("/command");
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+        state.SetBytesProcessed(state.iterations() * body.size());
+    }
+    BENCHMARK(JSON_LoadBatch)->Arg(16)->Arg(256);
+}
@@ -0,0 +1,56 @@
+//                  *****  JSONStream benchmarks  *****
+
+#include "bench_util.h"
+#include "json_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace
+{
+    //  Totals the command of each code, as a loader would queue them
+    class CommandSum : public JSONHandler
+    {
+    private:
+        bool    command_ = false;           // Next value is a command
+
+    public:
+        long    sum = 0;                    // Total of commands
+
+        bool key(const char *name, uint32_t len) override
+        {
+            command_ = len == 7 && memcmp(name, "command", 7) == 0;
+            return true;
+        }
+
+        bool number(const char *text, uint32_t /*len*/) override
+        {
+            if (command_)
+            {
+                sum += strtol(text, nullptr, 10);
+                command_ = false;
+            }
+            return true;
+        }
+    };
+
+    void JSON_StreamBatch(benchmark::State &state)
+    {
+        const std::string body = ir_batch(state.range(0));
+        const uint32_t segment = 1460;      // TCP segment size
+        measure(state, [&]
+        {
+            CommandSum sum;
+            JSONStream json(&sum);
+            for (uint32_t pos = 0; pos < body.size(); pos += segment)
+            {
+                json.feed(body.data() + pos, std::min<uint32_t>(segment, body.size() - pos));
+            }
+            json.finish();
+            benchmark::DoNotOptimize(sum.sum);
+        });
+        state.SetBytesProcessed(state.iterations() * body.size());
+    }
+    BENCHMARK(JSON_StreamBatch)->Arg(16)->Arg(256);
+}
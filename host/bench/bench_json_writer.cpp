@@ -0,0 +1,85 @@
+//                  *****  JSONWriter benchmarks  *****
+
+#include "bench_util.h"
+#include "json_writer.h"
+#include "txt.h"
+#include "ws.h"
+
+#include <string>
+
+namespace
+{
+    //  A state broadcast in the style of the application websocket messages
+    struct State
+    {
+        const char  *host;
+        double      temp;
+        double      humid;
+        int         uptime;
+        bool        heating;
+        const char  *zones[4];
+    };
+
+    const State state_data = { "picow", 21.25, 48.5, 183642, true, { "attic", "garage", "porch", "hall \"b\"" } };
+
+    void describe(JSONWriter &jw, const State &st)
+    {
+        jw.beginObject()
+          .property("host", st.host)
+          .property("temp", st.temp)
+          .property("humid", st.humid)
+          .property("uptime", st.uptime)
+          .property("heating", st.heating)
+          .key("zones").beginArray();
+        for (const char *zone : st.zones)
+        {
+            jw.value(zone);
+        }
+        jw.endArray().endObject();
+    }
+
+    void JSON_ConcatState(benchmark::State &state)
+    {
+        const State &st = state_data;
+        measure(state, [&]
+        {
+            std::string msg = std::string("{\"host\":\"") + st.host + "\",\"temp\":" + std::to_string(st.temp)
+                + ",\"humid\":" + std::to_string(st.humid) + ",\"uptime\":" + std::to_string(st.uptime)
+                + ",\"heating\":" + (st.heating ? "true" : "false") + ",\"zones\":[";
+            for (int ii = 0; ii < 4; ++ii)
+            {
+                msg += std::string(ii > 0 ? ",\"" : "\"") + st.zones[ii] + "\"";
+            }
+            msg += "]}";
+            benchmark::DoNotOptimize(msg.data());
+        });
+    }
+    BENCHMARK(JSON_ConcatState);
+
+    void JSON_WriterState(benchmark::State &state)
+    {
+        measure(state, [&]
+        {
+            JSONWriter count;
+            describe(count, state_data);
+            TXT msg(count.size() + 1, WS::HEADROOM);
+            JSONWriter jw(msg);
+            describe(jw, state_data);
+            benchmark::DoNotOptimize(msg.data());
+        });
+    }
+    BENCHMARK(JSON_WriterState);
+
+    void JSON_WriterBuffer(benchmark::State &state)
+    {
+        char buffer[256];
+        measure(state, [&]
+        {
+            JSONWriter jw(buffer, sizeof(buffer));
+            describe(jw, state_data);
+            jw.flush();
+            benchmark::DoNotOptimize(buffer);
+        });
+    }
+    BENCHMARK(JSON_WriterBuffer);
+}
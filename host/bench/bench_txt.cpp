@@ -0,0 +1,138 @@
+//                  *****  TXT benchmarks  *****
+
+#include "bench_util.h"
+#include "txt.h"
+#include "text_template.h"
+
+#include <string.h>
+
+namespace
+{
+    //  A page template in the style of the application web pages
+    const char page[] =
+        "<!DOCTYPE html><html><head><title>%TITLE%</title>"
+        "<link rel=\"stylesheet\" href=\"style.css\"></head><body>"
+        "<h1>%TITLE%</h1><table><tr><td>Temperature</td><td>%TEMP%</td></tr>"
+        "<tr><td>Humidity</td><td>%HUMID%</td></tr><tr><td>Uptime</td><td>%UPTIME%</td></tr>"
+        "</table><p>Host: %HOST% Address: %ADDR%</p><script src=\"websocket.js\"></script>"
+        "</body></html>";
+
+    void TXT_Append(benchmark::State &state)
+    {
+        std::string piece(state.range(0), 'x');
+        measure(state, [&]
+        {
+            TXT txt(2048);
+            for (int ii = 0; ii < 16; ii++)
+            {
+                txt += piece;
+            }
+            benchmark::DoNotOptimize(txt.data());
+        });
+    }
+    BENCHMARK(TXT_Append)->Arg(8)->Arg(64)->Arg(120);
+
+    void TXT_Insert(benchmark::State &state)
+    {
+        std::string piece(state.range(0), 'y');
+        measure(state, [&]
+        {
+            TXT txt(page, sizeof(page) - 1, 2048);
+            txt.insert(0, piece.c_str(), piece.size());
+            txt.insert(txt.datasize() / 2, piece.c_str(), piece.size());
+            txt.insert(txt.datasize(), piece.c_str(), piece.size());
+            benchmark::DoNotOptimize(txt.data());
+        });
+    }
+    BENCHMARK(TXT_Insert)->Arg(8)->Arg(256);
+
+    void TXT_Substitute(benchmark::State &state)
+    {
+        measure(state, [&]
+        {
+            TXT txt(page, sizeof(page) - 1, 2048);
+            txt.substitute("%TITLE%", "Weather station");
+            txt.substitute("%TITLE%", "Weather station");
+            txt.substitute("%TEMP%", 21);
+            txt.substitute("%HUMID%", 47);
+            txt.substitute("%UPTIME%", std::string("3 days 04:12:55"));
+            txt.substitute("%HOST%", "picow");
+            txt.substitute("%ADDR%", "192.168.1.42");
+            benchmark::DoNotOptimize(txt.data());
+        });
+    }
+    BENCHMARK(TXT_Substitute);
+
+    void TXT_SubstituteString(benchmark::State &state)
+    {
+        std::string target;
+        measure(state, [&]
+        {
+            target = page;
+            TXT::substitute(target, "%TITLE%", "Weather station");
+            TXT::substitute(target, "%TEMP%", 21);
+            TXT::substitute(target, "%HOST%", "picow");
+            benchmark::DoNotOptimize(target.data());
+        });
+    }
+    BENCHMARK(TXT_SubstituteString);
+
+    void TXT_Template(benchmark::State &state)
+    {
+        TextTemplate tmpl;
+        tmpl.compile(page, sizeof(page) - 1);
+        std::string values[] = { "Weather station", "21", "47", "3 days 04:12:55", "picow", "192.168.1.42" };
+        measure(state, [&]
+        {
+            uint32_t len;
+            char *text = tmpl.render(TextTemplate::array_provider, values, len);
+            benchmark::DoNotOptimize(text);
+            delete [] text;
+        });
+    }
+    BENCHMARK(TXT_Template);
+
+    void TXT_Find(benchmark::State &state)
+    {
+        TXT txt(page, sizeof(page) - 1);
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(txt.find("%ADDR%"));
+            benchmark::DoNotOptimize(txt.find("not present"));
+        });
+    }
+    BENCHMARK(TXT_Find);
+
+    void TXT_Split(benchmark::State &state)
+    {
+        std::string src;
+        for (int ii = 0; ii < state.range(0); ii++)
+        {
+            src += "token" + std::to_string(ii) + (ii % 3 == 0 ? ";" : ",");
+        }
+        std::vector<std::string> tokens;
+        measure(state, [&]
+        {
+            tokens.clear();
+            TXT::split(src, ",;", tokens);
+            benchmark::DoNotOptimize(tokens.data());
+        });
+    }
+    BENCHMARK(TXT_Split)->Arg(4)->Arg(32);
+
+    void TXT_SplitView(benchmark::State &state)
+    {
+        static constexpr TXT::Separators seps(",;");
+        std::string src;
+        for (int ii = 0; ii < state.range(0); ii++)
+        {
+            src += "token" + std::to_string(ii) + (ii % 3 == 0 ? ";" : ",");
+        }
+        std::string_view tokens[64];
+        measure(state, [&]
+        {
+            benchmark::DoNotOptimize(TXT::split(src, seps, tokens, 64));
+        });
+    }
+    BENCHMARK(TXT_SplitView)->Arg(4)->Arg(32);
+}
@@ -0,0 +1,60 @@
+//                  *****  Benchmark helpers  *****
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <benchmark/benchmark.h>
+#include "alloc_stats.h"
+#include <string>
+
+/**
+ * @brief   Run a benchmark loop counting heap allocations
+ * 
+ * @param   state   Benchmark state
+ * @param   op      Operation to be timed
+ * 
+ * Adds allocs/op and bytes/op counters to the report. Allocations made
+ * by the benchmark fixture before the loop are not counted.
+ */
+template <typename Op>
+void measure(benchmark::State &state, Op op)
+{
+    AllocStats::reset();
+    {
+        AllocStats::Scope count;
+        for (auto _ : state)
+        {
+            op();
+        }
+    }
+    const AllocStats::Counters &ac = AllocStats::counters();
+    state.counters["allocs/op"] = benchmark::Counter(ac.allocs, benchmark::Counter::kAvgIterations);
+    state.counters["bytes/op"] = benchmark::Counter(ac.bytes, benchmark::Counter::kAvgIterations);
+}
+
+/**
+ * @brief   Build a JSON upload of IR codes, as a batch command from a web page
+ * 
+ * @param   count   Number of codes
+ * 
+ * @return  {"codes":[{"name":"code0","protocol":"nec","address":4,"command":0,"raw":[...]},...]}
+ */
+inline std::string ir_batch(int count)
+{
+    std::string json = "{\"codes\":[";
+    for (int ii = 0; ii < count; ++ii)
+    {
+        json += ii == 0 ? "{" : ",{";
+        json += "\"name\":\"code" + std::to_string(ii) + "\",\"protocol\":\"nec\",\"address\":4,";
+        json += "\"command\":" + std::to_string(ii % 256) + ",\"raw\":[9000,4500";
+        for (int bit = 0; bit < 32; ++bit)
+        {
+            json += ((ii >> (bit & 7)) & 1) ? ",560,1690" : ",560,560";
+        }
+        json += ",560]}";
+    }
+    json += "]}";
+    return json;
+}
+
+#endif
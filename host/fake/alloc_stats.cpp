@@ -0,0 +1,129 @@
+//                  *****  Heap allocation statistics implementation  *****
+
+#include "alloc_stats.h"
+
+#include <new>
+#include <malloc.h>
+#include <stdlib.h>
+
+namespace
+{
+    AllocStats::Counters    counters_ = {};
+    bool                    counting_ = false;
+    std::size_t             live_ = 0;
+    std::size_t             peak_ = 0;
+
+    void *allocate(std::size_t size)
+    {
+        void *ptr = malloc(size > 0 ? size : 1);
+        if (ptr)
+        {
+            live_ += malloc_usable_size(ptr);
+            if (live_ > peak_)
+            {
+                peak_ = live_;
+            }
+            if (counting_)
+            {
+                counters_.allocs += 1;
+                counters_.bytes += size;
+            }
+        }
+        return ptr;
+    }
+
+    void deallocate(void *ptr)
+    {
+        if (ptr)
+        {
+            live_ -= malloc_usable_size(ptr);
+            if (counting_)
+            {
+                counters_.frees += 1;
+            }
+            free(ptr);
+        }
+    }
+}
+
+AllocStats::Scope::Scope(bool enable) : previous_(counting_)
+{
+    counting_ = enable;
+}
+
+AllocStats::Scope::~Scope()
+{
+    counting_ = previous_;
+}
+
+const AllocStats::Counters &AllocStats::counters()
+{
+    return counters_;
+}
+
+void AllocStats::reset()
+{
+    counters_ = Counters();
+}
+
+std::size_t AllocStats::live_bytes()
+{
+    return live_;
+}
+
+std::size_t AllocStats::peak_bytes()
+{
+    return peak_;
+}
+
+void AllocStats::reset_peak()
+{
+    peak_ = live_;
+}
+
+//  ***** Global operator new / delete replacements *****
+
+void *operator new(std::size_t size)
+{
+    void *ptr = allocate(size);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    deallocate(ptr);
+}
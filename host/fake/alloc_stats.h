@@ -0,0 +1,53 @@
+//                  *****  Heap allocation statistics for host builds  *****
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stdint.h>
+#include <cstddef>
+
+/**
+ * @namespace   AllocStats
+ * 
+ * Counts heap allocations made through the global operator new, which
+ * this module replaces when linked into a host program. Allocations are
+ * counted only while a Scope enabling counting is active so harness
+ * allocations can be excluded. Live and peak heap bytes are tracked
+ * for the whole process.
+ */
+namespace AllocStats
+{
+    /**
+     * @brief   Counters for allocations made while counting is enabled
+     */
+    struct Counters
+    {
+        uint64_t    allocs;                 // Number of allocations
+        uint64_t    bytes;                  // Bytes requested
+        uint64_t    frees;                  // Number of deallocations
+    };
+
+    /**
+     * @class   Scope
+     * 
+     * Enables (or suspends) counting until the object is destroyed
+     */
+    class Scope
+    {
+    private:
+        bool    previous_;                  // Counting state on entry
+
+    public:
+        explicit Scope(bool enable = true);
+        ~Scope();
+    };
+
+    const Counters &counters();
+    void reset();
+
+    std::size_t live_bytes();
+    std::size_t peak_bytes();
+    void reset_peak();
+}
+
+#endif
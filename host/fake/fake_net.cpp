@@ -0,0 +1,638 @@
+//                  *****  Fake network implementation  *****
+
+#include "fake_net.h"
+#include "fake_lwip.h"
+#include "alloc_stats.h"
+#include "pico/time.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <random>
+#include <vector>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+extern "C"
+{
+#include "dhcpserver.h"
+}
+
+namespace
+{
+    struct Segment
+    {
+        std::string     data;               // Segment data (empty for close)
+        uint64_t        due;                // Delivery time
+        bool            fin;                // Close from client
+    };
+
+    struct Ack
+    {
+        u16_t           len;                // Bytes acknowledged
+        uint64_t        due;                // Acknowledge time
+    };
+
+    struct Conn
+    {
+        struct altcp_pcb    *pcb;           // Server side pcb
+        std::deque<Segment> inbound;        // Segments to server
+        std::deque<Ack>     acks;           // Pending acknowledgements
+        std::string         outbound;       // Data received from server
+        uint32_t            unacked;        // Bytes written but not acknowledged
+        uint64_t            next_poll;      // Time of next poll callback
+        uint64_t            last_due;       // Due time of last queued segment
+        bool                server_closed;  // Server closed connection
+        bool                client_closed;  // Client closed connection
+    };
+
+    struct Timer
+    {
+        repeating_timer_t   *rt;            // Repeating timer (null for alarm)
+        alarm_callback_t    alarm;          // Alarm callback
+        void                *user_data;     // Alarm data
+        uint64_t            due;            // Next time
+        alarm_id_t          id;             // Alarm id
+    };
+
+    FakeNet::Options                        opts_;
+    FakeNet::Stats                          stats_;
+    uint64_t                                now_ = 1000000;
+    std::mt19937                            rng_(1);
+    std::map<u16_t, struct altcp_pcb *>     listeners_;
+    std::vector<Conn *>                     conns_;
+    std::list<struct altcp_pcb *>           pcbs_;
+    std::list<Timer>                        timers_;
+    alarm_id_t                              next_alarm_ = 1;
+    u16_t                                   bind_port_ = 0;
+    int                                     lock_depth_ = 0;
+
+    struct altcp_pcb *new_pcb()
+    {
+        AllocStats::Scope pause(false);
+        struct altcp_pcb *pcb = new altcp_pcb();
+        pcb->inner_conn = pcb;
+        pcb->state = new tcp_pcb();
+        pcbs_.push_back(pcb);
+        return pcb;
+    }
+
+    Conn *conn_of(struct altcp_pcb *pcb)
+    {
+        return pcb ? static_cast<Conn *>(pcb->fake) : nullptr;
+    }
+
+    struct pbuf *make_chain(const std::string &data)
+    {
+        u16_t chunk = opts_.pbuf_size > 0 ? opts_.pbuf_size : static_cast<u16_t>(data.size());
+        struct pbuf *head = nullptr;
+        struct pbuf **tail = &head;
+        std::size_t off = 0;
+        while (off < data.size())
+        {
+            u16_t ll = static_cast<u16_t>(std::min<std::size_t>(chunk, data.size() - off));
+            struct pbuf *p = new pbuf();
+            char *buf = new char[ll];
+            memcpy(buf, data.data() + off, ll);
+            p->payload = buf;
+            p->len = ll;
+            p->tot_len = static_cast<u16_t>(data.size() - off);
+            *tail = p;
+            tail = &p->next;
+            off += ll;
+        }
+        return head;
+    }
+
+    void deliver(Conn *c)
+    {
+        while (!c->inbound.empty() && c->inbound.front().due <= now_ && !c->server_closed)
+        {
+            Segment seg = c->inbound.front();
+            c->inbound.pop_front();
+            struct altcp_pcb *pcb = c->pcb;
+            AllocStats::Scope count;
+            if (seg.fin)
+            {
+                c->client_closed = true;
+                if (pcb->recv)
+                {
+                    pcb->recv(pcb->arg, pcb, nullptr, ERR_OK);
+                }
+            }
+            else if (pcb->recv)
+            {
+                stats_.bytes_in += seg.data.size();
+                stats_.segments_in += 1;
+                struct pbuf *p;
+                {
+                    AllocStats::Scope pause(false);
+                    p = make_chain(seg.data);
+                }
+                pcb->recv(pcb->arg, pcb, p, ERR_OK);
+            }
+        }
+    }
+
+    void acknowledge(Conn *c)
+    {
+        while (!c->acks.empty() && c->acks.front().due <= now_)
+        {
+            Ack ack = c->acks.front();
+            c->acks.pop_front();
+            c->unacked -= ack.len;
+            struct altcp_pcb *pcb = c->pcb;
+            if (!c->server_closed && pcb->sent)
+            {
+                AllocStats::Scope count;
+                pcb->sent(pcb->arg, pcb, ack.len);
+            }
+        }
+    }
+
+    void poll(Conn *c)
+    {
+        if (!c->server_closed && c->pcb->poll && c->pcb->pollinterval > 0 && now_ >= c->next_poll)
+        {
+            c->next_poll = now_ + c->pcb->pollinterval * 500000ULL;
+            AllocStats::Scope count;
+            c->pcb->poll(c->pcb->arg, c->pcb);
+        }
+    }
+
+    void fire_timers()
+    {
+        AllocStats::Scope count;
+        for (auto it = timers_.begin(); it != timers_.end(); )
+        {
+            if (it->due <= now_)
+            {
+                if (it->rt)
+                {
+                    if (it->rt->active && it->rt->callback(it->rt))
+                    {
+                        it->due += it->rt->delay_us;
+                        ++it;
+                    }
+                    else
+                    {
+                        it = timers_.erase(it);
+                    }
+                }
+                else
+                {
+                    Timer t = *it;
+                    it = timers_.erase(it);
+                    int64_t again = t.alarm(t.id, t.user_data);
+                    if (again > 0)
+                    {
+                        t.due = now_ + again;
+                        timers_.push_back(t);
+                    }
+                }
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
+
+//  ***** FakeNet control interface *****
+
+void FakeNet::configure(const Options &opts)
+{
+    opts_ = opts;
+    rng_.seed(opts_.seed);
+}
+
+const FakeNet::Options &FakeNet::options()
+{
+    return opts_;
+}
+
+void FakeNet::reset()
+{
+    for (auto it = conns_.begin(); it != conns_.end(); ++it)
+    {
+        delete *it;
+    }
+    conns_.clear();
+    stats_ = Stats();
+}
+
+int FakeNet::connect(uint16_t port)
+{
+    auto it = listeners_.find(port);
+    if (it == listeners_.end() || !it->second->accept)
+    {
+        return -1;
+    }
+    Conn *c = new Conn();
+    c->pcb = new_pcb();
+    c->pcb->fake = c;
+    c->pcb->port = port;
+    c->next_poll = now_;
+    conns_.push_back(c);
+    stats_.connections += 1;
+    AllocStats::Scope count;
+    it->second->accept(it->second->arg, c->pcb, ERR_OK);
+    return static_cast<int>(conns_.size() - 1);
+}
+
+void FakeNet::send(int conn, const void *data, size_t len)
+{
+    Conn *c = conns_.at(conn);
+    const char *cp = static_cast<const char *>(data);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    while (len > 0)
+    {
+        std::size_t ll = std::min<std::size_t>(len, opts_.segment);
+        Segment seg;
+        seg.data.assign(cp, ll);
+        seg.fin = false;
+        seg.due = now_ + opts_.latency_us;
+        if (opts_.loss > 0.0 && dist(rng_) < opts_.loss)
+        {
+            seg.due += opts_.rto_us;
+            stats_.segments_lost += 1;
+        }
+        if (seg.due < c->last_due) seg.due = c->last_due;
+        c->last_due = seg.due;
+        c->inbound.push_back(seg);
+        cp += ll;
+        len -= ll;
+    }
+}
+
+void FakeNet::send(int conn, const std::string &data)
+{
+    send(conn, data.data(), data.size());
+}
+
+void FakeNet::close(int conn)
+{
+    Conn *c = conns_.at(conn);
+    Segment seg;
+    seg.fin = true;
+    seg.due = std::max(now_ + opts_.latency_us, c->last_due);
+    c->inbound.push_back(seg);
+}
+
+std::string &FakeNet::received(int conn)
+{
+    return conns_.at(conn)->outbound;
+}
+
+bool FakeNet::is_closed(int conn)
+{
+    return conns_.at(conn)->server_closed;
+}
+
+void FakeNet::run()
+{
+    for (std::size_t ii = 0; ii < conns_.size(); ii++)
+    {
+        deliver(conns_[ii]);
+        acknowledge(conns_[ii]);
+        poll(conns_[ii]);
+    }
+    fire_timers();
+}
+
+void FakeNet::advance(uint64_t us)
+{
+    uint64_t end = now_ + us;
+    while (now_ < end)
+    {
+        uint64_t step = std::min<uint64_t>(end - now_, opts_.latency_us > 0 ? opts_.latency_us : 100);
+        now_ += step;
+        run();
+    }
+}
+
+uint64_t FakeNet::now()
+{
+    return now_;
+}
+
+FakeNet::Stats &FakeNet::stats()
+{
+    return stats_;
+}
+
+int FakeNet::lock_depth()
+{
+    return lock_depth_;
+}
+
+//  ***** lwIP / altcp stand-in *****
+
+const ip_addr_t ip_addr_any = {0};
+cyw43_t cyw43_state;
+
+const char *ip4addr_ntoa(const ip4_addr_t *addr)
+{
+    static char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr->addr & 0xff, (addr->addr >> 8) & 0xff,
+             (addr->addr >> 16) & 0xff, (addr->addr >> 24) & 0xff);
+    return buf;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+    u16_t copied = 0;
+    char *dst = static_cast<char *>(dataptr);
+    for (const struct pbuf *q = p; q && len > 0; q = q->next)
+    {
+        if (offset >= q->len)
+        {
+            offset -= q->len;
+            continue;
+        }
+        u16_t ll = std::min<u16_t>(q->len - offset, len);
+        memcpy(dst, static_cast<const char *>(q->payload) + offset, ll);
+        dst += ll;
+        copied += ll;
+        len -= ll;
+        offset = 0;
+    }
+    stats_.copy_bytes += copied;
+    return copied;
+}
+
+u8_t pbuf_free(struct pbuf *p)
+{
+    AllocStats::Scope pause(false);
+    u8_t count = 0;
+    while (p)
+    {
+        struct pbuf *next = p->next;
+        delete [] static_cast<char *>(p->payload);
+        delete p;
+        p = next;
+        ++count;
+    }
+    return count;
+}
+
+struct altcp_pcb *altcp_tcp_alloc(void *arg, u8_t ip_type)
+{
+    return new_pcb();
+}
+
+struct altcp_pcb *altcp_tls_alloc(void *arg, u8_t ip_type)
+{
+    return new_pcb();
+}
+
+struct altcp_pcb *altcp_new_ip_type(altcp_allocator_t *allocator, u8_t ip_type)
+{
+    return allocator->alloc(allocator->arg, ip_type);
+}
+
+err_t altcp_bind(struct altcp_pcb *conn, const ip_addr_t *ipaddr, u16_t port)
+{
+    bind_port_ = port;
+    conn->port = port;
+    return ERR_OK;
+}
+
+struct altcp_pcb *altcp_listen_with_backlog(struct altcp_pcb *conn, u8_t backlog)
+{
+    listeners_[bind_port_] = conn;
+    return conn;
+}
+
+void altcp_arg(struct altcp_pcb *conn, void *arg)           { conn->arg = arg; }
+void altcp_accept(struct altcp_pcb *conn, altcp_accept_fn fn){ conn->accept = fn; }
+void altcp_recv(struct altcp_pcb *conn, altcp_recv_fn fn)   { conn->recv = fn; }
+void altcp_sent(struct altcp_pcb *conn, altcp_sent_fn fn)   { conn->sent = fn; }
+void altcp_err(struct altcp_pcb *conn, altcp_err_fn fn)     { conn->err = fn; }
+void altcp_recved(struct altcp_pcb *conn, u16_t len)        {}
+err_t altcp_output(struct altcp_pcb *conn)                  { return ERR_OK; }
+u16_t altcp_get_port(struct altcp_pcb *conn, int local)     { return local ? conn->port : 0; }
+
+void altcp_poll(struct altcp_pcb *conn, altcp_poll_fn fn, u8_t interval)
+{
+    conn->poll = fn;
+    conn->pollinterval = interval;
+}
+
+err_t altcp_close(struct altcp_pcb *conn)
+{
+    Conn *c = conn_of(conn);
+    if (c)
+    {
+        c->server_closed = true;
+    }
+    else
+    {
+        for (auto it = listeners_.begin(); it != listeners_.end(); ++it)
+        {
+            if (it->second == conn)
+            {
+                listeners_.erase(it);
+                break;
+            }
+        }
+    }
+    conn->recv = nullptr;
+    conn->sent = nullptr;
+    conn->poll = nullptr;
+    conn->err = nullptr;
+    conn->accept = nullptr;
+    return ERR_OK;
+}
+
+u16_t altcp_sndbuf(struct altcp_pcb *conn)
+{
+    Conn *c = conn_of(conn);
+    if (!c || c->server_closed) return 0;
+    return c->unacked < opts_.window ? opts_.window - c->unacked : 0;
+}
+
+err_t altcp_write(struct altcp_pcb *conn, const void *dataptr, u16_t len, u8_t apiflags)
+{
+    Conn *c = conn_of(conn);
+    if (!c || c->server_closed)
+    {
+        return ERR_CONN;
+    }
+    if (len > altcp_sndbuf(conn))
+    {
+        stats_.write_errors += 1;
+        return ERR_MEM;
+    }
+    if (apiflags & TCP_WRITE_FLAG_COPY)
+    {
+        stats_.write_copy_bytes += len;
+    }
+    AllocStats::Scope pause(false);
+    c->outbound.append(static_cast<const char *>(dataptr), len);
+    c->unacked += len;
+    stats_.bytes_out += len;
+    Ack ack = {len, now_ + 2 * opts_.latency_us};
+    c->acks.push_back(ack);
+    return ERR_OK;
+}
+
+struct altcp_tls_config *altcp_tls_create_config_server_privkey_cert(const u8_t *, size_t, const u8_t *, size_t, const u8_t *, size_t)
+{
+    return nullptr;
+}
+
+void altcp_tls_free_config(struct altcp_tls_config *conf) {}
+
+void mdns_resp_init(void) {}
+err_t mdns_resp_add_netif(struct netif *netif, const char *hostname) { return ERR_OK; }
+err_t mdns_resp_remove_netif(struct netif *netif) { return ERR_OK; }
+void mdns_resp_announce(struct netif *netif) {}
+
+//  ***** cyw43 stand-in *****
+
+void cyw43_arch_enable_sta_mode(void) {}
+void cyw43_arch_enable_ap_mode(const char *ssid, const char *password, uint32_t auth) {}
+void cyw43_arch_disable_ap_mode(void) {}
+int  cyw43_arch_wifi_connect_async(const char *ssid, const char *pw, uint32_t auth) { return 0; }
+void cyw43_arch_lwip_begin(void) { ++lock_depth_; }
+void cyw43_arch_lwip_end(void) { assert(lock_depth_ > 0); --lock_depth_; }
+void cyw43_arch_gpio_put(unsigned int wl_gpio, bool value) {}
+bool cyw43_arch_gpio_get(unsigned int wl_gpio) { return true; }
+int  cyw43_wifi_pm(cyw43_t *self, uint32_t pm) { return 0; }
+int  cyw43_wifi_get_pm(cyw43_t *self, uint32_t *pm) { *pm = 0; return 0; }
+int  cyw43_wifi_leave(cyw43_t *self, int itf) { return 0; }
+int  cyw43_tcpip_link_status(cyw43_t *self, int itf) { return CYW43_LINK_UP; }
+
+int cyw43_wifi_scan(cyw43_t *self, cyw43_wifi_scan_options_t *opts, void *env,
+                    int (*result_cb)(void *, const cyw43_ev_scan_result_t *))
+{
+    cyw43_ev_scan_result_t rslt = {};
+    rslt.ssid_len = 7;
+    memcpy(rslt.ssid, "hostnet", 7);
+    rslt.rssi = -40;
+    result_cb(env, &rslt);
+    return 0;
+}
+
+bool cyw43_wifi_scan_active(cyw43_t *self) { return false; }
+
+void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm) {}
+void dhcp_server_deinit(dhcp_server_t *d) {}
+
+//  ***** pico time stand-in *****
+
+uint64_t time_us_64(void)
+{
+    return now_;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out)
+{
+    out->delay_us = (delay_ms < 0 ? -delay_ms : delay_ms) * 1000LL;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->active = true;
+    Timer t = {out, nullptr, nullptr, now_ + out->delay_us, 0};
+    timers_.push_back(t);
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+    timer->active = false;
+    return true;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    Timer t = {nullptr, callback, user_data, now_ + ms * 1000ULL, next_alarm_++};
+    timers_.push_back(t);
+    return t.id;
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    for (auto it = timers_.begin(); it != timers_.end(); ++it)
+    {
+        if (!it->rt && it->id == alarm_id)
+        {
+            timers_.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void sleep_ms(uint32_t ms) { FakeNet::advance(ms * 1000ULL); }
+void sleep_us(uint64_t us) { FakeNet::advance(us); }
+
+//  ***** mbedtls stand-in (SHA-1 and base64 for the websocket handshake) *****
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::vector<unsigned char> msg(input, input + ilen);
+    uint64_t bits = static_cast<uint64_t>(ilen) * 8;
+    msg.push_back(0x80);
+    while (msg.size() % 64 != 56) msg.push_back(0);
+    for (int ii = 7; ii >= 0; ii--) msg.push_back(static_cast<unsigned char>(bits >> (ii * 8)));
+
+    for (std::size_t blk = 0; blk < msg.size(); blk += 64)
+    {
+        uint32_t w[80];
+        for (int ii = 0; ii < 16; ii++)
+        {
+            w[ii] = msg[blk + ii * 4] << 24 | msg[blk + ii * 4 + 1] << 16 | msg[blk + ii * 4 + 2] << 8 | msg[blk + ii * 4 + 3];
+        }
+        for (int ii = 16; ii < 80; ii++)
+        {
+            uint32_t v = w[ii - 3] ^ w[ii - 8] ^ w[ii - 14] ^ w[ii - 16];
+            w[ii] = (v << 1) | (v >> 31);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int ii = 0; ii < 80; ii++)
+        {
+            uint32_t f, k;
+            if (ii < 20)      { f = (b & c) | (~b & d);           k = 0x5A827999; }
+            else if (ii < 40) { f = b ^ c ^ d;                    k = 0x6ED9EBA1; }
+            else if (ii < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC; }
+            else              { f = b ^ c ^ d;                    k = 0xCA62C1D6; }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[ii];
+            e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int ii = 0; ii < 20; ii++)
+    {
+        output[ii] = static_cast<unsigned char>(h[ii / 4] >> (24 - (ii % 4) * 8));
+    }
+    return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::size_t need = (slen + 2) / 3 * 4;
+    *olen = need;
+    if (dlen < need + 1)
+    {
+        return -0x002A;
+    }
+    std::size_t jj = 0;
+    for (std::size_t ii = 0; ii < slen; ii += 3)
+    {
+        uint32_t v = src[ii] << 16 | (ii + 1 < slen ? src[ii + 1] << 8 : 0) | (ii + 2 < slen ? src[ii + 2] : 0);
+        dst[jj++] = tbl[(v >> 18) & 0x3f];
+        dst[jj++] = tbl[(v >> 12) & 0x3f];
+        dst[jj++] = ii + 1 < slen ? tbl[(v >> 6) & 0x3f] : '=';
+        dst[jj++] = ii + 2 < slen ? tbl[v & 0x3f] : '=';
+    }
+    dst[jj] = 0;
+    return 0;
+}
+
+void mbedtls_debug_set_threshold(int threshold) {}
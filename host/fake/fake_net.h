@@ -0,0 +1,110 @@
+//                  *****  Fake network for host builds  *****
+
+#ifndef FAKE_NET_H
+#define FAKE_NET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/**
+ * @namespace   FakeNet
+ * 
+ * Drives the host stand-in for the altcp/pbuf layer. Simulated clients
+ * connect to the listening pcbs created by the WEB class and exchange
+ * data in segments. Time is simulated: nothing happens until run() or
+ * advance() is called.
+ */
+namespace FakeNet
+{
+    /**
+     * @brief   Network simulation options
+     */
+    struct Options
+    {
+        uint16_t    segment = 536;          // Maximum bytes per received segment
+        uint16_t    pbuf_size = 0;          // Bytes per pbuf in chain (0 = one pbuf per segment)
+        double      loss = 0.0;             // Probability a segment is lost and retransmitted
+        uint32_t    rto_us = 200000;        // Retransmission delay for a lost segment
+        uint32_t    latency_us = 500;       // One way delivery latency
+        uint16_t    window = 4 * 1460;      // Send window (altcp_sndbuf)
+        uint32_t    seed = 1;               // Random seed for loss
+    };
+
+    /**
+     * @brief   Counters collected by the simulation
+     */
+    struct Stats
+    {
+        uint64_t    bytes_in;               // Bytes delivered to the server
+        uint64_t    bytes_out;              // Bytes written by the server
+        uint64_t    segments_in;            // Segments delivered to the server
+        uint64_t    segments_lost;          // Segments retransmitted
+        uint64_t    copy_bytes;             // Bytes copied out of pbufs by the server
+        uint64_t    write_copy_bytes;       // Bytes written with TCP_WRITE_FLAG_COPY
+        uint64_t    write_errors;           // altcp_write calls refused for lack of window
+        uint64_t    connections;            // Connections accepted
+    };
+
+    /**
+     * @brief   Set simulation options (call before connecting)
+     */
+    void configure(const Options &opts);
+    const Options &options();
+
+    /**
+     * @brief   Drop all connections and timers and clear the counters
+     */
+    void reset();
+
+    /**
+     * @brief   Open a client connection to a listening port
+     * 
+     * @return  Connection number or -1 if nothing is listening
+     */
+    int  connect(uint16_t port);
+
+    /**
+     * @brief   Queue data from a client. It is delivered in segments by run().
+     */
+    void send(int conn, const void *data, size_t len);
+    void send(int conn, const std::string &data);
+
+    /**
+     * @brief   Close a client connection
+     */
+    void close(int conn);
+
+    /**
+     * @brief   Return the data written by the server to a connection
+     * 
+     * The client may erase data it has consumed.
+     */
+    std::string &received(int conn);
+
+    /**
+     * @brief   Return true if the server has closed a connection
+     */
+    bool is_closed(int conn);
+
+    /**
+     * @brief   Deliver the segments, acknowledgements, polls and timers that
+     *          are due at the current simulated time
+     */
+    void run();
+
+    /**
+     * @brief   Advance simulated time, firing polls and timers
+     */
+    void advance(uint64_t us);
+    uint64_t now();
+
+    Stats &stats();
+
+    /**
+     * @brief   Return the cyw43_arch_lwip_begin nesting depth (0 when balanced)
+     */
+    int lock_depth();
+}
+
+#endif
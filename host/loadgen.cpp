@@ -0,0 +1,579 @@
+//                  *****  Host load generator for the WEB server  *****
+
+#include "web.h"
+#include "ws.h"
+#include "fake_net.h"
+#include "multipart.h"
+#include "alloc_stats.h"
+#include "dbgflag.h"
+#include "trace.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define STATIC_BODY "<html><body><h1>Static test page</h1></body></html>"
+
+namespace
+{
+    struct Config
+    {
+        int         clients = 8;            // Simulated HTTP clients
+        int         ws_clients = 2;         // Simulated websocket clients
+        int         requests = 200;         // Requests (or messages) per client
+        std::size_t payload = 64;           // POST body and websocket message size
+        uint64_t    timeout_us = 10000000;  // Simulated time limit per request
+        bool        verbose = false;        // Print each response
+        const char  *metrics = nullptr;     // Print server metrics (query string)
+        int         debug = 0;              // Server debug level
+        bool        deferred = false;       // Deferred server logging
+    };
+
+    const char static_page[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/html\r\n"
+        "Content-Length: 51\r\n"
+        "\r\n"
+        STATIC_BODY;
+
+    struct Client
+    {
+        int         conn;                   // FakeNet connection
+        bool        ws;                     // Websocket client
+        bool        upgraded;               // Websocket handshake complete
+        bool        waiting;                // Waiting for a response
+        int         sent;                   // Requests or messages sent
+        int         done;                   // Responses received
+        uint64_t    started;                // Simulated time request was sent
+        std::string expect;                 // Expected response body or message
+    };
+
+    //  A deferred response and the simulated time it is completed
+    struct Deferred
+    {
+        DeferHandle handle;                 // Deferred response
+        uint64_t    due;                    // Time to complete
+        std::string body;                   // Response body
+    };
+
+    Config      cfg_;
+    int         errors_ = 0;
+    std::map<ClientHandle, std::string> uploads_;   // Multipart file data by client
+    std::vector<Deferred> deferred_;        // Pending deferred responses
+
+    //  ***** Server side *****
+
+    bool http_cb(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close, void *udata)
+    {
+        close = false;
+        std::string_view path = rqst.pathView();
+        if (path == "/static")
+        {
+            return web->send_data(client, static_page, sizeof(static_page) - 1, WEB::STAT);
+        }
+        std::string body;
+        if (path == "/echo")
+        {
+            body.assign(rqst.body(), rqst.bodySize());
+        }
+        else if (path == "/form")
+        {
+            const char *value = rqst.postValue("v");
+            const char *num = rqst.postValue("n");
+            body = std::string(value ? value : "") + "#" + (num ? num : "");
+        }
+        else if (path == "/upload")
+        {
+            body = uploads_[client];
+            uploads_.erase(client);
+        }
+        else if (path == "/defer")
+        {
+            DeferHandle handle = web->defer_response(client);
+            std::string_view query = rqst.urlView().substr(rqst.urlView().find('=') + 1);
+            deferred_.push_back({ handle, FakeNet::now() + 20000, "deferred " + std::string(query) });
+            return handle != 0;
+        }
+        else if (path == "/query")
+        {
+            body = "{";
+            for (const FormFields::Field &fld : rqst.queryFields())
+            {
+                if (body.size() > 1)
+                {
+                    body += ",";
+                }
+                body += "\"";
+                body += fld.key;
+                body += "\":\"";
+                body += fld.value;
+                body += "\"";
+            }
+            body += "}";
+        }
+        else
+        {
+            return false;
+        }
+        std::string resp = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        return web->send_data(client, resp.c_str(), resp.size());
+    }
+
+    void message_cb(WEB *web, ClientHandle client, const std::string &msg, void *udata)
+    {
+        web->send_message(client, msg);
+    }
+
+    //  Collects the file part of an upload for the HTTP callback
+    class UploadSink : public MultipartSink
+    {
+    private:
+        ClientHandle    client_;            // Client uploading
+        std::string     data_;              // File data
+        bool            file_;              // Current part is the file
+
+    public:
+        UploadSink(ClientHandle client) : client_(client), file_(false) {}
+
+        bool part_begin(const std::string &name, const std::string &, const std::string &) override
+        {
+            file_ = name == "file";
+            return true;
+        }
+
+        bool part_data(const char *data, std::size_t len) override
+        {
+            if (file_)
+            {
+                data_.append(data, len);
+            }
+            return true;
+        }
+
+        bool part_end() override
+        {
+            return true;
+        }
+
+        void finish(bool ok) override
+        {
+            if (ok)
+            {
+                uploads_[client_] = data_;
+            }
+            delete this;
+        }
+    };
+
+    HTTPBodySink *body_cb(WEB *, ClientHandle client, HTTPRequest &rqst, void *)
+    {
+        if (rqst.pathView() == "/upload")
+        {
+            return MultipartParser::create(rqst, new UploadSink(client));
+        }
+        return nullptr;
+    }
+
+    void complete_deferred(WEB *web)
+    {
+        for (auto it = deferred_.begin(); it != deferred_.end(); )
+        {
+            if (FakeNet::now() >= it->due)
+            {
+                std::string resp = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(it->body.size()) + "\r\n\r\n" + it->body;
+                web->complete_response(it->handle, resp.c_str(), resp.size(), WEB::ALLOC, false);
+                it = deferred_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    //  ***** Client side *****
+
+    std::string make_payload(int seed)
+    {
+        std::string ret;
+        ret.reserve(cfg_.payload);
+        for (std::size_t ii = 0; ii < cfg_.payload; ii++)
+        {
+            ret += 'a' + (ii + seed) % 26;
+        }
+        return ret;
+    }
+
+    void send_request(Client &cl)
+    {
+        std::string rqst;
+        switch (cl.sent % 6)
+        {
+        case 0:
+            rqst = "GET /static HTTP/1.1\r\nHost: pico\r\n\r\n";
+            cl.expect = STATIC_BODY;
+            break;
+
+        case 1:
+            rqst = "GET /query?n=" + std::to_string(cl.sent) + "&name=pico+w&t=a%20b HTTP/1.1\r\nHost: pico\r\n\r\n";
+            cl.expect = "{\"n\":\"" + std::to_string(cl.sent) + "\",\"name\":\"pico w\",\"t\":\"a b\"}";
+            break;
+
+        case 2:
+            cl.expect = make_payload(cl.sent);
+            rqst = "POST /echo HTTP/1.1\r\nHost: pico\r\nContent-Type: text/plain\r\nContent-Length: "
+                 + std::to_string(cl.expect.size()) + "\r\n\r\n" + cl.expect;
+            break;
+
+        case 3:
+        {
+            //  Chunked form, decoded into the request by WEB
+            std::string payload = make_payload(cl.sent);
+            std::string body = "v=" + payload + "&n=" + std::to_string(cl.sent);
+            cl.expect = payload + "#" + std::to_string(cl.sent);
+            rqst = "POST /form HTTP/1.1\r\nHost: pico\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                   "Transfer-Encoding: chunked\r\n\r\n";
+            for (std::size_t pos = 0; pos < body.size(); pos += 16)
+            {
+                char size[8];
+                std::string piece = body.substr(pos, 16);
+                snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+                rqst += size + piece + "\r\n";
+            }
+            rqst += "0\r\n\r\n";
+            break;
+        }
+
+        case 4:
+        {
+            //  Multipart upload, streamed to a MultipartParser
+            cl.expect = make_payload(cl.sent);
+            std::string body = "--XbOuNdArY\r\nContent-Disposition: form-data; name=\"note\"\r\n\r\nhello\r\n"
+                               "--XbOuNdArY\r\nContent-Disposition: form-data; name=\"file\"; filename=\"codes.txt\"\r\n"
+                               "Content-Type: text/plain\r\n\r\n" + cl.expect + "\r\n--XbOuNdArY--\r\n";
+            rqst = "POST /upload HTTP/1.1\r\nHost: pico\r\nContent-Type: multipart/form-data; boundary=XbOuNdArY\r\n"
+                   "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+            break;
+        }
+
+        default:
+            rqst = "GET /defer?n=" + std::to_string(cl.sent) + " HTTP/1.1\r\nHost: pico\r\n\r\n";
+            cl.expect = "deferred " + std::to_string(cl.sent);
+            break;
+        }
+        FakeNet::send(cl.conn, rqst);
+        cl.sent++;
+        cl.waiting = true;
+        cl.started = FakeNet::now();
+    }
+
+    void send_ws(Client &cl)
+    {
+        if (!cl.upgraded)
+        {
+            FakeNet::send(cl.conn, "GET /ws HTTP/1.1\r\n"
+                                   "Host: pico\r\n"
+                                   "Origin: http://pico\r\n"
+                                   "Upgrade: websocket\r\n"
+                                   "Connection: Upgrade\r\n"
+                                   "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                   "Sec-WebSocket-Version: 13\r\n\r\n");
+        }
+        else
+        {
+            std::string msg;
+            cl.expect = make_payload(cl.sent);
+            WS::BuildPacket(WEBSOCKET_OPCODE_TEXT, cl.expect, msg, true);
+            FakeNet::send(cl.conn, msg);
+            cl.sent++;
+        }
+        cl.waiting = true;
+        cl.started = FakeNet::now();
+    }
+
+    void fail(Client &cl, const char *why)
+    {
+        printf("Client %d: %s\n", cl.conn, why);
+        errors_++;
+        cl.waiting = false;
+        cl.done = cfg_.requests;
+    }
+
+    //  Returns true if a complete response was consumed
+    bool check_http(Client &cl)
+    {
+        std::string &in = FakeNet::received(cl.conn);
+        std::size_t hdr = in.find("\r\n\r\n");
+        if (hdr == std::string::npos)
+        {
+            return false;
+        }
+        if (in.compare(0, 12, "HTTP/1.1 200") != 0)
+        {
+            fail(cl, "Bad status");
+            return false;
+        }
+        std::size_t icl = in.find("Content-Length: ");
+        if (icl == std::string::npos || icl > hdr)
+        {
+            fail(cl, "No Content-Length");
+            return false;
+        }
+        std::size_t len = strtoul(in.c_str() + icl + 16, nullptr, 10);
+        if (in.size() < hdr + 4 + len)
+        {
+            return false;
+        }
+        if (in.compare(hdr + 4, len, cl.expect) != 0)
+        {
+            fail(cl, "Response body mismatch");
+            return false;
+        }
+        if (cfg_.verbose)
+        {
+            printf("%d: %.*s\n", cl.conn, (int)len, in.c_str() + hdr + 4);
+        }
+        in.erase(0, hdr + 4 + len);
+        return true;
+    }
+
+    bool check_ws(Client &cl)
+    {
+        std::string &in = FakeNet::received(cl.conn);
+        if (!cl.upgraded)
+        {
+            std::size_t hdr = in.find("\r\n\r\n");
+            if (hdr == std::string::npos)
+            {
+                return false;
+            }
+            if (in.compare(0, 12, "HTTP/1.1 101") != 0)
+            {
+                fail(cl, "Websocket upgrade refused");
+                return false;
+            }
+            in.erase(0, hdr + 4);
+            cl.upgraded = true;
+            cl.waiting = false;
+            return false;
+        }
+        WebsocketPacketHeader_t header;
+        if (WS::ParsePacket(&header, in) != WEBSOCKET_SUCCESS)
+        {
+            return false;
+        }
+        if (header.meta.bits.OPCODE != WEBSOCKET_OPCODE_TEXT
+            || in.compare(header.start, header.length, cl.expect) != 0)
+        {
+            fail(cl, "Websocket echo mismatch");
+            return false;
+        }
+        in.erase(0, header.start + header.length);
+        return true;
+    }
+
+    void usage()
+    {
+        printf("Usage: loadgen [options]\n"
+               "  -c, --clients N      HTTP clients (%d)\n"
+               "  -w, --ws N           Websocket clients (%d)\n"
+               "  -n, --requests N     Requests per client (%d)\n"
+               "  -s, --segment N      Maximum segment size (%d)\n"
+               "  -p, --pbuf N         Bytes per pbuf in chain, 0 for one per segment (%d)\n"
+               "  -l, --loss P         Segment loss probability (%.2f)\n"
+               "  -b, --payload N      POST body and websocket message size (%zu)\n"
+               "  -r, --seed N         Random seed (%u)\n"
+               "  -m, --metrics[=json|trace]\n"
+               "                       Print server metrics or trace at end\n"
+               "  -d, --debug N        Server debug level (%d)\n"
+               "  -D, --deferred       Defer server log formatting to the main loop\n"
+               "  -v, --verbose        Print responses\n",
+               cfg_.clients, cfg_.ws_clients, cfg_.requests, FakeNet::options().segment,
+               FakeNet::options().pbuf_size, FakeNet::options().loss, cfg_.payload, FakeNet::options().seed,
+               cfg_.debug);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option long_opts[] =
+    {
+        {"clients",  required_argument, nullptr, 'c'},
+        {"ws",       required_argument, nullptr, 'w'},
+        {"requests", required_argument, nullptr, 'n'},
+        {"segment",  required_argument, nullptr, 's'},
+        {"pbuf",     required_argument, nullptr, 'p'},
+        {"loss",     required_argument, nullptr, 'l'},
+        {"payload",  required_argument, nullptr, 'b'},
+        {"seed",     required_argument, nullptr, 'r'},
+        {"metrics",  optional_argument, nullptr, 'm'},
+        {"debug",    required_argument, nullptr, 'd'},
+        {"deferred", no_argument,       nullptr, 'D'},
+        {"verbose",  no_argument,       nullptr, 'v'},
+        {"help",     no_argument,       nullptr, 'h'},
+        {nullptr,    0,                 nullptr, 0}
+    };
+
+    FakeNet::Options opts;
+    FakeNet::configure(opts);
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:w:n:s:p:l:b:r:m::d:Dvh", long_opts, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': cfg_.clients = atoi(optarg); break;
+        case 'w': cfg_.ws_clients = atoi(optarg); break;
+        case 'n': cfg_.requests = atoi(optarg); break;
+        case 's': opts.segment = atoi(optarg); break;
+        case 'p': opts.pbuf_size = atoi(optarg); break;
+        case 'l': opts.loss = atof(optarg); break;
+        case 'b': cfg_.payload = strtoul(optarg, nullptr, 10); break;
+        case 'r': opts.seed = strtoul(optarg, nullptr, 10); break;
+        case 'm':
+            cfg_.metrics = "";
+            if (optarg && (strcmp(optarg, "json") == 0 || strcmp(optarg, "trace") == 0))
+            {
+                cfg_.metrics = strcmp(optarg, "json") == 0 ? "?format=json" : "?format=trace";
+            }
+            break;
+        case 'd': cfg_.debug = atoi(optarg); break;
+        case 'D': cfg_.deferred = true; break;
+        case 'v': cfg_.verbose = true; break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg_.payload > 125)
+    {
+        //  WS::ParsePacket only handles short (7 bit length) frames reliably
+        printf("Payload limited to 125 bytes\n");
+        cfg_.payload = 125;
+    }
+    FakeNet::configure(opts);
+
+    static Logger log;                  // Outlives the WEB singleton
+    log.setDebug(cfg_.debug);
+    log.setDeferred(cfg_.deferred);
+
+    WEB *web = WEB::get();
+    web->setLogger(&log);
+    web->set_http_callback(http_cb);
+    web->set_message_callback(message_cb);
+    web->set_body_callback(body_cb);
+    web->set_metrics_url("/metrics");
+    if (cfg_.metrics && strcmp(cfg_.metrics, "?format=trace") == 0)
+    {
+        Trace::enable(1);
+        DBGFlag::enable(1);
+    }
+    if (!web->init())
+    {
+        printf("WEB init failed\n");
+        return 1;
+    }
+
+    std::vector<Client> clients;
+    for (int ii = 0; ii < cfg_.clients + cfg_.ws_clients; ii++)
+    {
+        Client cl = {};
+        cl.conn = FakeNet::connect(80);
+        cl.ws = ii >= cfg_.clients;
+        if (cl.conn < 0)
+        {
+            printf("Connect failed\n");
+            return 1;
+        }
+        clients.push_back(cl);
+    }
+
+    AllocStats::reset();
+    AllocStats::reset_peak();
+    uint64_t sim_start = FakeNet::now();
+    auto wall_start = std::chrono::steady_clock::now();
+    int total = 0;
+    int target = (cfg_.clients + cfg_.ws_clients) * cfg_.requests;
+    while (total < target && errors_ == 0)
+    {
+        for (Client &cl : clients)
+        {
+            if (cl.done >= cfg_.requests)
+            {
+                continue;
+            }
+            if (!cl.waiting)
+            {
+                cl.ws ? send_ws(cl) : send_request(cl);
+            }
+            else if (FakeNet::now() - cl.started > cfg_.timeout_us)
+            {
+                fail(cl, "Timeout");
+            }
+            else if (FakeNet::is_closed(cl.conn))
+            {
+                fail(cl, "Closed by server");
+            }
+        }
+        FakeNet::advance(opts.latency_us);
+        complete_deferred(web);
+        log.flush();
+        for (Client &cl : clients)
+        {
+            if (cl.waiting && (cl.ws ? check_ws(cl) : check_http(cl)))
+            {
+                cl.waiting = false;
+                cl.done++;
+                total++;
+            }
+        }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double sim = (FakeNet::now() - sim_start) / 1e6;
+
+    for (Client &cl : clients)
+    {
+        FakeNet::close(cl.conn);
+    }
+    FakeNet::advance(2000000);
+    log.flush();
+
+    if (cfg_.metrics)
+    {
+        int conn = FakeNet::connect(80);
+        FakeNet::send(conn, std::string("GET /metrics") + cfg_.metrics + " HTTP/1.1\r\nHost: pico\r\n\r\n");
+        FakeNet::advance(100000);
+        std::string &resp = FakeNet::received(conn);
+        std::size_t hdr = resp.find("\r\n\r\n");
+        printf("%s\n", hdr != std::string::npos ? resp.c_str() + hdr + 4 : "No metrics response");
+    }
+
+    const FakeNet::Stats &st = FakeNet::stats();
+    const AllocStats::Counters &ac = AllocStats::counters();
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    int per = total > 0 ? total : 1;
+    printf("Requests:        %d of %d (%d errors)\n", total, target, errors_);
+    printf("Rate:            %.0f req/s wall, %.0f req/s simulated\n", total / wall, total / sim);
+    printf("Bytes:           %llu in, %llu out\n", (unsigned long long)st.bytes_in, (unsigned long long)st.bytes_out);
+    printf("Segments:        %llu in, %llu lost\n", (unsigned long long)st.segments_in, (unsigned long long)st.segments_lost);
+    printf("Copies:          %llu bytes from pbufs, %llu bytes by altcp_write\n",
+           (unsigned long long)st.copy_bytes, (unsigned long long)st.write_copy_bytes);
+    printf("Write errors:    %llu\n", (unsigned long long)st.write_errors);
+    printf("Allocations:     %.2f per request, %.0f bytes per request\n",
+           (double)ac.allocs / per, (double)ac.bytes / per);
+    printf("Heap:            %zu bytes peak, %zu bytes live\n", AllocStats::peak_bytes(), AllocStats::live_bytes());
+    printf("Max RSS:         %ld KB\n", ru.ru_maxrss);
+
+    if (FakeNet::lock_depth() != 0)
+    {
+        printf("cyw43_arch_lwip_begin/end unbalanced (depth %d)\n", FakeNet::lock_depth());
+        errors_++;
+    }
+    return errors_ == 0 && total == target ? 0 : 1;
+}
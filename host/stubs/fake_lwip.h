@@ -0,0 +1,193 @@
+//                  *****  Host stand-in for lwIP / altcp / cyw43  *****
+
+#ifndef FAKE_LWIP_H
+#define FAKE_LWIP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef uint8_t     u8_t;
+typedef int8_t      s8_t;
+typedef uint16_t    u16_t;
+typedef int16_t     s16_t;
+typedef uint32_t    u32_t;
+typedef int32_t     s32_t;
+typedef s8_t        err_t;
+
+#define ERR_OK          0
+#define ERR_MEM         -1
+#define ERR_BUF         -2
+#define ERR_TIMEOUT     -3
+#define ERR_VAL         -6
+#define ERR_USE         -8
+#define ERR_CONN        -11
+#define ERR_CLSD        -15
+#define ERR_ABRT        -13
+#define ERR_RST         -14
+
+#define TCP_MSS                 1460
+#define TCP_WRITE_FLAG_COPY     0x01
+#define LWIP_IANA_PORT_HTTP     80
+#define LWIP_IANA_PORT_HTTPS    443
+#define SOF_REUSEADDR           0x04
+#define IPADDR_TYPE_ANY         46
+
+typedef struct ip4_addr { u32_t addr; } ip4_addr_t;
+typedef ip4_addr_t ip_addr_t;
+extern const ip_addr_t ip_addr_any;
+#define IP_ANY_TYPE             (&ip_addr_any)
+#define IP4_ADDR(ipaddr, a, b, c, d) \
+    (ipaddr)->addr = ((u32_t)((d) & 0xff) << 24) | ((u32_t)((c) & 0xff) << 16) | ((u32_t)((b) & 0xff) << 8) | (u32_t)((a) & 0xff)
+#define ip_2_ip4(ipaddr)        (ipaddr)
+#define ip_addr_eq(a, b)        ((a)->addr == (b)->addr)
+#define ip_set_option(pcb, opt) ((void)(pcb), (void)(opt))
+const char *ip4addr_ntoa(const ip4_addr_t *addr);
+
+struct netif
+{
+    ip_addr_t   ip_addr;
+    const char  *hostname;
+};
+#define netif_ip4_addr(ni)      (&(ni)->ip_addr)
+#define netif_set_hostname(ni, name) ((ni)->hostname = (name))
+
+struct pbuf
+{
+    struct pbuf *next;
+    void        *payload;
+    u16_t       tot_len;
+    u16_t       len;
+};
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+u8_t pbuf_free(struct pbuf *p);
+
+struct tcp_pcb { int dummy; };
+
+struct altcp_pcb;
+typedef err_t (*altcp_accept_fn)(void *arg, struct altcp_pcb *new_conn, err_t err);
+typedef err_t (*altcp_recv_fn)(void *arg, struct altcp_pcb *conn, struct pbuf *p, err_t err);
+typedef err_t (*altcp_sent_fn)(void *arg, struct altcp_pcb *conn, u16_t len);
+typedef err_t (*altcp_poll_fn)(void *arg, struct altcp_pcb *conn);
+typedef void  (*altcp_err_fn)(void *arg, err_t err);
+
+struct altcp_pcb
+{
+    struct altcp_pcb    *inner_conn;
+    void                *state;
+    void                *arg;
+    altcp_accept_fn     accept;
+    altcp_recv_fn       recv;
+    altcp_sent_fn       sent;
+    altcp_poll_fn       poll;
+    altcp_err_fn        err;
+    u8_t                pollinterval;
+    u16_t               port;           // Local port
+    void                *fake;          // Fake network connection
+};
+
+struct altcp_tls_config;
+typedef struct altcp_pcb *(*altcp_new_fn)(void *arg, u8_t ip_type);
+typedef struct altcp_allocator_s
+{
+    altcp_new_fn    alloc;
+    void            *arg;
+} altcp_allocator_t;
+
+struct altcp_pcb *altcp_tcp_alloc(void *arg, u8_t ip_type);
+struct altcp_pcb *altcp_tls_alloc(void *arg, u8_t ip_type);
+struct altcp_pcb *altcp_new_ip_type(altcp_allocator_t *allocator, u8_t ip_type);
+err_t altcp_bind(struct altcp_pcb *conn, const ip_addr_t *ipaddr, u16_t port);
+struct altcp_pcb *altcp_listen_with_backlog(struct altcp_pcb *conn, u8_t backlog);
+void  altcp_arg(struct altcp_pcb *conn, void *arg);
+void  altcp_accept(struct altcp_pcb *conn, altcp_accept_fn accept);
+void  altcp_recv(struct altcp_pcb *conn, altcp_recv_fn recv);
+void  altcp_sent(struct altcp_pcb *conn, altcp_sent_fn sent);
+void  altcp_poll(struct altcp_pcb *conn, altcp_poll_fn poll, u8_t interval);
+void  altcp_err(struct altcp_pcb *conn, altcp_err_fn err);
+void  altcp_recved(struct altcp_pcb *conn, u16_t len);
+err_t altcp_close(struct altcp_pcb *conn);
+u16_t altcp_sndbuf(struct altcp_pcb *conn);
+err_t altcp_write(struct altcp_pcb *conn, const void *dataptr, u16_t len, u8_t apiflags);
+err_t altcp_output(struct altcp_pcb *conn);
+u16_t altcp_get_port(struct altcp_pcb *conn, int local);
+struct altcp_tls_config *altcp_tls_create_config_server_privkey_cert(const u8_t *privkey, size_t privkey_len,
+                            const u8_t *privkey_pass, size_t privkey_pass_len, const u8_t *cert, size_t cert_len);
+void altcp_tls_free_config(struct altcp_tls_config *conf);
+
+void mdns_resp_init(void);
+err_t mdns_resp_add_netif(struct netif *netif, const char *hostname);
+err_t mdns_resp_remove_netif(struct netif *netif);
+void mdns_resp_announce(struct netif *netif);
+
+//  cyw43
+
+#define CYW43_ITF_STA               0
+#define CYW43_ITF_AP                1
+#define CYW43_LINK_DOWN             0
+#define CYW43_LINK_JOIN             1
+#define CYW43_LINK_NOIP             2
+#define CYW43_LINK_UP               3
+#define CYW43_LINK_FAIL             -1
+#define CYW43_LINK_NONET            -2
+#define CYW43_LINK_BADAUTH          -3
+#define CYW43_NO_POWERSAVE_MODE     0
+#define CYW43_AUTH_WPA2_AES_PSK     0x00400004
+#define CYW43_WL_GPIO_LED_PIN       0
+#define CYW43_WL_GPIO_VBUS_PIN      2
+#define cyw43_pm_value(pm_mode, pm2_sleep_ret_ms, li_beacon_period, li_dtim_period, li_assoc) (pm_mode)
+
+typedef struct _cyw43_t
+{
+    struct netif    netif[2];
+} cyw43_t;
+extern cyw43_t cyw43_state;
+
+typedef struct _cyw43_wifi_scan_options_t
+{
+    uint32_t    version;
+} cyw43_wifi_scan_options_t;
+
+typedef struct _cyw43_ev_scan_result_t
+{
+    uint8_t     ssid_len;
+    uint8_t     ssid[32];
+    int16_t     rssi;
+} cyw43_ev_scan_result_t;
+
+void cyw43_arch_enable_sta_mode(void);
+void cyw43_arch_enable_ap_mode(const char *ssid, const char *password, uint32_t auth);
+void cyw43_arch_disable_ap_mode(void);
+int  cyw43_arch_wifi_connect_async(const char *ssid, const char *pw, uint32_t auth);
+void cyw43_arch_lwip_begin(void);
+void cyw43_arch_lwip_end(void);
+#define cyw43_arch_lwip_check()
+void cyw43_arch_gpio_put(unsigned int wl_gpio, bool value);
+bool cyw43_arch_gpio_get(unsigned int wl_gpio);
+int  cyw43_wifi_pm(cyw43_t *self, uint32_t pm);
+int  cyw43_wifi_get_pm(cyw43_t *self, uint32_t *pm);
+int  cyw43_wifi_leave(cyw43_t *self, int itf);
+int  cyw43_tcpip_link_status(cyw43_t *self, int itf);
+int  cyw43_wifi_scan(cyw43_t *self, cyw43_wifi_scan_options_t *opts, void *env,
+                     int (*result_cb)(void *, const cyw43_ev_scan_result_t *));
+bool cyw43_wifi_scan_active(cyw43_t *self);
+
+//  mbedtls
+
+int  mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20]);
+int  mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+void mbedtls_debug_set_threshold(int threshold);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,8 @@
+//                  *****  Host stand-in for hardware/timer.h  *****
+
+#ifndef FAKE_HARDWARE_TIMER_H
+#define FAKE_HARDWARE_TIMER_H
+
+#include "pico/time.h"
+
+#endif
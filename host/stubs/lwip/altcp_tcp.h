@@ -0,0 +1,3 @@
+//  Host build: lwIP, cyw43 and mbedtls declarations are in fake_lwip.h
+
+#include "fake_lwip.h"
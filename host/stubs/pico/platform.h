@@ -0,0 +1,8 @@
+//                  *****  Host stand-in for pico/platform.h  *****
+
+#ifndef FAKE_PICO_PLATFORM_H
+#define FAKE_PICO_PLATFORM_H
+
+#include "pico/sync.h"
+
+#endif
@@ -0,0 +1,22 @@
+//                  *****  Host stand-in for pico/stdio.h  *****
+
+#ifndef FAKE_PICO_STDIO_H
+#define FAKE_PICO_STDIO_H
+
+#include <stdint.h>
+
+#define PICO_ERROR_TIMEOUT -1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static inline void stdio_set_chars_available_callback(void (*fn)(void *), void *param) { (void)fn; (void)param; }
+static inline int getchar_timeout_us(uint32_t timeout_us) { (void)timeout_us; return PICO_ERROR_TIMEOUT; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+//                  *****  Host stand-in for pico/stdlib.h  *****
+
+#ifndef FAKE_PICO_STDLIB_H
+#define FAKE_PICO_STDLIB_H
+
+#include "pico/types.h"
+#include "pico/time.h"
+
+#endif
@@ -0,0 +1,47 @@
+//                  *****  Host stand-in for pico/sync.h  *****
+
+#ifndef FAKE_PICO_SYNC_H
+#define FAKE_PICO_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//  The host build is single threaded so semaphores never block
+
+typedef struct
+{
+    volatile int    permits;
+    int             max;
+} semaphore_t;
+
+static inline void sem_init(semaphore_t *s, int initial, int max) { s->permits = initial; s->max = max; }
+static inline bool sem_try_acquire(semaphore_t *s) { if (s->permits > 0) { --s->permits; return true; } return false; }
+static inline void sem_acquire_blocking(semaphore_t *s) { sem_try_acquire(s); }
+static inline bool sem_acquire_timeout_ms(semaphore_t *s, uint32_t ms) { (void)ms; return sem_try_acquire(s); }
+static inline bool sem_release(semaphore_t *s) { if (s->permits < s->max) { ++s->permits; return true; } return false; }
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+static inline unsigned int get_core_num(void) { return 0; }
+
+typedef struct
+{
+    int             initialized;
+    int             depth;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *cs) { cs->initialized = 1; cs->depth = 0; }
+static inline void critical_section_deinit(critical_section_t *cs) { cs->initialized = 0; }
+static inline bool critical_section_is_initialized(critical_section_t *cs) { return cs->initialized != 0; }
+static inline void critical_section_enter_blocking(critical_section_t *cs) { ++cs->depth; }
+static inline void critical_section_exit(critical_section_t *cs) { --cs->depth; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
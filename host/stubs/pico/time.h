@@ -0,0 +1,47 @@
+//                  *****  Host stand-in for pico/time.h  *****
+
+#ifndef FAKE_PICO_TIME_H
+#define FAKE_PICO_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef uint64_t absolute_time_t;
+typedef int32_t  alarm_id_t;
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+struct repeating_timer
+{
+    int64_t                     delay_us;
+    absolute_time_t             next;
+    repeating_timer_callback_t  callback;
+    void                        *user_data;
+    bool                        active;
+};
+
+uint64_t time_us_64(void);
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + (uint64_t)ms * 1000; }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
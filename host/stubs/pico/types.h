@@ -0,0 +1,11 @@
+//                  *****  Host stand-in for pico/types.h  *****
+
+#ifndef FAKE_PICO_TYPES_H
+#define FAKE_PICO_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+#endif
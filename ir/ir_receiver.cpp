@@ -7,6 +7,7 @@
 #include <hardware/irq.h>
 #include <hardware/timer.h>
 #include <stdio.h>
+#include "trace.h"
 
 IR_Receiver     **IR_Receiver::receivers_ = nullptr;
 uint32_t        IR_Receiver::n_rcvr_ = 0;
@@ -104,6 +105,7 @@ bool IR_Receiver::wait_for_message(uint32_t timeout_ms)
 void IR_Receiver::gpio_cb(uint gpio, uint32_t evmask)
 {
     uint64_t ts = time_us_64();
+    TRACE_MARK(IR_EDGE, gpio);
     for (int ii = 0; ii < n_rcvr_; ii++)
     {
         IR_Receiver *ir = receivers_[ii];
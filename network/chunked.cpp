@@ -0,0 +1,115 @@
+//                  *****  ChunkedDecoder Implementation  *****
+
+#include "chunked.h"
+
+#include <stdio.h>
+
+std::size_t ChunkedDecoder::decode(const char *data, std::size_t len, HTTPBodySink *sink)
+{
+    const char *ptr = data;
+    const char *end = data + len;
+    while (ptr < end && state_ != DONE && state_ != FAILED)
+    {
+        char c = *ptr;
+        switch (state_)
+        {
+        case SIZE:
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+            {
+                if (chunk_ > (SIZE_MAX >> 4))
+                {
+                    printf("Chunk size overflow\n");
+                    state_ = FAILED;
+                    break;
+                }
+                chunk_ = (chunk_ << 4) + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+                count_++;
+            }
+            else if (count_ > 0 && (c == ';' || c == ' ' || c == '\t'))
+            {
+                state_ = EXTENSION;
+            }
+            else if (count_ > 0 && c == '\r')
+            {
+                state_ = SIZE_LF;
+            }
+            else
+            {
+                printf("Bad chunk size\n");
+                state_ = FAILED;
+                break;
+            }
+            ptr++;
+            break;
+
+        case EXTENSION:
+            if (c == '\r')
+            {
+                state_ = SIZE_LF;
+            }
+            ptr++;
+            break;
+
+        case SIZE_LF:
+            if (c != '\n')
+            {
+                state_ = FAILED;
+                break;
+            }
+            count_ = 0;
+            state_ = chunk_ > 0 ? DATA : TRAILER;
+            ptr++;
+            break;
+
+        case DATA:
+            {
+                std::size_t ll = end - ptr;
+                if (ll > chunk_)
+                {
+                    ll = chunk_;
+                }
+                if (!sink->body_data(ptr, ll))
+                {
+                    state_ = FAILED;
+                    break;
+                }
+                ptr += ll;
+                total_ += ll;
+                chunk_ -= ll;
+                if (chunk_ == 0)
+                {
+                    state_ = DATA_CR;
+                }
+            }
+            break;
+
+        case DATA_CR:
+            state_ = c == '\r' ? DATA_LF : FAILED;
+            ptr++;
+            break;
+
+        case DATA_LF:
+            state_ = c == '\n' ? SIZE : FAILED;
+            ptr++;
+            break;
+
+        case TRAILER:
+            //  Trailer fields are ignored. An empty line ends the body.
+            if (c == '\n')
+            {
+                state_ = count_ == 0 ? DONE : TRAILER;
+                count_ = 0;
+            }
+            else if (c != '\r')
+            {
+                count_ = 1;
+            }
+            ptr++;
+            break;
+
+        default:
+            break;
+        }
+    }
+    return ptr - data;
+}
@@ -0,0 +1,75 @@
+//                  *****  ChunkedDecoder Class  *****
+
+#ifndef CHUNKED_H
+#define CHUNKED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "httprequest.h"
+
+/**
+ * @class   ChunkedDecoder
+ * 
+ * This class incrementally decodes a request body sent with
+ * Transfer-Encoding: chunked. Data may be passed in pieces of any size.
+ * The chunk data is passed to an HTTPBodySink directly from the input,
+ * so the raw chunked stream is never accumulated.
+ */
+class ChunkedDecoder
+{
+private:
+    enum State
+    {
+        SIZE,               // Chunk size
+        EXTENSION,          // Chunk extension (ignored)
+        SIZE_LF,            // LF after chunk size line
+        DATA,               // Chunk data
+        DATA_CR,            // CR after chunk data
+        DATA_LF,            // LF after chunk data
+        TRAILER,            // Trailer lines after last chunk
+        DONE,               // Body complete
+        FAILED              // Format error or rejected by sink
+    };
+
+    State           state_;             // Decoder state
+    std::size_t     chunk_;             // Chunk size or bytes remaining in chunk
+    std::size_t     total_;             // Total decoded bytes
+    uint16_t        count_;             // Digits in size or characters in trailer line
+
+public:
+    ChunkedDecoder() { reset(); }
+
+    /**
+     * @brief   Prepare for a new body
+     */
+    void reset() { state_ = SIZE; chunk_ = 0; total_ = 0; count_ = 0; }
+
+    /**
+     * @brief   Decode the next portion of the chunked body
+     * 
+     * @param   data    Pointer to chunked data
+     * @param   len     Number of bytes
+     * @param   sink    Sink to receive the decoded data
+     * 
+     * @return  Number of bytes consumed. Fewer than len are consumed if the
+     *          body ends, leaving data belonging to the next request.
+     */
+    std::size_t decode(const char *data, std::size_t len, HTTPBodySink *sink);
+
+    /**
+     * @brief   Return true if the last chunk and trailer have been received
+     */
+    bool done() const { return state_ == DONE; }
+
+    /**
+     * @brief   Return true if the body was malformed or rejected by the sink
+     */
+    bool failed() const { return state_ == FAILED; }
+
+    /**
+     * @brief   Return the number of decoded bytes
+     */
+    std::size_t total() const { return total_; }
+};
+
+#endif
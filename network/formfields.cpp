@@ -0,0 +1,166 @@
+//                  *****  FormFields Implementation  *****
+
+#include "formfields.h"
+
+namespace
+{
+    //  Value of hexadecimal digits (-1 if not a digit)
+    struct HexTable
+    {
+        int8_t  value[256];
+
+        constexpr HexTable() : value()
+        {
+            for (int ii = 0; ii < 256; ii++)
+            {
+                value[ii] = -1;
+            }
+            for (int ii = 0; ii < 10; ii++)
+            {
+                value['0' + ii] = ii;
+            }
+            for (int ii = 0; ii < 6; ii++)
+            {
+                value['a' + ii] = 10 + ii;
+                value['A' + ii] = 10 + ii;
+            }
+        }
+    };
+
+    constexpr HexTable hex_table;
+}
+
+std::size_t FormFields::decode(const char *src, std::size_t len, char *dst)
+{
+    const char *end = src + len;
+    char *out = dst;
+    while (src < end)
+    {
+        char ch = *src++;
+        if (ch == '+')
+        {
+            ch = ' ';
+        }
+        else if (ch == '%' && end - src >= 2)
+        {
+            int hi = hex_table.value[static_cast<uint8_t>(src[0])];
+            int lo = hex_table.value[static_cast<uint8_t>(src[1])];
+            if (hi >= 0 && lo >= 0)
+            {
+                ch = static_cast<char>((hi << 4) | lo);
+                src += 2;
+            }
+        }
+        *out++ = ch;
+    }
+    return out - dst;
+}
+
+std::size_t FormFields::decode(char *data, std::size_t len)
+{
+    return decode(data, len, data);
+}
+
+bool FormFields::parse(char *data, std::size_t len)
+{
+    bool ret = true;
+    char *ptr = data;
+    char *end = data + len;
+    while (ptr < end)
+    {
+        char *amp = ptr;
+        while (amp < end && *amp != '&') amp++;
+        char *eq = ptr;
+        while (eq < amp && *eq != '=') eq++;
+
+        if (eq < amp)
+        {
+            //  The value is decoded one position left (over the '=') so
+            //  there is always room for its terminator before the '&'
+            std::size_t klen = decode(ptr, eq - ptr);
+            std::size_t vlen = decode(eq + 1, amp - eq - 1, eq);
+            eq[vlen] = '\0';
+            add(std::string_view(ptr, klen), eq, vlen);
+        }
+        else if (amp > ptr)
+        {
+            std::size_t klen = decode(ptr, amp - ptr);
+            static char empty[1] = "";
+            add(std::string_view(ptr, klen), empty, 0);
+            ret = false;
+        }
+        ptr = amp + 1;
+    }
+    return ret;
+}
+
+void FormFields::add(std::string_view key, const char *value, std::size_t length)
+{
+    fields_.push_back({key, value, length});
+    indexed_ = false;
+}
+
+uint32_t FormFields::hash(std::string_view key)
+{
+    uint32_t ret = 2166136261u;
+    for (auto it = key.cbegin(); it != key.cend(); ++it)
+    {
+        ret = (ret ^ static_cast<uint8_t>(*it)) * 16777619u;
+    }
+    return ret;
+}
+
+void FormFields::build_index() const
+{
+    std::size_t size = 8;
+    while (size < 2 * fields_.size())
+    {
+        size <<= 1;
+    }
+    index_.assign(size, EMPTY);
+    for (std::size_t ii = 0; ii < fields_.size() && ii < EMPTY; ii++)
+    {
+        std::size_t slot = hash(fields_[ii].key) & (size - 1);
+        while (index_[slot] != EMPTY && fields_[index_[slot]].key != fields_[ii].key)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        if (index_[slot] == EMPTY)
+        {
+            index_[slot] = ii;
+        }
+    }
+    indexed_ = true;
+}
+
+int FormFields::find(std::string_view key, int from) const
+{
+    if (from == 0 && fields_.size() > 4)
+    {
+        if (!indexed_)
+        {
+            build_index();
+        }
+        std::size_t mask = index_.size() - 1;
+        std::size_t slot = hash(key) & mask;
+        while (index_[slot] != EMPTY)
+        {
+            if (fields_[index_[slot]].key == key)
+            {
+                return index_[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        return -1;
+    }
+
+    int count = fields_.size();
+    for (int ii = from; ii < count; ii++)
+    {
+        if (fields_[ii].key == key)
+        {
+            return ii;
+        }
+    }
+    return -1;
+}
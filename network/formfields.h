@@ -0,0 +1,122 @@
+//                  *****  FormFields Class  *****
+
+#ifndef FORMFIELDS_H
+#define FORMFIELDS_H
+
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @class   FormFields
+ * 
+ * This class holds the fields of a URL query or a form submission as a
+ * flat array of key and value pairs. URL encoded data is decoded in place
+ * in a single pass so no strings are allocated per field. Keys are views
+ * of the decoded data and values are null terminated. A small hash index
+ * gives constant time lookup of the first field with a key.
+ */
+class FormFields
+{
+public:
+    /**
+     * @brief   Key and value of a field
+     */
+    struct Field
+    {
+        std::string_view    key;            // Field name
+        const char          *value;         // Null terminated value
+        std::size_t         length;         // Length of value
+    };
+
+private:
+    static constexpr uint16_t EMPTY = 0xffff;// Unused hash index slot
+
+    std::vector<Field>      fields_;        // Fields in order received
+    mutable std::vector<uint16_t> index_;   // Hash index of first field for each key
+    mutable bool            indexed_;       // Index is up to date
+
+    static uint32_t hash(std::string_view key);
+    void build_index() const;
+
+public:
+    FormFields() : indexed_(false) {}
+
+    /**
+     * @brief   Remove all fields
+     */
+    void clear() { fields_.clear(); index_.clear(); indexed_ = false; }
+
+    /**
+     * @brief   Parse URL encoded data ("key=value&key=value")
+     * 
+     * @param   data    Data to parse. It is decoded in place and must remain
+     *                  in scope while the fields are in use.
+     * @param   len     Length of data
+     * 
+     * @return  true if successful (false if a field has no '=')
+     */
+    bool parse(char *data, std::size_t len);
+
+    /**
+     * @brief   Add a field
+     * 
+     * @param   key     Field name (must remain in scope)
+     * @param   value   Null terminated value (must remain in scope)
+     * @param   length  Length of value
+     */
+    void add(std::string_view key, const char *value, std::size_t length);
+
+    /**
+     * @brief   Return number of fields
+     */
+    int size() const { return fields_.size(); }
+
+    /**
+     * @brief   Return field by index
+     */
+    const Field &at(int index) const { return fields_.at(index); }
+    std::vector<Field>::const_iterator begin() const { return fields_.cbegin(); }
+    std::vector<Field>::const_iterator end() const { return fields_.cend(); }
+
+    /**
+     * @brief   Find a field by key
+     * 
+     * @param   key     Field name
+     * @param   from    Index to start search
+     * 
+     * @return  Index of first field at or after 'from' with the key (-1 if none)
+     */
+    int find(std::string_view key, int from = 0) const;
+
+    /**
+     * @brief   Return the value of the first field with a key
+     * 
+     * @return  Pointer to value or nullptr if not found
+     */
+    const char *value(std::string_view key) const { int ii = find(key); return ii >= 0 ? fields_[ii].value : nullptr; }
+
+    /**
+     * @brief   Decode URI encoding ('%XX' and '+') in place
+     * 
+     * @param   data    Data to decode
+     * @param   len     Length of data
+     * 
+     * @return  Length of decoded data
+     */
+    static std::size_t decode(char *data, std::size_t len);
+
+    /**
+     * @brief   Decode URI encoding copying to another buffer
+     * 
+     * @param   src     Data to decode
+     * @param   len     Length of data
+     * @param   dst     Output buffer of at least len bytes (may be src)
+     * 
+     * @return  Length of decoded data
+     */
+    static std::size_t decode(const char *src, std::size_t len, char *dst);
+};
+
+#endif
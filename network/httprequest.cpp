@@ -4,54 +4,13 @@
 #include "txt.h"
 
 #include <string.h>
+#include <ctype.h>
 
 bool HTTPRequest::parseRequest(std::string &rqst, bool parsePostData)
 {
-    clear();
-    if (rqst.find("\r\n\r\n") != std::string::npos)
+    if (parseHeader(rqst))
     {
-        std::size_t i1 = 0;
-        std::size_t i2 = rqst.find("\r\n", i1);
-        while (i2 != std::string::npos && i2 != i1)
-        {
-            headers_.push_back(rqst.substr(i1, i2 - i1));
-            i1 = i2 + 2;
-            i2 = rqst.find("\r\n", i1);
-        }
-
-        std::size_t cl = 0;
-        int index = headerIndex("Content-Length");
-        if (index > 0)
-        {
-            std::string valstr = header(index).second;
-            try
-            {
-                cl = std::stoul(valstr);
-            }
-            catch(const std::exception& e)
-            {
-                printf("Bad Content-Length %s\n", valstr.c_str());
-            }
-        }
-        body_offset_ = i2 + 2;
-        body_size_ = rqst.size() - body_offset_;
-        if (body_size_ >= cl)
-        {
-            body_size_ = cl;
-            body_ = &rqst[body_offset_];
-            if (type() == "POST" && parsePostData)
-            {
-                get_post();
-            }
-        }
-        else
-        {
-            std::size_t ll = body_offset_ + body_size_;
-            if (rqst.capacity() < ll)
-            {
-                rqst.reserve(ll);
-            }
-        }
+        parseBody(rqst, parsePostData);
     }
     else
     {
@@ -68,8 +27,8 @@ bool HTTPRequest::parseRequest(std::string &rqst, bool parsePostData)
                     {
                         printf("Erased %d characters preceding GET/POST\n", i2);
                         rqst.erase(0, i2);
-                        i1 = rqst.length();
                     }
+                    i1 = rqst.length();
                 }
                 else if ((rqst.at(i2) == 'G' && rqst.length() > i2 + 4) ||
                          (rqst.at(i2) == 'P' && rqst.length() > i2 + 5))
@@ -77,6 +36,11 @@ bool HTTPRequest::parseRequest(std::string &rqst, bool parsePostData)
                     printf("Erased %d characters up to %s\n", i2 + 1, rqst.substr(i2, 4).c_str());
                     rqst.erase(0, i2 + 1);
                 }
+                else
+                {
+                    //  Wait for the rest of the request line
+                    break;
+                }
             }
             else
             {
@@ -88,32 +52,95 @@ bool HTTPRequest::parseRequest(std::string &rqst, bool parsePostData)
     return isComplete();
 }
 
-std::string HTTPRequest::type() const
+bool HTTPRequest::parseBody(std::string &rqst, bool parsePostData)
 {
-    if (headers_.size() > 0)
+    std::size_t cl = body_streamed_ ? 0 : contentLength();
+    body_size_ = rqst.size() - body_offset_;
+    if (body_size_ >= cl)
+    {
+        body_size_ = cl;
+        body_ = &rqst[body_offset_];
+        if (type() == "POST" && parsePostData)
+        {
+            get_post();
+        }
+    }
+    else
     {
-        std::vector<std::string> tokens;
-        TXT::split(headers_.at(0), " ", tokens);
-        if (tokens.size() == 3)
+        std::size_t ll = body_offset_ + body_size_;
+        if (rqst.capacity() < ll)
         {
-            return tokens.at(0);
+            rqst.reserve(ll);
         }
     }
-    return std::string();
+    return isComplete();
 }
 
-std::string HTTPRequest::url() const
+bool HTTPRequest::parseHeader(std::string &rqst)
 {
-    if (headers_.size() > 0)
+    clear();
+    if (rqst.find("\r\n\r\n") != std::string::npos)
     {
-        std::vector<std::string> tokens;
-        TXT::split(headers_.at(0), " ", tokens);
-        if (tokens.size() == 3)
+        std::size_t i1 = 0;
+        std::size_t i2 = rqst.find("\r\n", i1);
+        while (i2 != std::string::npos && i2 != i1)
         {
-            return tokens.at(1);
+            headers_.push_back(rqst.substr(i1, i2 - i1));
+            i1 = i2 + 2;
+            i2 = rqst.find("\r\n", i1);
         }
+        body_offset_ = i2 + 2;
+        return true;
     }
-    return std::string();
+    return false;
+}
+
+std::size_t HTTPRequest::contentLength() const
+{
+    std::size_t cl = 0;
+    int index = headerIndex("Content-Length");
+    if (index > 0)
+    {
+        std::string valstr = header(index).second;
+        try
+        {
+            cl = std::stoul(valstr);
+        }
+        catch(const std::exception& e)
+        {
+            printf("Bad Content-Length %s\n", valstr.c_str());
+        }
+    }
+    return cl;
+}
+
+bool HTTPRequest::isChunked() const
+{
+    int index = headerIndex("Transfer-Encoding");
+    while (index > 0)
+    {
+        std::string value = header(index).second;
+        for (auto it = value.begin(); it != value.end(); ++it)
+        {
+            *it = tolower(*it);
+        }
+        if (value.find("chunked") != std::string::npos)
+        {
+            return true;
+        }
+        index = headerIndex("Transfer-Encoding", index + 1);
+    }
+    return false;
+}
+
+std::string HTTPRequest::type() const
+{
+    return std::string(typeView());
+}
+
+std::string HTTPRequest::url() const
+{
+    return std::string(urlView());
 }
 
 std::string HTTPRequest::path() const
@@ -123,6 +150,45 @@ std::string HTTPRequest::path() const
     return ret.substr(0, i1);
 }
 
+bool HTTPRequest::request_line(std::string_view &method, std::string_view &url) const
+{
+    static constexpr TXT::Separators space(" ");
+    if (headers_.size() > 0)
+    {
+        //  Method, URL and version
+        std::string_view tokens[4];
+        if (TXT::split(headers_.at(0), space, tokens, 4) == 3)
+        {
+            method = tokens[0];
+            url = tokens[1];
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view HTTPRequest::typeView() const
+{
+    std::string_view method;
+    std::string_view url;
+    request_line(method, url);
+    return method;
+}
+
+std::string_view HTTPRequest::urlView() const
+{
+    std::string_view method;
+    std::string_view url;
+    request_line(method, url);
+    return url;
+}
+
+std::string_view HTTPRequest::pathView() const
+{
+    std::string_view ret = urlView();
+    return ret.substr(0, ret.find('?'));
+}
+
 std::string HTTPRequest::root() const
 {
     std::string ret = path();
@@ -144,26 +210,25 @@ std::string HTTPRequest::filetype() const
 
 std::string HTTPRequest::query(const std::string &key) const
 {
-    std::string ret;
-    std::string qry = uri_decode(url());
-    std::size_t i1 = qry.find('?');
-    if (i1 + 1 > qry.length()) i1 = qry.length();
-    qry.erase(0, i1 + 1);
-    std::vector<std::string> tok;
-    TXT::split(qry, "&", tok);
-    for (auto it = tok.begin(); it != tok.end(); ++it)
+    const char *value = queryFields().value(key);
+    return value ? std::string(value) : std::string();
+}
+
+const FormFields &HTTPRequest::queryFields() const
+{
+    if (!query_parsed_)
     {
-        i1 = it->find('=');
-        if (i1 != std::string::npos && it->substr(0, i1) == key)
+        query_fields_.clear();
+        std::string_view url = urlView();
+        std::size_t i1 = url.find('?');
+        if (i1 != std::string_view::npos && i1 + 1 < url.size())
         {
-            if (i1 + 1 < it->length())
-            {
-                ret = it->substr(i1 + 1);
-            }
-            break;
+            query_buf_.assign(url.substr(i1 + 1));
+            query_fields_.parse(&query_buf_[0], query_buf_.size());
         }
+        query_parsed_ = true;
     }
-    return ret;
+    return query_fields_;
 }
 
 void HTTPRequest::setURL(const std::string &newurl)
@@ -181,6 +246,8 @@ void HTTPRequest::setURL(const std::string &newurl)
                 if (i2 != std::string::npos)
                 {
                     hdr.replace(i1, i2 - i1, newurl);
+                    query_fields_.clear();
+                    query_parsed_ = false;
                 }
             }
         }
@@ -190,7 +257,8 @@ void HTTPRequest::setURL(const std::string &newurl)
 int HTTPRequest::headerIndex(const std::string &name, int from) const
 {
     int ret = -1;
-    for (int ii = from; ii < headers_.size(); ii++)
+    int count = headers_.size();
+    for (int ii = from; ii < count; ii++)
     {
         std::size_t i1 = headers_.at(ii).find(':');
         if (i1 != std::string::npos)
@@ -207,7 +275,7 @@ int HTTPRequest::headerIndex(const std::string &name, int from) const
 
 std::pair<std::string, std::string> HTTPRequest::header(int index) const
 {
-    if (index > 0 && index < headers_.size())
+    if (index > 0 && index < (int)headers_.size())
     {
         std::size_t i1 = headers_.at(index).find(':');
         if (i1 != std::string::npos)
@@ -257,7 +325,7 @@ std::string HTTPRequest::cookie(const std::string &name, const std::string &defv
 
 bool HTTPRequest::parsePost()
 {
-    if (post_data_.size() > 0)
+    if (post_fields_.size() > 0)
     {
         return true;
     }
@@ -267,6 +335,8 @@ bool HTTPRequest::parsePost()
 bool HTTPRequest::get_post()
 {
     bool ret = false;
+    post_fields_.clear();
+    post_keys_.clear();
     post_data_.clear();
 
     std::string content_type = header("Content-Type");
@@ -283,43 +353,7 @@ bool HTTPRequest::get_post()
 
 bool HTTPRequest::get_post_urlencoded()
 {
-    bool ret = true;
-    std::string key;
-    std::string value;
-    char *valptr;
-    char *ptr = body_;
-    char *end = body_ + body_size_;
-    while (ptr < end)
-    {
-        char *cp = ptr;
-        while (cp < end && *cp != '=') cp++;
-        if (cp < end)
-        {
-            key = uri_decode(std::string(ptr, cp - ptr));
-            ptr = cp + 1;
-            if (ptr < end)
-            {
-                cp = ptr;
-                while (cp < end && *cp != '&') cp++;
-                value = uri_decode(std::string(ptr, cp - ptr));
-                memcpy(ptr, value.c_str(), value.length() + 1);
-                valptr = ptr;
-                ptr = cp + 1;
-            }
-            else
-            {
-                value.clear();
-                valptr = cp;
-                *cp = 0;
-            }
-            post_data_.insert(std::pair<std::string, const char *>(key, valptr));
-        }
-        else
-        {
-            ret = false;
-        }
-    }
-    return ret;
+    return post_fields_.parse(body_, body_size_);
 }
 
 bool HTTPRequest::get_post_multipart(std::string &content_type)
@@ -342,8 +376,7 @@ bool HTTPRequest::get_post_multipart(std::string &content_type)
         char *ptr = body_;
         char *end = body_ + body_size_;
         char *cp;
-        std::string key;
-        std::string value;
+        std::string_view key;
         std::string line;
         while (ptr < end && !line.empty())
         {
@@ -359,7 +392,7 @@ bool HTTPRequest::get_post_multipart(std::string &content_type)
 
         while (ptr < end && line == boundary)
         {
-            key.clear();
+            key = std::string_view();
             cp = ptr;
             while (cp < end && *cp != '\r') cp++;
             line = std::string(ptr, cp - ptr);
@@ -376,7 +409,7 @@ bool HTTPRequest::get_post_multipart(std::string &content_type)
                         i2 = line.find('"', i1);
                         if (i2 != std::string::npos)
                         {
-                            key = line.substr(i1, i2 - i1);
+                            key = std::string_view(lp + i1, i2 - i1);
                         }
                     }
                     i1 = line.find("filename=\"");
@@ -387,7 +420,8 @@ bool HTTPRequest::get_post_multipart(std::string &content_type)
                         if (i2 != std::string::npos)
                         {
                             lp[i2] = '\0';
-                            post_data_.insert(std::pair<std::string, const char *>(key + ".filename", lp + i1));
+                            post_keys_.push_back(std::string(key) + ".filename");
+                            post_fields_.add(post_keys_.back(), lp + i1, i2 - i1);
                         }
                     }
                 }
@@ -407,7 +441,7 @@ bool HTTPRequest::get_post_multipart(std::string &content_type)
                 if (strncmp(ptr, boundary.c_str(), boundary.length()) == 0)
                 {
                     *(ptr - 2) = '\0';
-                    post_data_.insert(std::pair<std::string, const char *>(key, value));
+                    post_fields_.add(key, value, ptr - 2 - value);
                     cp = ptr;
                     while (cp < end && *cp != '\r') cp++;
                     line = std::string(ptr, cp - ptr);
@@ -420,35 +454,37 @@ bool HTTPRequest::get_post_multipart(std::string &content_type)
     return ret;
 }
 
-const char *HTTPRequest::postValue(const std::string &key) const
+const HTTPRequest::PostData &HTTPRequest::postData() const
 {
-    const char *ret = nullptr;
-    auto it = post_data_.equal_range(key);
-    if (it.first != it.second)
+    if ((int)post_data_.size() != post_fields_.size())
     {
-        ret = it.first->second;
+        post_data_.clear();
+        for (auto it = post_fields_.begin(); it != post_fields_.end(); ++it)
+        {
+            post_data_.insert(std::pair<std::string, const char *>(std::string(it->key), it->value));
+        }
     }
-    return ret;
+    return post_data_;
+}
+
+const char *HTTPRequest::postValue(const std::string &key) const
+{
+    return post_fields_.value(key);
 }
 
 char *HTTPRequest::postValue(const std::string &key)
 {
-    char *ret = nullptr;
-    auto it = post_data_.equal_range(key);
-    if (it.first != it.second)
-    {
-        ret = const_cast<char *>(it.first->second);
-    }
-    return ret;
+    return const_cast<char *>(post_fields_.value(key));
 }
 
 int HTTPRequest::postArray(const std::string &key, std::vector<const char *> &array) const
 {
     array.clear();
-    auto range = post_data_.equal_range(key);
-    for (auto it = range.first; it != range.second; ++it)
+    int ii = post_fields_.find(key);
+    while (ii >= 0)
     {
-        array.push_back(it->second);
+        array.push_back(post_fields_.at(ii).value);
+        ii = post_fields_.find(key, ii + 1);
     }
     return array.size();
 }
@@ -456,35 +492,17 @@ int HTTPRequest::postArray(const std::string &key, std::vector<const char *> &ar
 void HTTPRequest::printPostData() const
 {
     printf("Post data for %s:\n", url().c_str());
-    for (auto it = post_data_.cbegin(); it != post_data_.cend(); ++it)
+    for (auto it = post_fields_.begin(); it != post_fields_.end(); ++it)
     {
-        printf("  '%s' : '%s'\n", it->first.c_str(), it->second);
+        printf("  '%.*s' : '%s'\n", (int)it->key.size(), it->key.data(), it->value);
     }
 }
 
 std::string HTTPRequest::uri_decode(const std::string &uri)
 {
-    std::string ret;
-    char ch;
-    int i, ii;
-    for (i=0; i<uri.length(); i++)
-    {
-        if (uri[i] == '%') {
-            sscanf(uri. substr(i+1,2).c_str(), "%x", &ii);
-            ch = static_cast<char>(ii);
-            ret += ch;
-            i = i + 2;
-        }
-        else if (uri[i] == '+')
-        {
-            ret += ' ';
-        }
-        else
-        {
-            ret+=uri[i];
-        }
-    }
-    return (ret);
+    std::string ret(uri);
+    ret.resize(FormFields::decode(&ret[0], ret.size()));
+    return ret;
 }
 
 void HTTPRequest::replaceHeader(std::string &rqst, const std::string &newHeader)
@@ -530,3 +548,28 @@ void HTTPRequest::setHTMLLengthHeader(TXT &rqst)
         replaceHeader(rqst, newHeader);
     }
 }
+
+void HTTPRequest::setContentLength(std::string &rqst, std::size_t length)
+{
+    std::size_t hdrend = rqst.find("\r\n\r\n");
+    if (hdrend != std::string::npos)
+    {
+        //  i1 is the end of the line preceding the line being checked
+        std::size_t i1 = rqst.find("\r\n");
+        while (i1 < hdrend)
+        {
+            std::size_t i2 = rqst.find("\r\n", i1 + 2);
+            if (strncasecmp(&rqst[i1 + 2], "Transfer-Encoding:", 18) == 0 ||
+                strncasecmp(&rqst[i1 + 2], "Content-Length:", 15) == 0)
+            {
+                rqst.erase(i1 + 2, i2 - i1);
+                hdrend -= i2 - i1;
+            }
+            else
+            {
+                i1 = i2;
+            }
+        }
+        rqst.insert(hdrend + 2, "Content-Length: " + std::to_string(length) + "\r\n");
+    }
+}
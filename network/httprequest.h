@@ -3,11 +3,51 @@
 #ifndef HTTPREQUEST_H
 #define HTTPREQUEST_H
 
+#include <list>
 #include <map>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include "txt.h"
+#include "formfields.h"
+
+/**
+ * @class   HTTPBodySink
+ * 
+ * Interface for receiving the body of an HTTP request as it arrives
+ * rather than buffered in the request string. A sink is provided by the
+ * WEB body callback and is deleted by the WEB object when the body is
+ * complete, the request is rejected or the connection is lost.
+ */
+class HTTPBodySink
+{
+public:
+    virtual ~HTTPBodySink() {}
+
+    /**
+     * @brief   Receive the next portion of the body
+     * 
+     * @param   data    Pointer to body data (valid only during the call)
+     * @param   len     Number of bytes
+     * 
+     * @return  true to continue, false to reject the request
+     */
+    virtual bool body_data(const char *data, std::size_t len) = 0;
+
+    /**
+     * @brief   Called when the entire body has been received
+     * 
+     * @return  true if the body was accepted
+     */
+    virtual bool body_end() = 0;
+
+    /**
+     * @brief   Return the response sent if the body is rejected
+     */
+    virtual const char *error_response() const { return "HTTP/1.0 400 Bad Request\r\n\r\n"; }
+};
+
 /**
  * @class   HTTPRequest
  * 
@@ -28,11 +68,18 @@ private:
     std::size_t                     body_offset_;       // Body offset in input string
     std::size_t                     body_size_;         // Body size
     char                            *body_;             // Pointer to body string
-    PostData                        post_data_;         // POST data
+    FormFields                      post_fields_;       // POST data fields
+    std::list<std::string>          post_keys_;         // POST keys not in the body
+    mutable PostData                post_data_;         // POST data map (built on request)
+    mutable FormFields              query_fields_;      // Query fields
+    mutable std::string             query_buf_;         // Decoded query string
+    mutable bool                    query_parsed_;      // Query fields are valid
     std::string                     user_data_;         // User data
+    bool                            body_streamed_;     // Body passed to a body sink
 
     bool get_post();
     bool get_post_urlencoded();
+    bool request_line(std::string_view &method, std::string_view &url) const;
     bool get_post_multipart(std::string &content_type);
 
 public:
@@ -43,8 +90,8 @@ public:
      * 
      * @see     parseRequest
      */
-    HTTPRequest() : body_offset_(0), body_size_(0), body_(nullptr) {}
-    HTTPRequest(std::string &rqst): body_offset_(0), body_size_(0), body_(nullptr) { parseRequest(rqst); }
+    HTTPRequest() : body_offset_(0), body_size_(0), body_(nullptr), query_parsed_(false), body_streamed_(false) {}
+    HTTPRequest(std::string &rqst): body_offset_(0), body_size_(0), body_(nullptr), query_parsed_(false), body_streamed_(false) { parseRequest(rqst); }
 
     /**
      * @brief   Destructor
@@ -62,6 +109,42 @@ public:
      */
     bool parseRequest(std::string &rqst, bool parsePostData=true);
 
+    /**
+     * @brief   Parse the header portion of a request
+     * 
+     * @param   rqst    Reference to request string
+     * 
+     * @details Unlike parseRequest the body is not examined and no space is
+     *          reserved for it. The header methods and bodyOffset may be used
+     *          after a successful parse.
+     * 
+     * @return  true if the request header is complete
+     */
+    bool parseHeader(std::string &rqst);
+
+    /**
+     * @brief   Complete the parse of a request after parseHeader
+     * 
+     * @param   rqst    Reference to the request string given to parseHeader
+     * @param   parsePostData   If true, any POST data will be parsed
+     * 
+     * @details The header is not parsed again, so a caller that has
+     *          examined the header avoids a second parse of every line.
+     * 
+     * @return  true if the request is complete
+     */
+    bool parseBody(std::string &rqst, bool parsePostData=true);
+
+    /**
+     * @brief   Return the value of the Content-Length header (zero if none)
+     */
+    std::size_t contentLength() const;
+
+    /**
+     * @brief   Return true if the body is sent with chunked transfer encoding
+     */
+    bool isChunked() const;
+
     /**
      * @brief   Parse POST data in request
      * 
@@ -89,6 +172,17 @@ public:
      */
     std::string path() const;
 
+    /**
+     * @brief   Return views of the request type, URL and path
+     * 
+     * These return the same values as type(), url() and path() without
+     * allocating. The views reference the request and are valid until
+     * the request is cleared or reparsed.
+     */
+    std::string_view typeView() const;
+    std::string_view urlView() const;
+    std::string_view pathView() const;
+
     /**
      * @brief   Return the root portion of the path (up to the first period)
      */
@@ -107,6 +201,14 @@ public:
      * @return  Value of the query item (portion after equal sign) or empty string
      */
     std::string query(const std::string &key) const;
+
+    /**
+     * @brief   Return the fields of the query portion of the URL
+     * 
+     * @details The query is decoded once on first use. The fields are
+     *          valid until the request is cleared or the URL is replaced.
+     */
+    const FormFields &queryFields() const;
     
     /**
      * @brief   Replace the URL portion of the request
@@ -173,8 +275,16 @@ public:
 
     /**
      * @brief   Return reference to POST data
+     * 
+     * @details The map is built from postFields on first use. postFields
+     *          and postValue do not allocate.
+     */
+    const PostData &postData() const;
+
+    /**
+     * @brief   Return the POST data fields in the order received
      */
-    const PostData &postData() const { return post_data_; }
+    const FormFields &postFields() const { return post_fields_; }
 
     /**
      * @brief   Get pointer to value of POST item
@@ -227,15 +337,38 @@ public:
     static void setHTMLLengthHeader(std::string &rqst);
     static void setHTMLLengthHeader(TXT &rqst);
 
+    /**
+     * @brief   Replace any Transfer-Encoding header with a Content-Length header
+     * 
+     * @param   rqst        HTTP request string with a decoded body
+     * @param   length      Length of the body
+     */
+    static void setContentLength(std::string &rqst, std::size_t length);
+
     /**
      * @brief   Return true if request string contains a complete HTTP request
      */
     bool isComplete() const { return body_ != nullptr; }
 
+    /**
+     * @brief   Mark the body as consumed by a body sink
+     * 
+     * @details A request whose body was streamed is complete once its header
+     *          is received and is presented with an empty body. The flag is
+     *          not reset by clear.
+     */
+    void setBodyStreamed(bool streamed) { body_streamed_ = streamed; }
+
+    /**
+     * @brief   Return true if the body was passed to a body sink
+     */
+    bool isBodyStreamed() const { return body_streamed_; }
+
     /**
      * @brief   Reset the object
      */
-    void clear() { headers_.clear(); body_offset_ = 0; body_size_ = 0; body_ = nullptr; post_data_.clear(); }
+    void clear() { headers_.clear(); body_offset_ = 0; body_size_ = 0; body_ = nullptr;
+                   post_fields_.clear(); post_keys_.clear(); post_data_.clear(); query_fields_.clear(); query_parsed_ = false; }
 
     /**
      * @brief   Return user data string
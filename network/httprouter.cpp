@@ -0,0 +1,231 @@
+//                  *****  HTTPRouter Implementation  *****
+
+#include "httprouter.h"
+#include <algorithm>
+#include <stdio.h>
+
+std::string_view HTTPRouter::Params::get(std::string_view name) const
+{
+    for (int ii = 0; ii < count_; ii++)
+    {
+        if (names_[ii] == name)
+        {
+            return values_[ii];
+        }
+    }
+    return std::string_view();
+}
+
+HTTPRouter::HTTPRouter() : compiled_(false)
+{
+    add_node(std::string_view());
+}
+
+HTTPRouter::HTTPRouter(const Route *routes, int count) : compiled_(false)
+{
+    add_node(std::string_view());
+    for (int ii = 0; ii < count; ii++)
+    {
+        add(routes[ii].method, routes[ii].pattern, routes[ii].handler, routes[ii].user_data);
+    }
+    compile();
+}
+
+uint16_t HTTPRouter::add_node(std::string_view segment)
+{
+    Node node;
+    node.segment = segment;
+    node.param = -1;
+    nodes_.push_back(node);
+    return nodes_.size() - 1;
+}
+
+bool HTTPRouter::add(const char *method, const char *pattern, Handler handler, void *user_data)
+{
+    Entry entry;
+    entry.method = method && *method != '*' ? std::string_view(method) : std::string_view();
+    entry.handler = handler;
+    entry.user_data = user_data;
+    entry.nparams = 0;
+
+    uint16_t node = 0;
+    bool prefix = false;
+    std::string_view rest(pattern ? pattern : "");
+    std::string_view seg;
+    while (next_segment(rest, seg))
+    {
+        if (seg == "*")
+        {
+            prefix = true;
+            break;
+        }
+        else if (seg.size() > 2 && seg.front() == '{' && seg.back() == '}')
+        {
+            if (entry.nparams == MAX_PARAMS)
+            {
+                printf("Too many parameters in route %s\n", pattern);
+                return false;
+            }
+            entry.names[entry.nparams++] = seg.substr(1, seg.size() - 2);
+            if (nodes_[node].param < 0)
+            {
+                int16_t child = add_node(std::string_view());
+                nodes_[node].param = child;
+            }
+            node = nodes_[node].param;
+        }
+        else
+        {
+            int16_t child = -1;
+            for (auto it = nodes_[node].literals.cbegin(); it != nodes_[node].literals.cend(); ++it)
+            {
+                if (nodes_[*it].segment == seg)
+                {
+                    child = *it;
+                    break;
+                }
+            }
+            if (child < 0)
+            {
+                child = add_node(seg);
+                nodes_[node].literals.push_back(child);
+            }
+            node = child;
+        }
+    }
+
+    entries_.push_back(entry);
+    uint16_t index = entries_.size() - 1;
+    if (prefix)
+    {
+        nodes_[node].prefixes.push_back(index);
+    }
+    else
+    {
+        nodes_[node].routes.push_back(index);
+    }
+    compiled_ = false;
+    return true;
+}
+
+void HTTPRouter::compile()
+{
+    for (auto it = nodes_.begin(); it != nodes_.end(); ++it)
+    {
+        std::sort(it->literals.begin(), it->literals.end(),
+                  [this](uint16_t a, uint16_t b) { return nodes_[a].segment < nodes_[b].segment; });
+    }
+    compiled_ = true;
+}
+
+bool HTTPRouter::next_segment(std::string_view &rest, std::string_view &segment)
+{
+    std::size_t i1 = rest.find_first_not_of('/');
+    if (i1 == std::string_view::npos)
+    {
+        rest = std::string_view();
+        return false;
+    }
+    std::size_t i2 = rest.find('/', i1);
+    if (i2 == std::string_view::npos)
+    {
+        i2 = rest.size();
+    }
+    segment = rest.substr(i1, i2 - i1);
+    rest = rest.substr(i2);
+    return true;
+}
+
+int16_t HTTPRouter::find_literal(uint16_t node, std::string_view segment) const
+{
+    const std::vector<uint16_t> &lits = nodes_[node].literals;
+    auto it = std::lower_bound(lits.cbegin(), lits.cend(), segment,
+                               [this](uint16_t a, std::string_view s) { return nodes_[a].segment < s; });
+    if (it != lits.cend() && nodes_[*it].segment == segment)
+    {
+        return *it;
+    }
+    return -1;
+}
+
+const HTTPRouter::Entry *HTTPRouter::select(const std::vector<uint16_t> &routes, std::string_view method) const
+{
+    for (auto it = routes.cbegin(); it != routes.cend(); ++it)
+    {
+        const Entry &entry = entries_[*it];
+        if (entry.method.empty() || entry.method == method)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+const HTTPRouter::Entry *HTTPRouter::match(uint16_t node, std::string_view rest, std::string_view method, Params &params, int depth) const
+{
+    const Entry *ret = nullptr;
+    std::string_view next = rest;
+    std::string_view seg;
+    if (!next_segment(next, seg))
+    {
+        ret = select(nodes_[node].routes, method);
+    }
+    else
+    {
+        int16_t child = find_literal(node, seg);
+        if (child >= 0)
+        {
+            ret = match(child, next, method, params, depth);
+        }
+        if (!ret && nodes_[node].param >= 0 && depth < MAX_PARAMS)
+        {
+            params.values_[depth] = seg;
+            ret = match(nodes_[node].param, next, method, params, depth + 1);
+        }
+    }
+
+    if (!ret)
+    {
+        ret = select(nodes_[node].prefixes, method);
+        if (ret)
+        {
+            params.tail_ = rest;
+        }
+    }
+    return ret;
+}
+
+bool HTTPRouter::dispatch(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close)
+{
+    if (!compiled_)
+    {
+        compile();
+    }
+
+    Params params;
+    std::string_view path = rqst.pathView();
+    const Entry *entry = match(0, path, rqst.typeView(), params, 0);
+    if (entry)
+    {
+        params.count_ = entry->nparams;
+        for (int ii = 0; ii < entry->nparams; ii++)
+        {
+            params.names_[ii] = entry->names[ii];
+        }
+        if (entry->handler(web, client, rqst, params, close, entry->user_data))
+        {
+            return true;
+        }
+    }
+
+    Params none;
+    none.tail_ = path;
+    for (auto it = fallbacks_.cbegin(); it != fallbacks_.cend(); ++it)
+    {
+        if (it->handler(web, client, rqst, none, close, it->user_data))
+        {
+            return true;
+        }
+    }
+    return false;
+}
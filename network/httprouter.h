@@ -0,0 +1,212 @@
+//                  *****  HTTPRouter Class  *****
+
+#ifndef HTTPROUTER_H
+#define HTTPROUTER_H
+
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include "httprequest.h"
+
+class WEB;
+typedef uint32_t ClientHandle;
+
+/**
+ * @class   HTTPRouter
+ * 
+ * This class dispatches HTTP requests to handler functions by method and
+ * path. It replaces the chain of URL comparisons in an application's HTTP
+ * callback.
+ * 
+ * Path patterns are made up of segments separated by '/':
+ * 
+ *      -literal    Segment must match exactly (e.g. /api/status)
+ *      -{name}     Segment is captured as parameter name (e.g. /led/{id})
+ *      -*          As the last segment, matches any remaining path
+ * 
+ * Literal segments take priority over parameters which take priority over
+ * prefix matches. A method of "*" or nullptr matches any request type.
+ * 
+ * Routes are compiled into a trie on first use so dispatch does not
+ * allocate. Pattern and method strings must remain in scope while the
+ * router is in use (string literals are typical).
+ * 
+ * The router can be built from a static table and installed as the WEB
+ * HTTP callback:
+ * @code
+ *    static const HTTPRouter::Route routes[] =
+ *    {
+ *        {"GET",  "/api/status",   get_status},
+ *        {"POST", "/api/led/{id}", set_led}
+ *    };
+ *    static HTTPRouter router(routes, sizeof(routes) / sizeof(routes[0]));
+ *    router.add_fallback(WEB_FILES::route_websocket_js);
+ *    router.add_fallback(WEB_FILES::route_file);
+ *    web->set_http_callback(HTTPRouter::http_callback, &router);
+ * @endcode
+ */
+class HTTPRouter
+{
+public:
+    static const int MAX_PARAMS = 4;        // Maximum captured parameters per route
+
+    /**
+     * @class   Params
+     * 
+     * Path parameters captured by a route match. Values are views of the
+     * request path and are valid during the handler call.
+     */
+    class Params
+    {
+    private:
+        std::string_view    names_[MAX_PARAMS];     // Parameter names
+        std::string_view    values_[MAX_PARAMS];    // Parameter values
+        std::string_view    tail_;                  // Path matched by prefix
+        int                 count_;                 // Number of parameters
+
+        friend class HTTPRouter;
+
+    public:
+        Params() : count_(0) {}
+
+        /**
+         * @brief   Return number of captured parameters
+         */
+        int size() const { return count_; }
+
+        /**
+         * @brief   Return name or value of parameter by index
+         */
+        std::string_view name(int index) const { return index >= 0 && index < count_ ? names_[index] : std::string_view(); }
+        std::string_view value(int index) const { return index >= 0 && index < count_ ? values_[index] : std::string_view(); }
+
+        /**
+         * @brief   Return value of named parameter (empty if not captured)
+         */
+        std::string_view get(std::string_view name) const;
+
+        /**
+         * @brief   Return the part of the path matched by a trailing '*'
+         */
+        std::string_view tail() const { return tail_; }
+    };
+
+    /**
+     * @typedef Handler
+     * 
+     * @brief   Route handler function
+     * 
+     * Parameters are those of the WEB HTTP callback with the addition of
+     * the captured path parameters. Return true if the request was handled.
+     */
+    typedef bool (*Handler)(WEB *web, ClientHandle client, HTTPRequest &rqst, const Params &params, bool &close, void *udata);
+
+    /**
+     * @brief   Route table entry
+     */
+    struct Route
+    {
+        const char  *method;                // Request type ("GET", "POST", "*")
+        const char  *pattern;               // Path pattern
+        Handler     handler;                // Handler function
+        void        *user_data;             // Data passed to handler
+    };
+
+private:
+    struct Entry
+    {
+        std::string_view    method;                 // Request type (empty for any)
+        Handler             handler;                // Handler function
+        void                *user_data;             // User data
+        std::string_view    names[MAX_PARAMS];      // Parameter names
+        uint8_t             nparams;                // Number of parameters
+    };
+
+    struct Node
+    {
+        std::string_view        segment;            // Literal segment
+        std::vector<uint16_t>   literals;           // Literal children (sorted after compile)
+        int16_t                 param;              // Parameter child (-1 if none)
+        std::vector<uint16_t>   routes;             // Routes ending at this node
+        std::vector<uint16_t>   prefixes;           // Routes matching any remaining path
+    };
+
+    struct Fallback
+    {
+        Handler     handler;                // Handler function
+        void        *user_data;             // User data
+    };
+
+    std::vector<Entry>      entries_;       // Registered routes
+    std::vector<Node>       nodes_;         // Trie nodes (root is first)
+    std::vector<Fallback>   fallbacks_;     // Handlers tried when no route matches
+    bool                    compiled_;      // Trie children sorted
+
+    uint16_t add_node(std::string_view segment);
+    int16_t find_literal(uint16_t node, std::string_view segment) const;
+    const Entry *select(const std::vector<uint16_t> &routes, std::string_view method) const;
+    const Entry *match(uint16_t node, std::string_view rest, std::string_view method, Params &params, int depth) const;
+    static bool next_segment(std::string_view &rest, std::string_view &segment);
+
+public:
+    /**
+     * @brief   Constructors
+     * 
+     * @param   routes  Table of routes
+     * @param   count   Number of entries in table
+     */
+    HTTPRouter();
+    HTTPRouter(const Route *routes, int count);
+
+    /**
+     * @brief   Add a route
+     * 
+     * @param   method      Request type ("GET", "POST" or "*" / nullptr for any)
+     * @param   pattern     Path pattern
+     * @param   handler     Handler function
+     * @param   user_data   Data passed to handler
+     * 
+     * @return  true if added (false if pattern has too many parameters)
+     */
+    bool add(const char *method, const char *pattern, Handler handler, void *user_data = nullptr);
+
+    /**
+     * @brief   Add a handler to be tried when no route matches
+     * 
+     * @details Fallbacks are tried in the order added until one returns true.
+     *          The tail() of the parameters is the request path.
+     * 
+     * @param   handler     Handler function
+     * @param   user_data   Data passed to handler
+     */
+    void add_fallback(Handler handler, void *user_data = nullptr) { fallbacks_.push_back({handler, user_data}); }
+
+    /**
+     * @brief   Prepare the route table for dispatch
+     * 
+     * @details Called by dispatch if routes were added since the last call
+     */
+    void compile();
+
+    /**
+     * @brief   Dispatch a request to the matching route
+     * 
+     * @param   web     Pointer to WEB object
+     * @param   client  Handle of client connection
+     * @param   rqst    HTTP request
+     * @param   close   Close flag as for the WEB HTTP callback
+     * 
+     * @return  true if a handler processed the request
+     */
+    bool dispatch(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close);
+
+    /**
+     * @brief   WEB HTTP callback function dispatching to a router
+     * 
+     * @details Pass the HTTPRouter pointer as the user data to WEB::set_http_callback
+     */
+    static bool http_callback(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close, void *router)
+                             { return static_cast<HTTPRouter *>(router)->dispatch(web, client, rqst, close); }
+};
+
+#endif
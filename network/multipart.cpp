@@ -0,0 +1,287 @@
+//                  *****  MultipartParser Implementation  *****
+
+#include "multipart.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+MultipartParser::MultipartParser(const std::string &boundary, MultipartSink *sink, std::size_t max_part)
+    : sink_(sink), delim_("\r\n--"), match_(2), max_part_(max_part), part_size_(0),
+      state_(PREAMBLE), end_char_(0), too_large_(false), finished_(false)
+{
+    //  The first boundary may not be preceded by CRLF so start as if it was received
+    delim_ += boundary;
+}
+
+MultipartParser::~MultipartParser()
+{
+    finish_sink(false);
+}
+
+MultipartParser *MultipartParser::create(const HTTPRequest &rqst, MultipartSink *sink, std::size_t max_part)
+{
+    std::string bnd = boundary(rqst.header("Content-Type"));
+    if (bnd.empty())
+    {
+        printf("Request is not multipart/form-data\n");
+        sink->finish(false);
+        return nullptr;
+    }
+    return new MultipartParser(bnd, sink, max_part);
+}
+
+std::string MultipartParser::boundary(const std::string &content_type)
+{
+    std::string ret;
+    if (content_type.find("multipart/form-data") != std::string::npos)
+    {
+        std::size_t i1 = content_type.find("boundary=");
+        if (i1 != std::string::npos)
+        {
+            i1 += 9;
+            std::size_t i2 = content_type.find_first_of("; \r\n", i1);
+            ret = content_type.substr(i1, i2 - i1);
+            if (ret.size() >= 2 && ret.front() == '"' && ret.back() == '"')
+            {
+                ret = ret.substr(1, ret.size() - 2);
+            }
+        }
+    }
+    return ret;
+}
+
+bool MultipartParser::body_data(const char *data, std::size_t len)
+{
+    const char *ptr = data;
+    const char *end = data + len;
+    while (ptr < end && state_ != DONE && state_ != FAILED)
+    {
+        switch (state_)
+        {
+        case PREAMBLE:
+        case BODY:
+            if (match_ == 0)
+            {
+                //  Pass data up to a possible delimiter
+                const char *cr = static_cast<const char *>(memchr(ptr, '\r', end - ptr));
+                const char *stop = cr ? cr : end;
+                if (state_ == BODY && stop > ptr && !emit(ptr, stop - ptr))
+                {
+                    return false;
+                }
+                ptr = stop;
+                if (cr)
+                {
+                    match_ = 1;
+                    ptr++;
+                }
+            }
+            else
+            {
+                while (ptr < end && match_ < delim_.size() && *ptr == delim_[match_])
+                {
+                    ptr++;
+                    match_++;
+                }
+                if (match_ == delim_.size())
+                {
+                    if (state_ == BODY && !sink_->part_end())
+                    {
+                        return fail();
+                    }
+                    match_ = 0;
+                    state_ = BOUNDARY;
+                }
+                else if (ptr < end)
+                {
+                    //  Not a delimiter. The boundary cannot contain CR so the
+                    //  matched characters are data and matching restarts here.
+                    std::size_t ll = match_;
+                    match_ = 0;
+                    if (state_ == BODY && !emit(delim_.data(), ll))
+                    {
+                        return false;
+                    }
+                }
+            }
+            break;
+
+        case BOUNDARY:
+            if (*ptr == '-')
+            {
+                end_char_ = '-';
+                state_ = BOUNDARY_END;
+            }
+            else if (*ptr == '\r')
+            {
+                end_char_ = '\n';
+                state_ = BOUNDARY_END;
+            }
+            else if (*ptr != ' ' && *ptr != '\t')
+            {
+                return fail();
+            }
+            ptr++;
+            break;
+
+        case BOUNDARY_END:
+            if (*ptr++ != end_char_)
+            {
+                return fail();
+            }
+            if (end_char_ == '-')
+            {
+                state_ = DONE;
+            }
+            else
+            {
+                headers_.clear();
+                state_ = HEADERS;
+            }
+            break;
+
+        case HEADERS:
+            {
+                const char *nl = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+                const char *stop = nl ? nl + 1 : end;
+                headers_.append(ptr, stop - ptr);
+                ptr = stop;
+                if (headers_.size() > MAX_HEADERS)
+                {
+                    printf("Multipart headers too long\n");
+                    return fail();
+                }
+                if (nl && (headers_ == "\r\n" ||
+                    (headers_.size() >= 4 && headers_.compare(headers_.size() - 4, 4, "\r\n\r\n") == 0)))
+                {
+                    if (!start_part())
+                    {
+                        return false;
+                    }
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+    return state_ != FAILED;
+}
+
+bool MultipartParser::body_end()
+{
+    if (state_ != DONE)
+    {
+        printf("Multipart body incomplete\n");
+        return fail();
+    }
+    finish_sink(true);
+    return true;
+}
+
+const char *MultipartParser::error_response() const
+{
+    return too_large_ ? "HTTP/1.0 413 Payload Too Large\r\n\r\n" : HTTPBodySink::error_response();
+}
+
+bool MultipartParser::emit(const char *data, std::size_t len)
+{
+    part_size_ += len;
+    if (max_part_ > 0 && part_size_ > max_part_)
+    {
+        printf("Multipart part exceeds %zu bytes\n", max_part_);
+        return fail(true);
+    }
+    return sink_->part_data(data, len) || fail();
+}
+
+bool MultipartParser::start_part()
+{
+    std::string name;
+    std::string filename;
+    std::string content_type;
+    std::size_t i1 = 0;
+    std::size_t i2 = headers_.find("\r\n", i1);
+    while (i2 != std::string::npos && i2 != i1)
+    {
+        std::string line = headers_.substr(i1, i2 - i1);
+        std::size_t ic = line.find(':');
+        if (ic != std::string::npos)
+        {
+            std::size_t iv = line.find_first_not_of(' ', ic + 1);
+            std::string value = iv != std::string::npos ? line.substr(iv) : std::string();
+            if (strncasecmp(line.c_str(), "Content-Disposition", ic) == 0 && ic == 19)
+            {
+                //  Parameters are separated by ';' and may be quoted
+                std::size_t ip = value.find(';');
+                while (ip != std::string::npos)
+                {
+                    ip = value.find_first_not_of("; ", ip);
+                    if (ip == std::string::npos)
+                    {
+                        break;
+                    }
+                    std::size_t ie = value.find('=', ip);
+                    if (ie == std::string::npos)
+                    {
+                        break;
+                    }
+                    std::string key = value.substr(ip, ie - ip);
+                    std::string val;
+                    std::size_t in;
+                    if (ie + 1 < value.size() && value[ie + 1] == '"')
+                    {
+                        in = value.find('"', ie + 2);
+                        val = value.substr(ie + 2, in - ie - 2);
+                        in = value.find(';', in);
+                    }
+                    else
+                    {
+                        in = value.find(';', ie);
+                        val = value.substr(ie + 1, in - ie - 1);
+                    }
+                    if (key == "name")
+                    {
+                        name = val;
+                    }
+                    else if (key == "filename")
+                    {
+                        filename = val;
+                    }
+                    ip = in;
+                }
+            }
+            else if (strncasecmp(line.c_str(), "Content-Type", ic) == 0 && ic == 12)
+            {
+                content_type = value;
+            }
+        }
+        i1 = i2 + 2;
+        i2 = headers_.find("\r\n", i1);
+    }
+
+    headers_.clear();
+    part_size_ = 0;
+    match_ = 0;
+    state_ = BODY;
+    return sink_->part_begin(name, filename, content_type) || fail();
+}
+
+bool MultipartParser::fail(bool too_large)
+{
+    state_ = FAILED;
+    too_large_ = too_large_ || too_large;
+    finish_sink(false);
+    return false;
+}
+
+void MultipartParser::finish_sink(bool ok)
+{
+    if (!finished_)
+    {
+        finished_ = true;
+        sink_->finish(ok);
+    }
+}
@@ -0,0 +1,152 @@
+//                  *****  MultipartParser Class  *****
+
+#ifndef MULTIPART_H
+#define MULTIPART_H
+
+#include <string>
+#include <stdint.h>
+#include "httprequest.h"
+
+/**
+ * @class   MultipartSink
+ * 
+ * Interface receiving the parts of a multipart/form-data body from a
+ * MultipartParser. Part data is passed in pieces as it arrives.
+ */
+class MultipartSink
+{
+public:
+    virtual ~MultipartSink() {}
+
+    /**
+     * @brief   Start of a part
+     * 
+     * @param   name            Form field name
+     * @param   filename        File name (empty if not a file)
+     * @param   content_type    Content type of part (empty if not specified)
+     * 
+     * @return  true to accept the part
+     */
+    virtual bool part_begin(const std::string &name, const std::string &filename, const std::string &content_type) = 0;
+
+    /**
+     * @brief   Next portion of the current part's data
+     * 
+     * @param   data    Pointer to data (valid only during the call)
+     * @param   len     Number of bytes
+     * 
+     * @return  true to continue
+     */
+    virtual bool part_data(const char *data, std::size_t len) = 0;
+
+    /**
+     * @brief   End of the current part
+     * 
+     * @return  true to continue
+     */
+    virtual bool part_end() = 0;
+
+    /**
+     * @brief   End of the body
+     * 
+     * @param   ok      true if all parts were received and accepted
+     * 
+     * @details Called exactly once, including when the upload is rejected or
+     *          the connection is lost. The sink may delete itself here.
+     */
+    virtual void finish(bool /*ok*/) {}
+};
+
+/**
+ * @class   MultipartParser
+ * 
+ * This class is an HTTPBodySink that splits a multipart/form-data request
+ * body into parts as it is received and passes them to a MultipartSink.
+ * Part data is passed directly from the received segments. Only a partial
+ * boundary and the part headers are held between segments, so uploads
+ * of any size can be written to flash without buffering the body.
+ * 
+ * A typical body callback:
+ * @code
+ *    HTTPBodySink *body_callback(WEB *web, ClientHandle client, HTTPRequest &rqst, void *udata)
+ *    {
+ *        if (rqst.path() == "/upload")
+ *        {
+ *            return MultipartParser::create(rqst, new FlashWriter(), 128 * 1024);
+ *        }
+ *        return nullptr;
+ *    }
+ * @endcode
+ */
+class MultipartParser : public HTTPBodySink
+{
+private:
+    enum State
+    {
+        PREAMBLE,           // Before first boundary
+        BOUNDARY,           // After a boundary
+        BOUNDARY_END,       // Second character of "--" or CRLF after boundary
+        HEADERS,            // Part headers
+        BODY,               // Part data
+        DONE,               // After final boundary
+        FAILED              // Body rejected
+    };
+
+    static const std::size_t MAX_HEADERS = 1024;    // Maximum size of part headers
+
+    MultipartSink   *sink_;             // Application sink
+    std::string     delim_;             // CRLF, "--" and boundary
+    std::size_t     match_;             // Characters of delimiter matched
+    std::string     headers_;           // Part headers
+    std::size_t     max_part_;          // Maximum part size (0 for no limit)
+    std::size_t     part_size_;         // Size of current part
+    State           state_;             // Parser state
+    char            end_char_;          // Expected second character after boundary
+    bool            too_large_;         // Part exceeded maximum size
+    bool            finished_;          // Sink finish called
+
+    bool emit(const char *data, std::size_t len);
+    bool start_part();
+    bool fail(bool too_large = false);
+    void finish_sink(bool ok);
+
+public:
+    /**
+     * @brief   Constructor
+     * 
+     * @param   boundary    Boundary string from the Content-Type header
+     * @param   sink        Sink to receive the parts
+     * @param   max_part    Maximum size of a part (0 for no limit)
+     */
+    MultipartParser(const std::string &boundary, MultipartSink *sink, std::size_t max_part = 0);
+
+    /**
+     * @brief   Destructor. Calls the sink finish if not yet called.
+     */
+    virtual ~MultipartParser();
+
+    /**
+     * @brief   Create a parser for a request
+     * 
+     * @param   rqst        Request with multipart/form-data content type
+     * @param   sink        Sink to receive the parts
+     * @param   max_part    Maximum size of a part (0 for no limit)
+     * 
+     * @return  Pointer to new parser or nullptr if not a multipart request
+     *          (finish is called on the sink)
+     */
+    static MultipartParser *create(const HTTPRequest &rqst, MultipartSink *sink, std::size_t max_part = 0);
+
+    /**
+     * @brief   Extract the boundary from a Content-Type value
+     * 
+     * @return  Boundary or empty string if not multipart/form-data
+     */
+    static std::string boundary(const std::string &content_type);
+
+    virtual bool body_data(const char *data, std::size_t len);
+    virtual bool body_end();
+    virtual const char *error_response() const;
+};
+
+#endif
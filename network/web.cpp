@@ -1,8 +1,11 @@
 #include "web.h"
 #include "ws.h"
 #include "cyw43_locker.h"
+#include "trace.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 
 #include <pico/cyw43_arch.h>
 #include <lwip/altcp_tcp.h>
@@ -47,9 +50,10 @@ void set_reuseaddr(struct altcp_pcb *conn)
 
 
 WEB::WEB() : http_server_(nullptr), https_server_(nullptr),
-             wifi_state_(CYW43_LINK_DOWN), tls_conf_(nullptr), reconnect_time_(0),
+             wifi_state_(CYW43_LINK_DOWN), tls_conf_(nullptr), reconnect_time_(0), next_defer_(0),
              ap_active_(0), ap_requested_(0), mdns_active_(false),
              http_callback_(nullptr), http_user_data_(nullptr),
+             body_callback_(nullptr), body_user_data_(nullptr),
              message_callback_(nullptr), message_user_data_(nullptr),
              notice_callback_(nullptr), notice_user_data_(nullptr),
              tls_callback_(nullptr)
@@ -272,6 +276,7 @@ void WEB::deleteClient(struct altcp_pcb *pcb)
         auto it2 = clientHndl_.find(it1->second);
         if (it2 != clientHndl_.end())
         {
+            metrics_.closed();
             delete it2->second;
             clientHndl_.erase(it2);
         }
@@ -299,6 +304,21 @@ WEB::CLIENT *WEB::findClient(struct altcp_pcb *pcb)
     return nullptr;
 }
 
+WEB::CLIENT *WEB::findDeferred(DeferHandle handle)
+{
+    if (handle != 0)
+    {
+        for (auto it = clientHndl_.cbegin(); it != clientHndl_.cend(); ++it)
+        {
+            if (it->second->deferred() == handle && !it->second->isClosed())
+            {
+                return it->second;
+            }
+        }
+    }
+    return nullptr;
+}
+
 bool WEB::update_wifi(const std::string &hostname, const std::string &ssid, const std::string &password)
 {
     bool ret = true;
@@ -341,6 +361,12 @@ err_t WEB::tcp_server_accept(void *arg, struct altcp_pcb *client_pcb, err_t err)
     }
     set_reuseaddr(client_pcb);
     CLIENT *client = web->addClient(client_pcb);
+    web->metrics_.accepted();
+    if (altcp_get_port(client_pcb, 1) == LWIP_IANA_PORT_HTTPS)
+    {
+        //  The TLS handshake completes before the first data is received
+        client->setAcceptTime(time_us_64());
+    }
 #if SNTP_SERVER_DNS
     time_t now;
     time(&now);
@@ -382,51 +408,31 @@ err_t WEB::tcp_server_recv(void *arg, struct altcp_pcb *tpcb, struct pbuf *p, er
     // can use this method to cause an assertion in debug mode, if this method is called when
     // cyw43_arch_lwip_begin IS needed
     cyw43_arch_lwip_check();
+    TRACE_BEGIN(WEB_RECV, p->tot_len);
     if (p->tot_len > 0)
     {
         // Receive the buffer
-        bool ready = false;
+        web->metrics_.bytes_in(p->tot_len);
         if (client)
         {
-            char buf[64];
-            u16_t ll = 0;
-            while (ll < p->tot_len)
+            if (client->acceptTime() != 0)
             {
-                u16_t l = pbuf_copy_partial(p, buf, sizeof(buf), ll);
-                ll += l;
-                client->addToRqst(buf, l);
+                web->metrics_.tls_handshake(time_us_64() - client->acceptTime());
+                client->setAcceptTime(0);
             }
+            web->receive(*client, p);
         }
 
         altcp_recved(tpcb, p->tot_len);
 
-        if (client)
-        {
-            while (client->rqstIsReady())
-            {
-                if (!client->isWebSocket())
-                {
-                    web->process_rqst(*client);
-                }
-                else
-                {
-                    web->process_websocket(*client);
-                }
-
-                //  Look up again in case client was closed
-                web->findClient(tpcb);
-                if (client)
-                {
-                    client->resetRqst();
-                }
-            }
-        }
+        web->process_input(tpcb);
     }
     else
     {
         WEB::get()->log_->print("Zero length receive from %p\n", tpcb);
     }
     pbuf_free(p);
+    TRACE_END(WEB_RECV, 0);
 
     return ERR_OK;
 }
@@ -459,6 +465,15 @@ err_t WEB::tcp_server_poll(void *arg, struct altcp_pcb *tpcb)
                 web->write_next(client->pcb());
             }
 
+            //  Check for deferred response not completed in time
+            if (client->isDeferExpired())
+            {
+                web->log_->print("Deferred response %d to %p (%d) timed out\n", client->deferred(), tpcb, client->handle());
+                client->clearDeferred();
+                web->send_buffer(tpcb, (void *)"HTTP/1.0 504 Gateway Timeout\r\n\r\n", 32, STAT);
+                web->mark_for_close(tpcb);
+            }
+
             //  Check for idle connections
             if (client->isIdle())
             {
@@ -507,18 +522,19 @@ void WEB::tcp_server_err(void *arg, err_t err)
     altcp_pcb *client_pcb = (altcp_pcb *)arg;
     CLIENT *client = web->findClient(client_pcb);
     WEB::get()->log_->print("Error %d on client %p (%d)\n", err, client_pcb, client ? client->handle() : 0);
+    web->metrics_.error();
     if (client)
     {
         web->deleteClient(client_pcb);
     }
 }
 
-err_t WEB::send_buffer(struct altcp_pcb *client_pcb, void *buffer, u16_t buflen, Allocation allocate)
+err_t WEB::send_buffer(struct altcp_pcb *client_pcb, void *buffer, uint32_t buflen, Allocation allocate, void *base)
 {
     CLIENT *client = get()->findClient(client_pcb);
     if (client)
     {
-        client->queue_send(buffer, buflen, allocate);
+        client->queue_send(buffer, buflen, allocate, base);
         write_next(client_pcb);
     }
     return ERR_OK;
@@ -530,6 +546,7 @@ err_t WEB::write_next(altcp_pcb *client_pcb)
     CLIENT *client = get()->findClient(client_pcb);
     if (client)
     {
+        TRACE_BEGIN(WEB_WRITE, client->handle());
         client->activity();
         u16_t nn = altcp_sndbuf(client_pcb);
         if (nn > TCP_MSS)
@@ -547,14 +564,25 @@ err_t WEB::write_next(altcp_pcb *client_pcb)
             if (err != ERR_OK)
             {
                 log_->print("Failed to write %d bytes of data %d to %p (%d)\n", buflen, err, client_pcb, client->handle());
+                metrics_.write_error();
                 client->requeue(buffer, buflen);
             }
+            else
+            {
+                metrics_.bytes_out(buflen);
+                if (client->rqstTime() != 0)
+                {
+                    metrics_.first_byte(time_us_64() - client->rqstTime());
+                    client->setRqstTime(0);
+                }
+            }
         }
 
         if (client->isClosed() && !client->more_to_send())
         {
             close_client(client_pcb);
         }
+        TRACE_END(WEB_WRITE, err);
     }
     else
     {
@@ -563,24 +591,191 @@ err_t WEB::write_next(altcp_pcb *client_pcb)
     return err;    
 }
 
+void WEB::receive(CLIENT &client, struct pbuf *p)
+{
+    for (struct pbuf *q = p; q != nullptr && !client.isClosed(); q = q->next)
+    {
+        const char *data = static_cast<const char *>(q->payload);
+        std::size_t ll = q->len;
+        if (client.bodySink())
+        {
+            std::size_t used = stream_body(client, data, ll);
+            data += used;
+            ll -= used;
+        }
+        if (ll > 0 && !client.isClosed())
+        {
+            client.addToRqst(data, ll);
+            if (!client.isDeferred())
+            {
+                check_body_stream(client);
+            }
+        }
+    }
+}
+
+bool WEB::check_body_stream(CLIENT &client)
+{
+    if (client.bodySink())
+    {
+        return false;
+    }
+
+    if (!client.isWebSocket() && !client.isClosed() && !client.isBodyChecked()
+        && client.http().parseHeader(client.rqst()))
+    {
+        client.setBodyChecked();
+        bool chunked = client.http().isChunked();
+        std::size_t cl = chunked ? 0 : client.http().contentLength();
+        if ((chunked || cl > 0) && client.http().header("Upgrade") != "websocket")
+        {
+            HTTPBodySink *sink = nullptr;
+            if (body_callback_)
+            {
+                sink = body_callback_(this, client.handle(), client.http(), body_user_data_);
+            }
+
+            //  Without a sink a chunked body is decoded into the request string
+            bool buffered = sink == nullptr && chunked;
+            if (buffered)
+            {
+                sink = new BODYBUF(client.rqst());
+            }
+
+            if (sink)
+            {
+                log_->print_debug(2, "Streaming %sbody from %p (%d)\n", chunked ? "chunked " : "", client.pcb(), client.handle());
+                client.setBodySink(sink, cl, chunked, buffered);
+
+                //  Pass any body already received to the sink
+                std::string &rqst = client.rqst();
+                std::size_t off = client.http().bodyOffset();
+                if (chunked)
+                {
+                    std::string raw = rqst.substr(off);
+                    rqst.erase(off);
+                    std::size_t ll = stream_body(client, raw.data(), raw.size());
+                    if (!client.isClosed() && ll < raw.size())
+                    {
+                        rqst.append(raw, ll, std::string::npos);
+                    }
+                }
+                else
+                {
+                    std::size_t ll = stream_body(client, rqst.data() + off, std::min(rqst.size() - off, cl));
+                    if (!client.isClosed())
+                    {
+                        rqst.erase(off, ll);
+                    }
+                }
+            }
+        }
+    }
+    return client.bodySink() == nullptr && !client.isClosed();
+}
+
+std::size_t WEB::stream_body(CLIENT &client, const char *data, std::size_t len)
+{
+    HTTPBodySink *sink = client.bodySink();
+    std::size_t ll;
+    bool ok;
+    bool done;
+    if (client.isBodyChunked())
+    {
+        ll = client.chunked().decode(data, len, sink);
+        ok = !client.chunked().failed();
+        done = client.chunked().done();
+        client.activity();
+    }
+    else
+    {
+        ll = std::min(len, client.bodyRemaining());
+        ok = ll == 0 || sink->body_data(data, ll);
+        client.consumeBody(ll);
+        done = client.bodyRemaining() == 0;
+    }
+
+    if (ok && done)
+    {
+        ok = sink->body_end();
+        if (ok)
+        {
+            if (client.isBodyBuffered())
+            {
+                //  The header text has changed, so parse it again
+                HTTPRequest::setContentLength(client.rqst(), client.chunked().total());
+                client.http().parseHeader(client.rqst());
+            }
+            else
+            {
+                client.http().setBodyStreamed(true);
+            }
+            client.setBodySink(nullptr, 0);
+        }
+    }
+
+    if (!ok)
+    {
+        log_->print("Request body from %p (%d) rejected\n", client.pcb(), client.handle());
+        const char *resp = sink->error_response();
+        send_buffer(client.pcb(), (void *)resp, strlen(resp), STAT);
+        client.clearRqst();
+        mark_for_close(client.pcb());
+        client.setBodySink(nullptr, 0);
+    }
+    return ll;
+}
+
+void WEB::process_input(struct altcp_pcb *client_pcb)
+{
+    CLIENT *client = findClient(client_pcb);
+    while (client && !client->isDeferred() && check_body_stream(*client) && client->rqstIsReady())
+    {
+        if (!client->isWebSocket())
+        {
+            process_rqst(*client);
+        }
+        else
+        {
+            process_websocket(*client);
+        }
+
+        //  Look up again in case client was closed
+        client = findClient(client_pcb);
+        if (client)
+        {
+            client->resetRqst();
+        }
+    }
+}
+
 void WEB::process_rqst(CLIENT &client)
 {
     bool ok = false;
     bool close = true;
+    TRACE_BEGIN(WEB_RQST, client.handle());
     client.activity();
     log_->print_debug(2, "Request from %p (%d):\n%s\n", client.pcb(), client.handle(), client.rqst().c_str());
     if (!client.isWebSocket())
     {
         ok = true;
+        client.setRqstTime(time_us_64());
         if (client.http().header("Upgrade") == "websocket")
         {
+            metrics_.request(WebMetrics::RQST_UPGRADE);
             open_websocket(client);
         }
         else
         {
-            if (client.http().type() == "POST")
+            std::string_view type = client.http().typeView();
+            if (type == "POST")
             {
-                client.http().parseRequest(client.rqst(), true);
+                metrics_.request(WebMetrics::RQST_POST);
+                client.http().parseBody(client.rqst(), true);
+            }
+            else
+            {
+                metrics_.request(type == "GET" ? WebMetrics::RQST_GET : WebMetrics::RQST_OTHER);
             }
             process_http_rqst(client, close);
         }
@@ -591,10 +786,11 @@ void WEB::process_rqst(CLIENT &client)
         send_buffer(client.pcb(), (void *)"HTTP/1.0 500 Internal Server Error\r\n\r\n", 38);
     }
 
-    if (!client.isWebSocket() && close)
+    if (!client.isWebSocket() && close && !client.isDeferred())
     {
         close_client(client.pcb());
     }
+    TRACE_END(WEB_RQST, close);
 }
 
 void WEB::process_http_rqst(CLIENT &client, bool &close)
@@ -602,7 +798,11 @@ void WEB::process_http_rqst(CLIENT &client, bool &close)
     const char *data;
     u16_t datalen = 0;
     bool is_static = false;
-    if (http_callback_ && http_callback_(this, client.handle(), client.http(), close, http_user_data_))
+    if (!metrics_url_.empty() && client.http().pathView() == metrics_url_)
+    {
+        send_metrics(client);
+    }
+    else if (http_callback_ && http_callback_(this, client.handle(), client.http(), close, http_user_data_))
     {
         ;
     }
@@ -627,6 +827,93 @@ bool WEB::send_data(ClientHandle client, const char *data, u16_t datalen, Alloca
     return clptr != nullptr;
 }
 
+bool WEB::send_data(ClientHandle client, TXT &data)
+{
+    CLIENT *clptr = findClient(client);
+    if (clptr && findClient(clptr->pcb()) == clptr)
+    {
+        char *buffer = data.data();
+        char *base = data.base();
+        uint32_t datalen = data.datasize();
+        Allocation alloc = data.in_arena() ? WEB::ALLOC : WEB::PREALL;
+        data.release();
+        send_buffer(clptr->pcb(), buffer, datalen, alloc, base);
+    }
+    else
+    {
+        log_->print("send_data to non-existent client handle %d\n", client);
+    }
+    return clptr != nullptr;
+}
+
+DeferHandle WEB::defer_response(ClientHandle client, uint32_t timeout_ms)
+{
+    DeferHandle ret = 0;
+    CLIENT *clptr = findClient(client);
+    if (clptr && !clptr->isClosed() && !clptr->isWebSocket())
+    {
+        next_defer_ += 1;
+        if (next_defer_ == 0) next_defer_ = 1;
+        ret = next_defer_;
+        clptr->setDeferred(ret, timeout_ms);
+        log_->print_debug(2, "Response to %p (%d) deferred as %d\n", clptr->pcb(), client, ret);
+    }
+    else
+    {
+        log_->print("defer_response for unavailable client handle %d\n", client);
+    }
+    return ret;
+}
+
+bool WEB::complete_response(DeferHandle handle, bool close)
+{
+    bool ret = false;
+    CYW43Locker lock;
+    CLIENT *client = findDeferred(handle);
+    if (client)
+    {
+        struct altcp_pcb *client_pcb = client->pcb();
+        client->clearDeferred();
+        log_->print_debug(2, "Deferred response %d to %p (%d) complete\n", handle, client_pcb, client->handle());
+        if (close)
+        {
+            close_client(client_pcb);
+        }
+        else
+        {
+            //  Process any requests received while waiting
+            process_input(client_pcb);
+        }
+        ret = true;
+    }
+    else
+    {
+        log_->print_debug(1, "Deferred response %d is no longer pending\n", handle);
+    }
+    return ret;
+}
+
+bool WEB::complete_response(DeferHandle handle, const char *data, u16_t datalen, Allocation allocate, bool close)
+{
+    bool ret = false;
+    CYW43Locker lock;
+    CLIENT *client = findDeferred(handle);
+    if (client)
+    {
+        send_buffer(client->pcb(), (void *)data, datalen, allocate);
+        ret = complete_response(handle, close);
+    }
+    else
+    {
+        log_->print_debug(1, "Deferred response %d is no longer pending\n", handle);
+        if (allocate == PREALL)
+        {
+            delete [] data;
+        }
+    }
+    return ret;
+}
+
 void WEB::open_websocket(CLIENT &client)
 {
     log_->print_debug(1, "Accepting websocket connection on %p (handle %d) url: %s\n", client.pcb(), client.handle(), client.http().url().c_str());
@@ -666,9 +953,42 @@ void WEB::open_websocket(CLIENT &client)
     }
 }
 
+void WEB::send_metrics(CLIENT &client)
+{
+    WebMetrics::ClientDepths depths;
+    depths.reserve(clientHndl_.size());
+    for (auto it = clientHndl_.cbegin(); it != clientHndl_.cend(); ++it)
+    {
+        depths.emplace_back(it->first, it->second->send_depth());
+    }
+    std::string format = client.http().query("format");
+    bool json = format == "json";
+    std::string body;
+    if (format == "trace")
+    {
+        Trace::dump(body);
+    }
+    else if (json)
+    {
+        metrics_.json(body, depths);
+    }
+    else
+    {
+        metrics_.prometheus(body, depths);
+    }
+    std::string resp("HTTP/1.1 200 OK\r\nContent-Type: ");
+    resp += json ? "application/json" : "text/plain; version=0.0.4";
+    resp += "\r\nContent-Length: ";
+    resp += std::to_string(body.size());
+    resp += "\r\n\r\n";
+    send_buffer(client.pcb(), (void *)resp.c_str(), resp.size());
+    send_buffer(client.pcb(), (void *)body.c_str(), body.size());
+}
+
 void WEB::process_websocket(CLIENT &client)
 {
     client.activity();
+    metrics_.request(WebMetrics::RQST_WS_MESSAGE);
     std::string func;
     uint8_t opc = client.wshdr().meta.bits.OPCODE;
     std::string payload = client.rqst().substr(client.wshdr().start, client.wshdr().length);
@@ -725,9 +1045,11 @@ bool WEB::send_message(ClientHandle client, TXT &message)
         log_->print_debug(2, "%p (%d) message: %s\n", clptr->pcb(), clptr->handle(), message.data());
         WS::BuildPacket(WEBSOCKET_OPCODE_TEXT, message, false);
         char *data = message.data();
+        char *base = message.base();
         uint32_t datalen = message.datasize();
+        Allocation alloc = message.in_arena() ? WEB::ALLOC : WEB::PREALL;
         message.release();
-        send_buffer(clptr->pcb(), data, datalen, WEB::PREALL);
+        send_buffer(clptr->pcb(), data, datalen, alloc, base);
     }
     else
     {
@@ -738,9 +1060,14 @@ bool WEB::send_message(ClientHandle client, TXT &message)
 
 void WEB::send_websocket(struct altcp_pcb *client_pcb, enum WebSocketOpCode opc, const std::string &payload, bool mask)
 {
-    std::string msg;
-    WS::BuildPacket(opc, payload, msg, mask);
-    send_buffer(client_pcb, (void *)msg.c_str(), msg.length());
+    //  Copy the payload once, leaving headroom for the frame header
+    TXT msg(payload.data(), payload.length(), payload.length() + 1, WS::HEADROOM);
+    WS::BuildPacket(opc, msg, mask);
+    char *data = msg.data();
+    char *base = msg.base();
+    uint32_t datalen = msg.datasize();
+    msg.release();
+    send_buffer(client_pcb, data, datalen, PREALL, base);
 }
 
 void WEB::broadcast_websocket(const std::string &txt)
@@ -772,7 +1099,7 @@ void WEB::broadcast_websocket(TXT &txt)
         {
             if (--nwsc > 0)
             {
-                TXT txt1(txt.data(), txt.datasize(), txt.datasize() + 16);
+                TXT txt1(txt.data(), txt.datasize(), txt.datasize() + 1, WS::HEADROOM);
                 send_message(it->first, txt1);
             }
             else
@@ -986,6 +1313,7 @@ void WEB::check_scan_finished()
 
 bool WEB::timer_callback(repeating_timer_t *rt)
 {
+    get()->metrics_.sample_heap();
     get()->check_wifi();
     get()->check_scan_finished();
     return true;
@@ -1028,6 +1356,7 @@ void WEB::stop_ap()
 
 WEB::CLIENT::~CLIENT()
 {
+    delete body_sink_;
     while (sendbuf_.size() > 0)
     {
         delete sendbuf_.front();
@@ -1035,6 +1364,16 @@ WEB::CLIENT::~CLIENT()
     }
 }
 
+void WEB::CLIENT::setBodySink(HTTPBodySink *sink, std::size_t length, bool chunked, bool buffered)
+{
+    delete body_sink_;
+    body_sink_ = sink;
+    body_remaining_ = length;
+    body_chunked_ = chunked;
+    body_buffered_ = buffered;
+    chunked_.reset();
+}
+
 void WEB::CLIENT::addToRqst(const char *str, u16_t ll)
 {
     rqst_.append(str, ll);
@@ -1045,7 +1384,8 @@ bool WEB::CLIENT::rqstIsReady()
     bool ret = false;
     if (!isWebSocket())
     {
-        ret = http_.parseRequest(rqst_, false);
+        //  The header has been parsed if the body was checked
+        ret = body_checked_ ? http_.parseBody(rqst_, false) : http_.parseRequest(rqst_, false);
     }
     else
     {
@@ -1054,10 +1394,11 @@ bool WEB::CLIENT::rqstIsReady()
     return ret;
 }
 
-void WEB::CLIENT::queue_send(void *buffer, u16_t buflen, Allocation allocate)
+void WEB::CLIENT::queue_send(void *buffer, uint32_t buflen, Allocation allocate, void *base)
 {
-    WEB::SENDBUF *sbuf = new WEB::SENDBUF(buffer, buflen, allocate);
+    WEB::SENDBUF *sbuf = new WEB::SENDBUF(buffer, buflen, allocate, base);
     sendbuf_.push_back(sbuf);
+    WEB::get()->metrics_.send_queued(sendbuf_.size());
 }
 
 bool WEB::CLIENT::get_next(u16_t count, void **buffer, u16_t *buflen)
@@ -1117,6 +1458,8 @@ void WEB::CLIENT::resetRqst()
             rqst_.clear();
         }
         http_.clear();
+        http_.setBodyStreamed(false);
+        body_checked_ = false;
     }
     else
     {
@@ -1135,7 +1478,7 @@ void WEB::CLIENT::resetRqst()
 bool WEB::CLIENT::isIdle() const
 {
     bool ret = false;
-    if (!isClosed())
+    if (!isClosed() && !isDeferred())
     {
         int64_t idle = absolute_time_diff_us(last_activity_, get_absolute_time()) / 60000000LL;
         if (isWebSocket())
@@ -1177,13 +1520,14 @@ ClientHandle WEB::CLIENT::nextHandle()
     return next_handle_;
 }
 
-WEB::SENDBUF::SENDBUF(void *buf, uint32_t size, Allocation alloc)
- : buffer_((uint8_t *)buf), size_(size), sent_(0), ack_(0), allocated_(alloc)
+WEB::SENDBUF::SENDBUF(void *buf, uint32_t size, Allocation alloc, void *base)
+ : buffer_((uint8_t *)buf), base_(base ? (uint8_t *)base : (uint8_t *)buf), size_(size), sent_(0), ack_(0), allocated_(alloc)
 {
     if (allocated_ == ALLOC)
     {
         buffer_ = new uint8_t[size];
         memcpy(buffer_, buf, size);
+        base_ = buffer_;
     }
 }
 
@@ -1191,7 +1535,7 @@ WEB::SENDBUF::~SENDBUF()
 {
     if (allocated_ != STAT)
     {
-        delete [] buffer_;
+        delete [] base_;
     }
 }
 
@@ -1223,6 +1567,7 @@ void WEB::SENDBUF::requeue(void *buffer, u16_t buflen)
         if (memcmp(&buffer_[nn], buffer, buflen) == 0)
         {
             sent_ = nn;
+            WEB::get()->metrics_.requeued();
             WEB::get()->log_->print("%d bytes requeued\n", buflen);
         }
         else
@@ -16,7 +16,9 @@ extern "C"
 }
 #include "pico/time.h"
 #include "httprequest.h"
+#include "chunked.h"
 #include "ws.h"
+#include "webmetrics.h"
 #include "logger.h"
 #include "txt.h"
 
@@ -68,6 +70,16 @@ class WEB;
  */
 typedef uint32_t   ClientHandle;
 
+/**
+ * @typedef DeferHandle
+ * 
+ * @brief   Handle to a deferred HTTP response
+ * 
+ * An opaque value returned by WEB::defer_response and used to complete
+ * the response later. A value of zero indicates an invalid handle.
+ */
+typedef uint32_t   DeferHandle;
+
 /**
  * @brief   Data returned by WiFI scan
  * 
@@ -106,14 +118,15 @@ private:
     {
     private:
         uint8_t     *buffer_;                   // Buffer pointer
+        uint8_t     *base_;                     // Allocated buffer to delete (may precede buffer_)
         int32_t     size_;                      // Buffer length
         int32_t     sent_;                      // Bytes sent
         int32_t     ack_;                       // Bytes acknowledged
         Allocation  allocated_;                 // Buffer allocation type
 
     public:
-        SENDBUF() : buffer_(nullptr), size_(0), sent_(0), ack_(0), allocated_(ALLOC) {}
-        SENDBUF(void *buf, uint32_t size, Allocation alloc = ALLOC);
+        SENDBUF() : buffer_(nullptr), base_(nullptr), size_(0), sent_(0), ack_(0), allocated_(ALLOC) {}
+        SENDBUF(void *buf, uint32_t size, Allocation alloc = ALLOC, void *base = nullptr);
         ~SENDBUF();
 
         uint32_t to_send() const { return size_ - sent_; }
@@ -124,6 +137,17 @@ private:
         bool isAcknowledged() const { return ack_ == size_; }
     };
 
+    class BODYBUF : public HTTPBodySink
+    {
+    private:
+        std::string &rqst_;                         // Request receiving decoded body
+
+    public:
+        BODYBUF(std::string &rqst) : rqst_(rqst) {}
+        virtual bool body_data(const char *data, std::size_t len) { rqst_.append(data, len); return true; }
+        virtual bool body_end() { return true; }
+    };
+
     class CLIENT
     {
     private:
@@ -139,15 +163,30 @@ private:
 
         absolute_time_t         last_activity_;     // Time of last activity
 
+        DeferHandle             defer_;             // Pending deferred response
+        absolute_time_t         defer_limit_;       // Time limit for deferred response
+
+        HTTPBodySink            *body_sink_;        // Sink receiving request body
+        std::size_t             body_remaining_;    // Body bytes still to be received
+        bool                    body_checked_;      // Body callback called for request
+        bool                    body_chunked_;      // Body has chunked transfer encoding
+        bool                    body_buffered_;     // Body decoded into request string
+        ChunkedDecoder          chunked_;           // Chunked body decoder
+
+        uint64_t                accept_time_;       // Time TLS connection accepted (0 after first data)
+        uint64_t                rqst_time_;         // Time request received (0 after first response byte)
+
         ClientHandle            handle_;            // Client handle
         static ClientHandle     next_handle_;       // Next handle
         static ClientHandle     nextHandle();       // Get next handle
 
-        CLIENT() : pcb_(nullptr), closed_(true), websocket_(false), handle_(0) {}
+        CLIENT() : pcb_(nullptr), closed_(true), websocket_(false), defer_(0), body_sink_(nullptr), body_remaining_(0), body_checked_(false),
+                   body_chunked_(false), body_buffered_(false), accept_time_(0), rqst_time_(0), handle_(0) {}
 
     public:
         CLIENT(struct altcp_pcb *client_pcb)
-         : pcb_(client_pcb), closed_(false), websocket_(false), ws_close_sent_(false)
+         : pcb_(client_pcb), closed_(false), websocket_(false), ws_close_sent_(false), defer_(0), body_sink_(nullptr), body_remaining_(0), body_checked_(false),
+           body_chunked_(false), body_buffered_(false), accept_time_(0), rqst_time_(0)
           { rqst_.reserve(1024), activity(); handle_ = nextHandle(); }
         ~CLIENT();
 
@@ -172,15 +211,37 @@ private:
         bool wasWSCloseSent() const { return ws_close_sent_; }
         void setWSCloseSent() { activity(); ws_close_sent_ = true; }
 ; 
-        void queue_send(void *buffer, u16_t buflen, Allocation allocate);
+        void queue_send(void *buffer, uint32_t buflen, Allocation allocate, void *base = nullptr);
         bool get_next(u16_t count, void **buffer, u16_t *buflen);
         bool more_to_send(bool quick=true) const { return sendbuf_.size() > 0; }
+        uint32_t send_depth() const { return sendbuf_.size(); }
         void requeue(void *buffer, u16_t buflen);
         void acknowledge(int count);
 
         bool isIdle() const;
         void activity() { if (!ws_close_sent_) last_activity_ = get_absolute_time(); }
 
+        void setDeferred(DeferHandle handle, uint32_t timeout_ms) { defer_ = handle; defer_limit_ = make_timeout_time_ms(timeout_ms); activity(); }
+        void clearDeferred() { defer_ = 0; activity(); }
+        DeferHandle deferred() const { return defer_; }
+        bool isDeferred() const { return defer_ != 0; }
+        bool isDeferExpired() const { return defer_ != 0 && absolute_time_diff_us(defer_limit_, get_absolute_time()) > 0; }
+
+        void setBodySink(HTTPBodySink *sink, std::size_t length, bool chunked = false, bool buffered = false);
+        HTTPBodySink *bodySink() const { return body_sink_; }
+        std::size_t bodyRemaining() const { return body_remaining_; }
+        bool isBodyChunked() const { return body_chunked_; }
+        bool isBodyBuffered() const { return body_buffered_; }
+        ChunkedDecoder &chunked() { return chunked_; }
+        void consumeBody(std::size_t count) { body_remaining_ -= count; activity(); }
+        void setBodyChecked() { body_checked_ = true; }
+        bool isBodyChecked() const { return body_checked_; }
+
+        void setAcceptTime(uint64_t us) { accept_time_ = us; }
+        uint64_t acceptTime() const { return accept_time_; }
+        void setRqstTime(uint64_t us) { rqst_time_ = us; }
+        uint64_t rqstTime() const { return rqst_time_; }
+
         const ClientHandle &handle() const { return handle_; }
     };
     std::map<ClientHandle, CLIENT *> clientHndl_;           // Connected clients by handle
@@ -189,6 +250,7 @@ private:
     void    deleteClient(struct altcp_pcb *pcb);
     CLIENT *findClient(ClientHandle handle);
     CLIENT *findClient(struct altcp_pcb *pcb);
+    CLIENT *findDeferred(DeferHandle handle);
 
     static err_t tcp_server_accept(void *arg, struct altcp_pcb *client_pcb, err_t err);
     static err_t tcp_server_recv(void *arg, struct altcp_pcb *tpcb, struct pbuf *p, err_t err);
@@ -196,6 +258,10 @@ private:
     static err_t tcp_server_poll(void *arg, struct altcp_pcb *tpcb);
     static void  tcp_server_err(void *arg, err_t err);
 
+    void receive(CLIENT &client, struct pbuf *p);
+    bool check_body_stream(CLIENT &client);
+    std::size_t stream_body(CLIENT &client, const char *data, std::size_t len);
+    void process_input(struct altcp_pcb *client_pcb);
     void process_rqst(CLIENT &client);
     void process_http_rqst(CLIENT &client, bool &close);
     void open_websocket(CLIENT &client);
@@ -217,6 +283,8 @@ private:
     uint32_t        reconnect_time_;        // Time until retry of connection
     const uint32_t  reconnect_interval_ = 300000 / 500; // Timer intervals for retry (5 min)
 
+    DeferHandle     next_defer_;            // Next deferred response handle
+
     void check_wifi();
 
     struct ScanRqst
@@ -244,15 +312,21 @@ private:
 
     Logger              default_logger_;            // Default logger
     Logger              *log_;                      // Active logger
+
+    WebMetrics          metrics_;                   // Runtime counters
+    std::string         metrics_url_;               // Path serving metrics (empty if disabled)
+    void send_metrics(CLIENT &client);
     
     static WEB          *singleton_;                // Singleton pointer
     WEB();
 
-    err_t send_buffer(struct altcp_pcb *client_pcb, void *buffer, u16_t buflen, Allocation allocate = ALLOC);
+    err_t send_buffer(struct altcp_pcb *client_pcb, void *buffer, uint32_t buflen, Allocation allocate = ALLOC, void *base = nullptr);
     err_t write_next(struct altcp_pcb *client_pcb);
 
     bool (*http_callback_)(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close, void *user_data);
     void *http_user_data_;
+    HTTPBodySink *(*body_callback_)(WEB *web, ClientHandle client, HTTPRequest &rqst, void *user_data);
+    void *body_user_data_;
     void (*message_callback_)(WEB *web, ClientHandle client, const std::string &msg, void *user_data);
     void *message_user_data_;
     void (*notice_callback_)(int state, void *user_data);
@@ -371,10 +445,42 @@ public:
      * 
      *          -Callback to return true if it handled the request. If returns false,
      *          an error response is sent to client and connection is closed.
+     * 
+     *          -A callback that cannot produce the response immediately (WiFi scan,
+     *          IR capture, slow sensor read) can call defer_response and return
+     *          true. The connection is then held open until complete_response
+     *          is called or the deferral times out.
      */
     void set_http_callback(bool (*cb)(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close, void *udata), void *user_data = nullptr)
                          { http_callback_ = cb; http_user_data_ = user_data; }
 
+    /**
+     * @brief   Set callback for streaming request bodies
+     * 
+     * @param   cb          Pointer to callback function
+     * @param   user_data   User data passed to callback
+     * 
+     * @details Called when the header of a request with a body has been
+     *          received. The callback takes the following parameters:
+     * 
+     *              -web    Pointer to the WEB object
+     *              -client Handle to client connection
+     *              -rqst   HTTP request object (header only)
+     *              -udata  User data
+     * 
+     *          -Callback returns a new HTTPBodySink to receive the body as it
+     *          arrives or nullptr to buffer the body in the request as usual.
+     *          The sink is deleted by the WEB object.
+     * 
+     *          -When the whole body has been accepted by the sink the HTTP
+     *          callback is called with an empty body. If the sink rejects the
+     *          body, its error response is sent and the connection is closed.
+     * 
+     *          -MultipartParser is a sink for file uploads.
+     */
+    void set_body_callback(HTTPBodySink *(*cb)(WEB *web, ClientHandle client, HTTPRequest &rqst, void *udata), void *user_data = nullptr)
+                         { body_callback_ = cb; body_user_data_ = user_data; }
+
     /**
      * @brief   Set callback for receipt of websocket text message
      * 
@@ -454,12 +560,70 @@ public:
      */
     bool send_data(ClientHandle client, const char *data, u16_t datalen, Allocation allocate=ALLOC);
 
+    /**
+     * @brief   Send HTTP message in a TXT object
+     * 
+     * @param   client      Handle of client connection
+     * @param   data        Message. The TXT buffer is passed to the WEB
+     *                      object without copying and the TXT is released.
+     * 
+     * @return  true if send queued successfully
+     */
+    bool send_data(ClientHandle client, TXT &data);
+
+    /**
+     * @brief   Defer the response to the current HTTP request
+     * 
+     * @param   client      Handle of client connection
+     * @param   timeout_ms  Time allowed for the response (milliseconds)
+     * 
+     * @details Called from the HTTP callback when the response is to be
+     *          produced later. The close flag set by the callback is ignored
+     *          and the connection is held open. Further requests from the
+     *          client are queued until the response is completed. If the
+     *          response is not completed in time, a 504 response is sent and
+     *          the connection is closed. Data may be sent with send_data while
+     *          the response is pending.
+     * 
+     * @return  Handle for complete_response (zero if client not found)
+     */
+    DeferHandle defer_response(ClientHandle client, uint32_t timeout_ms = 30000);
+
+    /**
+     * @brief   Complete a deferred HTTP response
+     * 
+     * @param   handle      Handle returned by defer_response
+     * @param   data        Pointer to response data
+     * @param   datalen     Number of bytes to send from data buffer
+     * @param   allocate    Type of buffer allocation as for send_data. A PREALL
+     *                      buffer is deleted if the response is no longer pending.
+     * @param   close       Close connection after the response is sent
+     * 
+     * @details May be called from any non-interrupt context, for example from
+     *          a WiFi scan callback or the application's main loop.
+     * 
+     * @return  true if the response was pending and has been completed
+     */
+    bool complete_response(DeferHandle handle, bool close = true);
+    bool complete_response(DeferHandle handle, const char *data, u16_t datalen, Allocation allocate=ALLOC, bool close = true);
+
+    /**
+     * @brief   Test if a deferred response is still pending
+     * 
+     * @param   handle      Handle returned by defer_response
+     * 
+     * @return  true if the client is connected and awaiting the response
+     */
+    bool is_response_pending(DeferHandle handle) { return findDeferred(handle) != nullptr; }
+
     /**
      * @brief   Send a text message on websocket
      * 
      * @param   client      Handle of client connection
      * @param   message     Message to be sent
-     *                      Note: TXT is released
+     *                      Note: TXT is released. The frame header is
+     *                      placed in the headroom if it has at least
+     *                      WS::HEADROOM bytes, so the message is not moved.
      * 
      * @return  true if send queued successfully
      */
@@ -496,6 +660,9 @@ public:
      *              -client     Handle to client connection passed in scan_wifi call
      *              -ssids      map of SSID names and their signal strength
      *              -user_data  User data pointer passed in scan_wifi call
+     * 
+     *          When started from an HTTP callback, the response can be deferred
+     *          with defer_response and completed from the scan callback.
      */
     void scan_wifi(ClientHandle client, WiFiScan_cb callback, void *user_data = nullptr);
 
@@ -512,6 +679,23 @@ public:
      * @param   logger      Pointer to logger class to use
      */
     void setLogger(Logger *logger=nullptr) { if (logger) log_ = logger; else log_ = &default_logger_; }
+
+    /**
+     * @brief   Serve runtime metrics at a URL
+     * 
+     * @param   url         Path of metrics (empty to disable, the default)
+     * 
+     * @details Metrics are returned in Prometheus text format, or as JSON
+     *          if the query includes format=json. The Trace rings are
+     *          returned for format=trace. Requests for the URL are
+     *          answered before the HTTP callback is called.
+     */
+    void set_metrics_url(const std::string &url) { metrics_url_ = url; }
+
+    /**
+     * @brief   Get the runtime metrics
+     */
+    WebMetrics &metrics() { return metrics_; }
 };
 
 #endif
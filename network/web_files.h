@@ -2,11 +2,21 @@
 #define WEB_FILES_H
 
 #include "web.h"
+#include "httprouter.h"
+#include "text_template.h"
 
 #include <string>
 #include <stdint.h>
 #include <map>
 #include <utility>
+
+#ifndef WEB_TEMPLATE_CHUNK
+#define WEB_TEMPLATE_CHUNK  1460    // Size of buffers sending template values
+#endif
+#ifndef WEB_TEMPLATE_DIRECT
+#define WEB_TEMPLATE_DIRECT 256     // Template text sent without copying from this size
+#endif
+
 /**
  * @class   WEB_FILES
  * 
@@ -31,11 +41,17 @@
  * 
  * @see picolibs/network/CMakeLists.txt for web_files function
  *
+ * A text file containing %NAME% placeholders can be sent as a template
+ * with send_template. The file is scanned once, on first use, and each
+ * response is sent from the file text and the values without building
+ * the page (see TextTemplate).
  */
 class WEB_FILES
 {
 private:
     std::map<std::string, std::pair<const char *, int> > files_;
+    std::map<std::string, TextTemplate> templates_;     // Templates compiled from files
+    TextTemplate ws_js_;                                // websocket.js with path placeholder
 
     static WEB_FILES *singleton_;
     WEB_FILES();
@@ -57,6 +73,46 @@ public:
      */
     bool get_file(const std::string &name, const char * &data, uint16_t &datalen);
 
+    /**
+     * @brief   Get a file compiled as a template
+     * 
+     * @param   name    File name
+     * 
+     * @return  Template (null if file not found)
+     */
+    const TextTemplate *get_template(const std::string &name);
+
+    /**
+     * @brief   Send a precompiled file as a template
+     * 
+     * @param   web         Pointer to WEB object
+     * @param   client      Handle of client connection
+     * @param   name        File name
+     * @param   provider    Function providing values of the placeholders
+     * @param   udata       User data for provider
+     * 
+     * @return  true if file found and sent
+     */
+    bool send_template(WEB *web, ClientHandle client, const std::string &name, TextTemplate::Provider provider, void *udata);
+
+    /**
+     * @brief   Send a rendered template
+     * 
+     * @details Literal text of WEB_TEMPLATE_DIRECT bytes or more is queued
+     *          without copying, so the template must not be changed or
+     *          deleted until the response has been sent. Other text is
+     *          copied into buffers of WEB_TEMPLATE_CHUNK bytes.
+     * 
+     * @param   web         Pointer to WEB object
+     * @param   client      Handle of client connection
+     * @param   tmpl        Template
+     * @param   provider    Function providing values of the placeholders
+     * @param   udata       User data for provider
+     * 
+     * @return  true if sent
+     */
+    static bool send_template(WEB *web, ClientHandle client, const TextTemplate &tmpl, TextTemplate::Provider provider, void *udata);
+
     /**
      * @brief	Send websocket.js file if requested
      *
@@ -68,6 +124,26 @@ public:
      * @param	wspath	    String to set for websocket path (default /ws/)
      */
     bool send_websocket_js(WEB *web, ClientHandle client, HTTPRequest &rqst, bool &close, const std::string &wspath = std::string());
+
+    /**
+     * @brief   HTTPRouter handler sending a precompiled file
+     * 
+     * @details The file name is the request path without the leading '/'
+     *          (or the tail of a prefix route if set). A path of "/" sends
+     *          index.html. Use as a fallback route:
+     * @code
+     *    router.add_fallback(WEB_FILES::route_file);
+     * @endcode
+     */
+    static bool route_file(WEB *web, ClientHandle client, HTTPRequest &rqst, const HTTPRouter::Params &params, bool &close, void *udata);
+
+    /**
+     * @brief   HTTPRouter handler sending websocket.js
+     * 
+     * @details The user data may point to a null terminated websocket path
+     *          as for send_websocket_js
+     */
+    static bool route_websocket_js(WEB *web, ClientHandle client, HTTPRequest &rqst, const HTTPRouter::Params &params, bool &close, void *udata);
 };
 
 #endif
@@ -0,0 +1,29 @@
+//                  *****  WEB_FILES router handlers  *****
+
+#include "web_files.h"
+
+bool WEB_FILES::route_file(WEB *web, ClientHandle client, HTTPRequest &rqst, const HTTPRouter::Params &params, bool &close, void *)
+{
+    bool ret = false;
+    std::string_view path = params.tail().empty() ? rqst.pathView() : params.tail();
+    while (!path.empty() && path.front() == '/')
+    {
+        path.remove_prefix(1);
+    }
+    std::string name = path.empty() ? std::string("index.html") : std::string(path);
+
+    const char *data;
+    u16_t datalen;
+    if (WEB_FILES::get()->get_file(name, data, datalen))
+    {
+        ret = web->send_data(client, data, datalen, WEB::STAT);
+        close = !ret;
+    }
+    return ret;
+}
+
+bool WEB_FILES::route_websocket_js(WEB *web, ClientHandle client, HTTPRequest &rqst, const HTTPRouter::Params &, bool &close, void *udata)
+{
+    const char *wspath = static_cast<const char *>(udata);
+    return WEB_FILES::get()->send_websocket_js(web, client, rqst, close, wspath ? std::string(wspath) : std::string());
+}
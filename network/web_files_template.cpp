@@ -0,0 +1,107 @@
+//                  *****  WEB_FILES template methods  *****
+
+#include "web_files.h"
+#include <string.h>
+#include <tuple>
+
+namespace
+{
+    /**
+     * Queue rendered text, copying short pieces into send buffers
+     */
+    struct TemplateSender
+    {
+        WEB             *web;               // Web server
+        ClientHandle    client;             // Client connection
+        char            *buffer;            // Buffer being filled
+        uint32_t        len;                // Bytes in buffer
+        bool            ok;                 // Client still connected
+
+        TemplateSender(WEB *web, ClientHandle client)
+         : web(web), client(client), buffer(nullptr), len(0), ok(true) {}
+
+        ~TemplateSender() { delete [] buffer; }
+
+        void flush()
+        {
+            if (buffer && len > 0)
+            {
+                ok = ok && web->send_data(client, buffer, len, WEB::PREALL);
+                if (!ok)
+                {
+                    delete [] buffer;
+                }
+                buffer = nullptr;
+                len = 0;
+            }
+        }
+
+        static bool sink(const char *data, uint32_t size, bool literal, void *udata)
+        {
+            TemplateSender *ts = static_cast<TemplateSender *>(udata);
+            if (literal && size >= WEB_TEMPLATE_DIRECT)
+            {
+                ts->flush();
+                while (ts->ok && size > 0)
+                {
+                    uint32_t nn = size > 0xffff ? 0xffff : size;
+                    ts->ok = ts->web->send_data(ts->client, data, nn, WEB::STAT);
+                    data += nn;
+                    size -= nn;
+                }
+            }
+            while (ts->ok && size > 0)
+            {
+                if (!ts->buffer)
+                {
+                    ts->buffer = new char[WEB_TEMPLATE_CHUNK];
+                }
+                uint32_t nn = WEB_TEMPLATE_CHUNK - ts->len;
+                if (nn > size)
+                {
+                    nn = size;
+                }
+                memcpy(ts->buffer + ts->len, data, nn);
+                ts->len += nn;
+                data += nn;
+                size -= nn;
+                if (ts->len == WEB_TEMPLATE_CHUNK)
+                {
+                    ts->flush();
+                }
+            }
+            return ts->ok;
+        }
+    };
+}
+
+const TextTemplate *WEB_FILES::get_template(const std::string &name)
+{
+    auto it = templates_.find(name);
+    if (it == templates_.end())
+    {
+        const char *data;
+        uint16_t datalen;
+        if (!get_file(name, data, datalen))
+        {
+            return nullptr;
+        }
+        it = templates_.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple()).first;
+        it->second.compile(data, datalen);
+    }
+    return &it->second;
+}
+
+bool WEB_FILES::send_template(WEB *web, ClientHandle client, const std::string &name, TextTemplate::Provider provider, void *udata)
+{
+    const TextTemplate *tmpl = get_template(name);
+    return tmpl && send_template(web, client, *tmpl, provider, udata);
+}
+
+bool WEB_FILES::send_template(WEB *web, ClientHandle client, const TextTemplate &tmpl, TextTemplate::Provider provider, void *udata)
+{
+    TemplateSender ts(web, client);
+    tmpl.render(provider, udata, TemplateSender::sink, &ts);
+    ts.flush();
+    return ts.ok;
+}
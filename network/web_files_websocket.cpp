@@ -19,18 +19,18 @@ bool WEB_FILES::send_websocket_js(WEB *web, ClientHandle client, HTTPRequest &rq
             }
             else
             {
-                TXT js(data, datalen, datalen + 2 * wspath.length());
-                while (js.substitute("/ws/", "<ws>")); // In case wspath constains /ws/
-                while (js.substitute("<ws>", wspath));
-
-                uint32_t ii = js.find("Content-Length:") + 16;
-                uint32_t ll = strstr(js.data() + ii, "\r\n") - (js.data() + ii);
-                uint32_t jj = js.find("\r\n\r\n") + 4;
-                char numbuf[16];
-                snprintf(numbuf, sizeof(numbuf), "%d", js.datasize() - jj);
-                js.replace(ii, ll, numbuf);
-                ret = web->send_data(client, js.data(), js.datasize(), WEB::PREALL);
-                js.release();
+                if (ws_js_.empty())
+                {
+                    static const char *const path[] = { "/ws/" };
+                    ws_js_.compile(data, datalen, path, 1);
+                }
+                uint32_t len;
+                char *js = ws_js_.render(TextTemplate::array_provider, (void *)&wspath, len);
+                ret = web->send_data(client, js, len, WEB::PREALL);
+                if (!ret)
+                {
+                    delete [] js;
+                }
                 close = !ret;
             }
         }
@@ -0,0 +1,143 @@
+//                  *****  WEB_LOG Implementation  *****
+
+#include "web_log.h"
+#include "file_logger.h"
+#include "log_query.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    static const int CHUNK_HEAD = 6;        // "hhhh\r\n"
+    static const int CHUNK_TAIL = 2;        // "\r\n"
+
+    static_assert(WEB_LOG_CHUNK <= 0xffff, "WEB_LOG_CHUNK size must fit in four hex digits");
+
+    /**
+     * Collect response text into chunks, each sent as a preallocated buffer
+     */
+    struct ChunkWriter
+    {
+        WEB             *web;               // Web server
+        ClientHandle    client;             // Client connection
+        char            *buffer;            // Chunk being filled
+        int             len;                // Bytes of data in chunk
+        bool            ok;                 // Client still connected
+
+        ChunkWriter(WEB *web, ClientHandle client)
+         : web(web), client(client), buffer(nullptr), len(0), ok(true) {}
+
+        ~ChunkWriter() { delete [] buffer; }
+
+        void flush()
+        {
+            if (buffer && len > 0)
+            {
+                static const char hex[] = "0123456789abcdef";
+                for (int ii = 0; ii < 4; ++ii)
+                {
+                    buffer[ii] = hex[(len >> (12 - 4 * ii)) & 15];
+                }
+                memcpy(buffer + 4, "\r\n", 2);
+                memcpy(buffer + CHUNK_HEAD + len, "\r\n", CHUNK_TAIL);
+                ok = ok && web->send_data(client, buffer, CHUNK_HEAD + len + CHUNK_TAIL, WEB::PREALL);
+                if (!ok)
+                {
+                    delete [] buffer;
+                }
+                buffer = nullptr;
+                len = 0;
+            }
+        }
+
+        bool add(const char *text, int size)
+        {
+            while (ok && size > 0)
+            {
+                if (!buffer)
+                {
+                    buffer = new char[CHUNK_HEAD + WEB_LOG_CHUNK + CHUNK_TAIL];
+                }
+                int nn = WEB_LOG_CHUNK - len;
+                if (nn > size)
+                {
+                    nn = size;
+                }
+                memcpy(buffer + CHUNK_HEAD + len, text, nn);
+                len += nn;
+                text += nn;
+                size -= nn;
+                if (len == WEB_LOG_CHUNK)
+                {
+                    flush();
+                }
+            }
+            return ok;
+        }
+
+        static bool emit(const char *line, int len, void *udata)
+        {
+            return static_cast<ChunkWriter *>(udata)->add(line, len);
+        }
+    };
+}
+
+bool WEB_LOG::route_log(WEB *web, ClientHandle client, HTTPRequest &rqst, const HTTPRouter::Params &, bool &close, void *udata)
+{
+    FileLogger *log = static_cast<FileLogger *>(udata);
+    if (!log)
+    {
+        return false;
+    }
+
+    LogQuery query;
+    std::string value = rqst.query("level");
+    if (value == "error")
+    {
+        query.level(FileLogger::LEVEL_ERROR);
+    }
+    else if (!value.empty())
+    {
+        query.level(atoi(value.c_str()));
+    }
+    value = rqst.query("since");
+    if (value == "boot")
+    {
+        query.since_boot();
+        value.clear();
+    }
+    query.time_range(strtoul(value.c_str(), nullptr, 10), strtoul(rqst.query("until").c_str(), nullptr, 10));
+    query.contains(rqst.query("q"));
+    query.match(rqst.query("match"));
+    query.client(atoi(rqst.query("client").c_str()));
+    value = rqst.query("limit");
+    if (!value.empty())
+    {
+        query.limit(atoi(value.c_str()));
+    }
+    value = rqst.query("cursor");
+    if (!value.empty() && !query.cursor(value.c_str()))
+    {
+        static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        return web->send_data(client, bad, sizeof(bad) - 1, WEB::STAT);
+    }
+
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n";
+    if (!web->send_data(client, head, sizeof(head) - 1, WEB::STAT))
+    {
+        close = true;
+        return true;
+    }
+    ChunkWriter out(web, client);
+    if (!query.run(*log, ChunkWriter::emit, &out))
+    {
+        out.add("# log not readable\n", 19);
+    }
+    std::string tail = "# cursor=" + query.next() + (query.more() ? " more=1\n" : " more=0\n");
+    out.add(tail.c_str(), tail.size());
+    out.flush();
+    static const char last[] = "0\r\n\r\n";
+    close = !(out.ok && web->send_data(client, last, sizeof(last) - 1, WEB::STAT));
+    return true;
+}
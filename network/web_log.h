@@ -0,0 +1,53 @@
+//                  *****  WEB_LOG Class  *****
+
+#ifndef WEB_LOG_H
+#define WEB_LOG_H
+
+#include "web.h"
+#include "httprouter.h"
+
+#ifndef WEB_LOG_CHUNK
+#define WEB_LOG_CHUNK   1024        // Response chunk size
+#endif
+
+/**
+ * @class   WEB_LOG
+ * 
+ * This static class serves queries of a FileLogger log over HTTP, for
+ * example:
+ * 
+ * @code
+ *    router.add("GET", "/log", WEB_LOG::route_log, &file_logger);
+ * @endcode
+ * 
+ * The query string may contain:
+ * 
+ *    level=n       Debug messages up to level n (level=error for errors only)
+ *    since=t       Lines from time t (seconds since epoch) or since=boot
+ *    until=t       Lines up to time t
+ *    q=text        Lines containing text
+ *    match=pat     Lines matching pattern ('*' and '?' wildcards)
+ *    client=n      Lines for client handle n
+ *    limit=n       Maximum number of lines (default LOG_QUERY_LIMIT)
+ *    cursor=c      Continue a previous query
+ * 
+ * The response is plain text sent with chunked transfer encoding. The
+ * log is read before the handler returns and each WEB_LOG_CHUNK bytes of
+ * lines is queued to be sent, so the whole page is held in the send
+ * queue until it is acknowledged. The line limit and the LogQuery scan
+ * budget bound its size. The last line is "# cursor=c more=m", giving
+ * the cursor for the next page and whether the query stopped before the
+ * end of the log (see LogQuery).
+ */
+class WEB_LOG
+{
+public:
+    /**
+     * @brief   HTTPRouter handler for log queries
+     * 
+     * @details The user data points to the FileLogger to be read
+     */
+    static bool route_log(WEB *web, ClientHandle client, HTTPRequest &rqst, const HTTPRouter::Params &params, bool &close, void *udata);
+};
+
+#endif
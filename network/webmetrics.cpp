@@ -0,0 +1,129 @@
+//                  *****  WebMetrics Implementation  *****
+
+#include "webmetrics.h"
+
+#include <stdio.h>
+#include <malloc.h>
+
+WebMetrics::WebMetrics()
+    : accepted_(0), closed_(0), errors_(0), requests_(), bytes_in_(0), bytes_out_(0),
+      requeues_(0), write_errors_(0), heap_used_(0), heap_peak_(0),
+      send_depth_(0), tls_handshake_(10), first_byte_(7)
+{
+}
+
+void WebMetrics::sample_heap()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo mi = mallinfo();
+#endif
+    heap_used_ = mi.uordblks;
+    if (heap_used_ > heap_peak_)
+    {
+        heap_peak_ = heap_used_;
+    }
+}
+
+void WebMetrics::counter(std::string &out, const char *name, const char *help, uint64_t value, const char *type)
+{
+    char buf[160];
+    snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n%s %llu\n",
+             name, help, name, type, name, (unsigned long long)value);
+    out += buf;
+}
+
+void WebMetrics::histogram(std::string &out, const char *name, const char *help, const Histogram &hist, double scale)
+{
+    char buf[160];
+    snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    out += buf;
+    uint64_t cumulative = 0;
+    for (int ii = 0; ii < Histogram::BUCKETS - 1; ii++)
+    {
+        cumulative += hist.count(ii);
+        snprintf(buf, sizeof(buf), "%s_bucket{le=\"%g\"} %llu\n", name, hist.bound(ii) * scale, (unsigned long long)cumulative);
+        out += buf;
+    }
+    snprintf(buf, sizeof(buf), "%s_bucket{le=\"+Inf\"} %u\n%s_sum %g\n%s_count %u\n",
+             name, hist.count(), name, hist.sum() * scale, name, hist.count());
+    out += buf;
+}
+
+void WebMetrics::histogram_json(std::string &out, const char *name, const Histogram &hist)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "\"%s\":{\"count\":%u,\"sum\":%llu,\"max\":%u,\"buckets\":[",
+             name, hist.count(), (unsigned long long)hist.sum(), hist.max());
+    out += buf;
+    for (int ii = 0; ii < Histogram::BUCKETS; ii++)
+    {
+        snprintf(buf, sizeof(buf), "%s%u", ii > 0 ? "," : "", hist.count(ii));
+        out += buf;
+    }
+    snprintf(buf, sizeof(buf), "],\"first_bound\":%llu}", (unsigned long long)hist.bound(0));
+    out += buf;
+}
+
+void WebMetrics::prometheus(std::string &out, const ClientDepths &clients)
+{
+    static const char *types[RQST_TYPES] = {"GET", "POST", "other", "upgrade", "ws_message"};
+    char buf[128];
+    sample_heap();
+    out.reserve(out.size() + 4096);
+    counter(out, "web_connections_accepted_total", "Connections accepted", accepted_);
+    counter(out, "web_connections_closed_total", "Connections closed", closed_);
+    counter(out, "web_connections_errors_total", "Connections aborted by error", errors_);
+    counter(out, "web_connections_open", "Connections currently open", clients.size(), "gauge");
+    out += "# HELP web_requests_total Requests received by type\n# TYPE web_requests_total counter\n";
+    for (int ii = 0; ii < RQST_TYPES; ii++)
+    {
+        snprintf(buf, sizeof(buf), "web_requests_total{type=\"%s\"} %u\n", types[ii], requests_[ii]);
+        out += buf;
+    }
+    counter(out, "web_received_bytes_total", "Bytes received", bytes_in_);
+    counter(out, "web_sent_bytes_total", "Bytes written", bytes_out_);
+    counter(out, "web_send_requeues_total", "Send buffers requeued after a write failure", requeues_);
+    counter(out, "web_write_errors_total", "Failed writes", write_errors_);
+    counter(out, "web_heap_used_bytes", "Heap in use", heap_used_, "gauge");
+    counter(out, "web_heap_peak_bytes", "Largest heap in use sampled", heap_peak_, "gauge");
+    out += "# HELP web_send_queue_depth Send buffers queued for a client\n# TYPE web_send_queue_depth gauge\n";
+    for (auto it = clients.cbegin(); it != clients.cend(); ++it)
+    {
+        snprintf(buf, sizeof(buf), "web_send_queue_depth{client=\"%u\"} %u\n", it->first, it->second);
+        out += buf;
+    }
+    histogram(out, "web_send_queued_depth", "Send queue depth when a buffer is queued", send_depth_, 1.0);
+    histogram(out, "web_tls_handshake_seconds", "Time from TLS accept to first data", tls_handshake_, 1e-6);
+    histogram(out, "web_first_byte_seconds", "Time from request received to first response byte", first_byte_, 1e-6);
+}
+
+void WebMetrics::json(std::string &out, const ClientDepths &clients)
+{
+    char buf[256];
+    sample_heap();
+    out.reserve(out.size() + 2048);
+    snprintf(buf, sizeof(buf), "{\"connections\":{\"accepted\":%u,\"closed\":%u,\"errors\":%u,\"open\":%u},"
+                               "\"requests\":{\"GET\":%u,\"POST\":%u,\"other\":%u,\"upgrade\":%u,\"ws_message\":%u},",
+             accepted_, closed_, errors_, (unsigned)clients.size(),
+             requests_[RQST_GET], requests_[RQST_POST], requests_[RQST_OTHER], requests_[RQST_UPGRADE], requests_[RQST_WS_MESSAGE]);
+    out += buf;
+    snprintf(buf, sizeof(buf), "\"bytes_in\":%llu,\"bytes_out\":%llu,\"requeues\":%u,\"write_errors\":%u,"
+                               "\"heap\":{\"used\":%u,\"peak\":%u},\"send_queue\":{",
+             (unsigned long long)bytes_in_, (unsigned long long)bytes_out_, requeues_, write_errors_,
+             (unsigned)heap_used_, (unsigned)heap_peak_);
+    out += buf;
+    for (auto it = clients.cbegin(); it != clients.cend(); ++it)
+    {
+        snprintf(buf, sizeof(buf), "%s\"%u\":%u", it != clients.cbegin() ? "," : "", it->first, it->second);
+        out += buf;
+    }
+    out += "},";
+    histogram_json(out, "send_queue_depth", send_depth_);
+    out += ",";
+    histogram_json(out, "tls_handshake_us", tls_handshake_);
+    out += ",";
+    histogram_json(out, "first_byte_us", first_byte_);
+    out += "}";
+}
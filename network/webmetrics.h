@@ -0,0 +1,140 @@
+//                  *****  WebMetrics Class  *****
+
+#ifndef WEBMETRICS_H
+#define WEBMETRICS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @class   WebMetrics
+ * 
+ * This class collects runtime counters and histograms for the WEB server.
+ * All storage is fixed size so recording a value is a few integer
+ * operations with no allocation. Histograms use power of two buckets.
+ * 
+ * The collected values can be formatted in the Prometheus text exposition
+ * format or as JSON.
+ */
+class WebMetrics
+{
+public:
+    /**
+     * @brief   Types of request counted
+     */
+    enum Request
+    {
+        RQST_GET,                   // HTTP GET
+        RQST_POST,                  // HTTP POST
+        RQST_OTHER,                 // Other HTTP method
+        RQST_UPGRADE,               // Websocket upgrade
+        RQST_WS_MESSAGE,            // Websocket message
+        RQST_TYPES                  // Number of types
+    };
+
+    /**
+     * @class   Histogram
+     * 
+     * Histogram with power of two bucket boundaries. Bucket i counts values
+     * less than 2^(shift + i). The last bucket counts all larger values.
+     */
+    class Histogram
+    {
+    public:
+        static const int BUCKETS = 16;      // Number of buckets
+
+    private:
+        uint32_t    counts_[BUCKETS];       // Values in each bucket
+        uint32_t    count_;                 // Number of values
+        uint64_t    sum_;                   // Sum of values
+        uint32_t    max_;                   // Largest value
+        uint8_t     shift_;                 // Log2 of first bucket bound
+
+    public:
+        Histogram(uint8_t shift) : counts_(), count_(0), sum_(0), max_(0), shift_(shift) {}
+
+        /**
+         * @brief   Add a value to the histogram
+         */
+        void record(uint32_t value)
+        {
+            int bits = value > 0 ? 32 - __builtin_clz(value) : 0;
+            int ii = bits > shift_ ? bits - shift_ : 0;
+            counts_[ii < BUCKETS ? ii : BUCKETS - 1] += 1;
+            count_ += 1;
+            sum_ += value;
+            if (value > max_) max_ = value;
+        }
+
+        uint32_t count(int bucket) const { return counts_[bucket]; }
+        uint64_t bound(int bucket) const { return 1ULL << (shift_ + bucket); }
+        uint32_t count() const { return count_; }
+        uint64_t sum() const { return sum_; }
+        uint32_t max() const { return max_; }
+    };
+
+    /**
+     * @brief   Handle and send queue depth of a connected client
+     */
+    typedef std::vector<std::pair<uint32_t, uint32_t>> ClientDepths;
+
+private:
+    uint32_t    accepted_;                  // Connections accepted
+    uint32_t    closed_;                    // Connections closed
+    uint32_t    errors_;                    // Connections aborted by error
+    uint32_t    requests_[RQST_TYPES];      // Requests by type
+    uint64_t    bytes_in_;                  // Bytes received
+    uint64_t    bytes_out_;                 // Bytes written
+    uint32_t    requeues_;                  // Send buffers requeued after write failure
+    uint32_t    write_errors_;              // altcp_write failures
+    std::size_t heap_used_;                 // Heap in use at last sample
+    std::size_t heap_peak_;                 // Largest heap in use sampled
+    Histogram   send_depth_;                // Send queue depth when buffer queued
+    Histogram   tls_handshake_;             // TLS accept to first data (microseconds)
+    Histogram   first_byte_;                // Request to first response byte (microseconds)
+
+    static void counter(std::string &out, const char *name, const char *help, uint64_t value, const char *type = "counter");
+    static void histogram(std::string &out, const char *name, const char *help, const Histogram &hist, double scale);
+    static void histogram_json(std::string &out, const char *name, const Histogram &hist);
+
+public:
+    WebMetrics();
+
+    void accepted() { accepted_ += 1; }
+    void closed() { closed_ += 1; }
+    void error() { errors_ += 1; }
+    void request(Request type) { requests_[type] += 1; }
+    void bytes_in(uint32_t count) { bytes_in_ += count; }
+    void bytes_out(uint32_t count) { bytes_out_ += count; }
+    void requeued() { requeues_ += 1; }
+    void write_error() { write_errors_ += 1; }
+    void send_queued(uint32_t depth) { send_depth_.record(depth); }
+    void tls_handshake(uint32_t us) { tls_handshake_.record(us); }
+    void first_byte(uint32_t us) { first_byte_.record(us); }
+
+    /**
+     * @brief   Sample the heap in use and update the peak
+     */
+    void sample_heap();
+
+    /**
+     * @brief   Format metrics in Prometheus text format
+     * 
+     * @param   out     String to receive the metrics
+     * @param   clients Send queue depth of each connected client
+     */
+    void prometheus(std::string &out, const ClientDepths &clients);
+
+    /**
+     * @brief   Format metrics as a JSON object
+     * 
+     * @param   out     String to receive the metrics
+     * @param   clients Send queue depth of each connected client
+     */
+    void json(std::string &out, const ClientDepths &clients);
+};
+
+#endif
@@ -67,6 +67,8 @@ enum WebSocketOpCode {
 
 class WS {
     public:
+        static const uint32_t HEADROOM = 14;    // Largest frame header (with mask)
+
         /**
          * @brief   Build a websocket message packet
          * 
@@ -83,7 +85,9 @@ class WS {
          * @brief   Build a websocket message packet
          * 
          * @param   opcode  Websocket op-code
-         * @param   msg     TXT object containing message (released before return)
+         * @param   msg     TXT object containing message (released before return).
+         *                  The header is placed in the headroom if there is
+         *                  room (see TXT), otherwise the message is moved.
          * @param   mask    Message to be masked if true
          * 
          * @return  Size of message packet
@@ -9,7 +9,7 @@
 */
 
 #ifndef DBGFLAG_H
-#define DGBFLAG_H
+#define DBGFLAG_H
 
 #include <stdint.h>
 
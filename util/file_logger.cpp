@@ -1,27 +1,317 @@
 //                  *****  FileLogger class implementation  *****
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 // fopencookie
+#endif
 #include "file_logger.h"
+#include "lzblock.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <list>
+#include <sys/types.h>
+#include <algorithm>
+#include <hardware/timer.h>
 
-FileLogger::FileLogger(const char *filename, uint32_t max_lines, uint32_t trimmed_lines)
- : Logger(), max_lines_(max_lines), trimmed_lines_(trimmed_lines), last_timestamp_(0)
+static_assert(FILE_LOG_BUFFER < 65536, "FILE_LOG_BUFFER too large for compressed blocks");
+
+namespace
+{
+    const char  LZ_MAGIC[4] = {0, 'L', 'Z', '4'};   // Start of a compressed segment
+    const int   BLOCK_HEADER = 4;                   // Text and stored lengths of a block
+
+    void segment_name(char *name, const char *filename, int slot)
+    {
+        sprintf(name, "%s.%d", filename, slot);
+    }
+}
+
+/*
+ * Reads the text of a segment file. A compressed segment is LZ_MAGIC
+ * followed by blocks of a 4 byte header (text length and stored length,
+ * little endian) and the LZ4 compressed text. A block is stored without
+ * compression if it does not compress. Positions are in the text.
+ */
+class LogSegmentReader
+{
+private:
+    FILE        *file_;             // Segment file
+    bool        compressed_;        // Compressed segment
+    char        *text_;             // Decompressed block
+    uint8_t     *packed_;           // Compressed block
+    uint32_t    start_;             // Position of block in text_
+    uint32_t    len_;               // Length of block in text_
+    uint32_t    next_;              // Position of next block
+    long        next_offset_;       // File offset of next block
+    uint32_t    pos_;               // Read position
+
+    bool load(uint32_t pos);
+
+public:
+    LogSegmentReader() : file_(nullptr), compressed_(false), text_(nullptr), packed_(nullptr),
+        start_(0), len_(0), next_(0), next_offset_(0), pos_(0) {}
+    ~LogSegmentReader() { close(); delete [] text_; delete [] packed_; }
+
+    bool open(const char *name);
+    void close();
+    bool is_open() const { return file_ != nullptr; }
+    bool compressed() const { return compressed_; }
+    void seek(uint32_t pos);
+    size_t read(char *buf, size_t size);
+};
+
+bool LogSegmentReader::open(const char *name)
+{
+    close();
+    file_ = fopen(name, "r");
+    if (file_)
+    {
+        char magic[sizeof(LZ_MAGIC)];
+        compressed_ = fread(magic, 1, sizeof(magic), file_) == sizeof(magic)
+            && memcmp(magic, LZ_MAGIC, sizeof(magic)) == 0;
+        if (compressed_ && !text_)
+        {
+            text_ = new char[FILE_LOG_BUFFER];
+            packed_ = new uint8_t[LZBlock::bound(FILE_LOG_BUFFER)];
+        }
+        start_ = 0;
+        len_ = 0;
+        next_ = 0;
+        next_offset_ = sizeof(LZ_MAGIC);
+        seek(0);
+    }
+    return file_ != nullptr;
+}
+
+void LogSegmentReader::close()
+{
+    if (file_)
+    {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void LogSegmentReader::seek(uint32_t pos)
+{
+    pos_ = pos;
+    if (!compressed_)
+    {
+        fseek(file_, pos, SEEK_SET);
+    }
+}
+
+bool LogSegmentReader::load(uint32_t pos)
+{
+    if (pos < next_)
+    {
+        //  Before the current block. Start again.
+        next_ = 0;
+        next_offset_ = sizeof(LZ_MAGIC);
+    }
+    len_ = 0;
+    while (pos >= next_)
+    {
+        uint8_t hdr[BLOCK_HEADER];
+        if (fseek(file_, next_offset_, SEEK_SET) != 0 || fread(hdr, 1, sizeof(hdr), file_) != sizeof(hdr))
+        {
+            return false;
+        }
+        uint32_t len = hdr[0] | (hdr[1] << 8);
+        uint32_t stored = hdr[2] | (hdr[3] << 8);
+        if (len == 0 || len > FILE_LOG_BUFFER || stored > len)
+        {
+            return false;
+        }
+        if (pos < next_ + len)
+        {
+            if (stored == len ? fread(text_, 1, len, file_) != len
+                : fread(packed_, 1, stored, file_) != stored
+                    || LZBlock::decompress(packed_, stored, text_, FILE_LOG_BUFFER) != (int)len)
+            {
+                return false;
+            }
+            start_ = next_;
+            len_ = len;
+        }
+        next_ += len;
+        next_offset_ += BLOCK_HEADER + stored;
+    }
+    return true;
+}
+
+size_t LogSegmentReader::read(char *buf, size_t size)
+{
+    if (!compressed_)
+    {
+        size_t n = fread(buf, 1, size, file_);
+        pos_ += n;
+        return n;
+    }
+
+    size_t got = 0;
+    while (got < size)
+    {
+        if ((pos_ < start_ || pos_ >= start_ + len_) && !load(pos_))
+        {
+            break;
+        }
+        size_t n = std::min<size_t>(size - got, start_ + len_ - pos_);
+        memcpy(buf + got, text_ + (pos_ - start_), n);
+        got += n;
+        pos_ += n;
+    }
+    return got;
+}
+
+namespace
+{
+    /*
+     * Reader for the stream returned by FileLogger::open. It reads the
+     * segments, oldest first, as one file. The segment sizes are those
+     * when the stream was opened, but the newest segment is read to its end.
+     */
+    struct LogReader
+    {
+        const char  *filename;                      // Log file name
+        char        *name;                          // Segment file name
+        int         count;                          // Number of segments
+        int         slots[FILE_LOG_SEGMENTS];       // Segment files, oldest first
+        long        start[FILE_LOG_SEGMENTS + 1];   // Stream position of each segment
+        int         seg;                            // Current segment
+        LogSegmentReader segment;                   // Current segment reader
+        long        pos;                            // Stream position
+    };
+
+    ssize_t log_read(void *cookie, char *buf, size_t size)
+    {
+        LogReader *r = static_cast<LogReader *>(cookie);
+        size_t got = 0;
+        while (got < size)
+        {
+            bool last = r->seg == r->count - 1;
+            if (!r->segment.is_open())
+            {
+                segment_name(r->name, r->filename, r->slots[r->seg]);
+                if (!r->segment.open(r->name))
+                {
+                    break;
+                }
+                r->segment.seek(r->pos - r->start[r->seg]);
+            }
+            size_t want = size - got;
+            if (!last && want > (size_t)(r->start[r->seg + 1] - r->pos))
+            {
+                want = r->start[r->seg + 1] - r->pos;
+            }
+            size_t n = r->segment.read(buf + got, want);
+            got += n;
+            r->pos += n;
+            if (n < want && last)
+            {
+                break;
+            }
+            if (!last && (n < want || r->pos >= r->start[r->seg + 1]))
+            {
+                r->segment.close();
+                r->pos = r->start[++r->seg];
+            }
+        }
+        return got;
+    }
+
+    template<typename Offset> int log_seek(void *cookie, Offset *offset, int whence)
+    {
+        LogReader *r = static_cast<LogReader *>(cookie);
+        long pos = *offset;
+        if (whence == SEEK_CUR)
+        {
+            pos += r->pos;
+        }
+        else if (whence == SEEK_END)
+        {
+            pos += r->start[r->count];
+        }
+        if (pos < 0)
+        {
+            return -1;
+        }
+
+        int seg = 0;
+        while (seg < r->count - 1 && pos >= r->start[seg + 1])
+        {
+            ++seg;
+        }
+        if (seg == r->seg && r->segment.is_open())
+        {
+            r->segment.seek(pos - r->start[seg]);
+        }
+        else
+        {
+            r->segment.close();
+        }
+        r->seg = seg;
+        r->pos = pos;
+        *offset = pos;
+        return 0;
+    }
+
+    int log_close(void *cookie)
+    {
+        LogReader *r = static_cast<LogReader *>(cookie);
+        delete [] r->name;
+        delete r;
+        return 0;
+    }
+}
+
+FileLogger::FileLogger(const char *filename, uint32_t max_lines, uint32_t trimmed_lines, bool compress)
+ : Logger(), max_lines_(max_lines), compress_(compress), newest_(0), count_(1), index_(), line_count_(0),
+   last_timestamp_(0), file_(nullptr), buffered_(0), buffer_time_(0), lz_(nullptr), packed_(nullptr),
+   reader_(new LogSegmentReader), base_(0), line_start_(true)
 {
     filename_ = new char[strlen(filename) +  1];
     strcpy(filename_, filename);
+    name_ = new char[strlen(filename) + 12];
+    buffer_ = new char[FILE_LOG_BUFFER + 1];
     if (max_lines_ < 500)
     {
         max_lines_ = 500;
     }
-    if (trimmed_lines_ > max_lines_ - 200)
+    if (trimmed_lines > max_lines_ - 200)
     {
-        trimmed_lines_ = max_lines_ - 200;
+        trimmed_lines = max_lines_ - 200;
     }
-    count_lines();
+
+    //  A trim removes one segment, so the others must hold trimmed_lines
+    segments_ = (max_lines_ + (max_lines_ - trimmed_lines) - 1) / (max_lines_ - trimmed_lines);
+    if (segments_ < 2)
+    {
+        segments_ = 2;
+    }
+    while (segments_ < FILE_LOG_SEGMENTS && (segments_ - 1) * (max_lines_ / segments_) < trimmed_lines)
+    {
+        ++segments_;
+    }
+    if (segments_ > FILE_LOG_SEGMENTS)
+    {
+        segments_ = FILE_LOG_SEGMENTS;
+    }
+    segment_lines_ = max_lines_ / segments_;
+    load_segments();
+    boot_ = base_ + file_size();
+}
+
+FileLogger::~FileLogger()
+{
+    close_file();
+    delete reader_;
+    delete lz_;
+    delete [] packed_;
+    delete [] buffer_;
+    delete [] name_;
+    delete [] filename_;
 }
 
 int FileLogger::print(const char *format, ...)
@@ -29,14 +319,9 @@ int FileLogger::print(const char *format, ...)
     va_list ap;
     va_start(ap, format);
 
-    int ret = vprint(format, ap);
+    int ret = isDeferred() ? record(0, format, ap) : vprint(0, format, ap);
 
     va_end(ap);
-
-    if (line_count_ > max_lines_)
-    {
-        trim_file();
-    }
     return ret;
 }
 
@@ -49,14 +334,9 @@ int FileLogger::print_debug(int level, const char *format, ...)
         va_list ap;
         va_start(ap, format);
 
-        ret = vprint(format, ap);
+        ret = isDeferred() ? record(level, format, ap) : vprint(level, format, ap);
 
         va_end(ap);
-
-        if (line_count_ > max_lines_)
-        {
-            trim_file();
-        }
     }
     return ret;
 }
@@ -66,7 +346,7 @@ int FileLogger::print_error(const char *format, ...)
     va_list ap;
     va_start(ap, format);
 
-    int ret = vprint(format, ap);
+    int ret = print_error(format, ap);
 
     va_end(ap);
     return ret;
@@ -74,169 +354,597 @@ int FileLogger::print_error(const char *format, ...)
 
 int FileLogger::print_error(const char *format, va_list ap)
 {
-    int ret = vprint(format, ap);
+    int ret = vprint(LEVEL_ERROR, format, ap);
+    write_buffer(true);
+    return ret;
+}
+
+int FileLogger::output(int level, const char *text)
+{
+    int ret = strlen(text);
+    tag(level);
+    append(text, ret);
     return ret;
 }
 
-int FileLogger::vprint(const char *format, va_list ap)
+int FileLogger::vprint(int level, const char *format, va_list ap)
 {
     time_t now;
     time(&now);
     if (last_timestamp_ != 0 && now - last_timestamp_ > 15 * 60)
     {
-        printf("%s\n", timestamp(&now));
+        const char *ts = timestamp(&now);
+        append(ts, strlen(ts));
+        append("\n", 1);
+        last_timestamp_ = now;
     }
-    int ret = vprintf(format, ap);
+    tag(level);
 
-    FILE *f = fopen(filename_, "a+");
-    if (f)
+    //  Format directly into the buffer. If it did not fit, make room and
+    //  format again, or append separately if larger than the buffer.
+    va_list aq;
+    va_copy(aq, ap);
+    int ret = vsnprintf(buffer_ + buffered_, FILE_LOG_BUFFER + 1 - buffered_, format, ap);
+    if (ret >= 0 && buffered_ + ret <= FILE_LOG_BUFFER)
+    {
+        commit(ret);
+    }
+    else if (ret > FILE_LOG_BUFFER)
+    {
+        char *text = new char[ret + 1];
+        vsnprintf(text, ret + 1, format, aq);
+        append(text, ret);
+        delete [] text;
+    }
+    else if (ret > 0)
+    {
+        make_room(ret);
+        vsnprintf(buffer_ + buffered_, FILE_LOG_BUFFER + 1 - buffered_, format, aq);
+        commit(ret);
+    }
+    va_end(aq);
+    return ret;
+}
+
+void FileLogger::append(const char *text, int len)
+{
+    make_room(len);
+    if (len > FILE_LOG_BUFFER)
     {
-        if (last_timestamp_ != 0 && now - last_timestamp_ > 15 * 60)
+        echo(text, len, index_[newest_].bytes);
+        write_block(text, len);
+        if (file_)
         {
-            fprintf(f, "%s\n", timestamp(&now));
-            ++line_count_;
-            last_timestamp_ = now;
+            fflush(file_);
         }
-        ret = vfprintf(f, format, ap);
-        if (ret > 0)
+        if (index_[newest_].lines >= segment_lines_)
         {
-            fseek(f, -ret, SEEK_END);
-            for (int ii = 0 ;ii < ret; ii++)
-            {
-                if (fgetc(f) == '\n')
-                {
-                    ++line_count_;
-                }
-            }
+            rotate();
         }
-        fclose(f);
     }
+    else
+    {
+        memcpy(buffer_ + buffered_, text, len);
+        commit(len);
+    }
+}
 
+void FileLogger::tag(int level)
+{
+    if (line_start_ && level != 0)
+    {
+        //  The tag is only written to the file
+        char tag[8];
+        int len = level == LEVEL_ERROR ? snprintf(tag, sizeof(tag), "E ") : snprintf(tag, sizeof(tag), "D%d ", level);
+        make_room(len);
+        memcpy(buffer_ + buffered_, tag, len);
+        if (buffered_ == 0)
+        {
+            buffer_time_ = time_us_64();
+        }
+        buffered_ += len;
+    }
+}
+
+void FileLogger::make_room(int len)
+{
+    if (buffered_ + len > FILE_LOG_BUFFER)
+    {
+        write_buffer(false);
+        if (buffered_ + len > FILE_LOG_BUFFER)
+        {
+            write_buffer(true);
+        }
+    }
+}
+
+void FileLogger::echo(const char *text, int len, uint32_t offset)
+{
+    fwrite(text, 1, len, stdout);
+    if (len > 0)
+    {
+        line_start_ = text[len - 1] == '\n';
+    }
+    for (const char *nl = text; (nl = (const char *)memchr(nl, '\n', text + len - nl)) != nullptr; ++nl)
+    {
+        ++line_count_;
+        if (++index_[newest_].lines % FILE_LOG_INDEX_LINES == 0)
+        {
+            marks_[newest_].push_back(offset + (nl - text) + 1);
+        }
+    }
+}
+
+void FileLogger::commit(int len)
+{
+    echo(buffer_ + buffered_, len, index_[newest_].bytes + buffered_);
+    if (buffered_ == 0)
+    {
+        buffer_time_ = time_us_64();
+    }
+    buffered_ += len;
+
+    if (index_[newest_].lines >= segment_lines_)
+    {
+        rotate();
+    }
+    else if (buffered_ >= FILE_LOG_FLUSH_SIZE)
+    {
+        write_buffer(false);
+    }
+    else if (time_us_64() - buffer_time_ > FILE_LOG_FLUSH_MS * 1000ULL)
+    {
+        write_buffer(true);
+    }
+}
+
+bool FileLogger::open_file() const
+{
+    if (!file_)
+    {
+        file_ = fopen(segment(newest_), "a");
+        if (file_)
+        {
+            //  Data is already batched
+            setvbuf(file_, nullptr, _IONBF, 0);
+        }
+    }
+    return file_ != nullptr;
+}
+
+uint32_t FileLogger::write_block(const char *text, uint32_t len) const
+{
+    Segment &s = index_[newest_];
+    if (!open_file())
+    {
+        return 0;
+    }
+    if (!s.compressed)
+    {
+        uint32_t done = fwrite(text, 1, len, file_);
+        s.bytes += done;
+        s.stored += done;
+        return done;
+    }
+
+    if (!lz_)
+    {
+        lz_ = new LZBlock;
+        packed_ = new uint8_t[BLOCK_HEADER + LZBlock::bound(FILE_LOG_BUFFER)];
+    }
+    if (s.stored == 0)
+    {
+        if (fwrite(LZ_MAGIC, 1, sizeof(LZ_MAGIC), file_) != sizeof(LZ_MAGIC))
+        {
+            return 0;
+        }
+        s.stored = sizeof(LZ_MAGIC);
+    }
+
+    //  Compress each block, or store it if it does not compress
+    uint32_t done = 0;
+    while (done < len)
+    {
+        uint32_t n = std::min<uint32_t>(len - done, FILE_LOG_BUFFER);
+        uint32_t stored = lz_->compress(text + done, n, packed_ + BLOCK_HEADER, n - 1);
+        if (stored == 0)
+        {
+            memcpy(packed_ + BLOCK_HEADER, text + done, n);
+            stored = n;
+        }
+        packed_[0] = n & 0xff;
+        packed_[1] = n >> 8;
+        packed_[2] = stored & 0xff;
+        packed_[3] = stored >> 8;
+        if (fwrite(packed_, 1, BLOCK_HEADER + stored, file_) != BLOCK_HEADER + stored)
+        {
+            break;
+        }
+        done += n;
+        s.bytes += n;
+        s.stored += BLOCK_HEADER + stored;
+    }
+    return done;
+}
+
+bool FileLogger::write_buffer(bool all) const
+{
+    if (buffered_ == 0)
+    {
+        return true;
+    }
+
+    //  Unless writing everything, stop at the last page boundary.
+    //  Compressed segments are written a block at a time.
+    const Segment &s = index_[newest_];
+    uint32_t len = buffered_;
+    if (!all && !s.compressed)
+    {
+        uint32_t end = (s.stored + buffered_) & ~(FILE_LOG_PAGE - 1);
+        len = end > s.stored ? end - s.stored : 0;
+        if (len == 0)
+        {
+            return true;
+        }
+    }
+
+    uint32_t done = write_block(buffer_, len);
+    bool ret = done == len && file_ && fflush(file_) == 0;
+
+    buffered_ -= done;
+    if (buffered_ > 0)
+    {
+        memmove(buffer_, buffer_ + done, buffered_);
+    }
     return ret;
 }
 
+void FileLogger::close_file() const
+{
+    write_buffer(true);
+    if (file_)
+    {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool FileLogger::sync(bool force)
+{
+    if (force || time_us_64() - buffer_time_ > FILE_LOG_FLUSH_MS * 1000ULL)
+    {
+        return write_buffer(true);
+    }
+    return true;
+}
+
 void FileLogger::print_timestamp()
 {
     if (last_timestamp_ != 0)
     {
         time_t now;
         time(&now);
-        printf("%s\n", timestamp(&now));
-        FILE *f = fopen(filename_, "a+");
-        if (f)
-        {
-            fprintf(f, "%s\n", timestamp(&now));
-            ++line_count_;
-            last_timestamp_ = now;
-            fclose(f);
-        }
+        const char *ts = timestamp(&now);
+        append(ts, strlen(ts));
+        append("\n", 1);
+        last_timestamp_ = now;
     }
 }
 
-bool FileLogger::trim_file()
+const char *FileLogger::segment(int slot) const
 {
-    bool ret = true;
-    char linebuf[133];
-    long pos = find_tail(trimmed_lines_);
-    if (pos > 0)
+    segment_name(name_, filename_, slot);
+    return name_;
+}
+
+const char *FileLogger::index_file() const
+{
+    sprintf(name_, "%s.idx", filename_);
+    return name_;
+}
+
+void FileLogger::load_segments()
+{
+    //  The index file holds the newest segment
+    FILE *f = fopen(index_file(), "r");
+    if (f)
+    {
+        unsigned long base;
+        if (fscanf(f, "%d %lu", &newest_, &base) == 2)
+        {
+            base_ = base;
+        }
+        if (newest_ < 0 || newest_ >= segments_)
+        {
+            newest_ = 0;
+        }
+        fclose(f);
+    }
+    else
+    {
+        //  Log file from before segmentation becomes the first segment
+        struct stat sb;
+        if (stat(filename_, &sb) == 0)
+        {
+            rename(filename_, segment(0));
+        }
+        save_index();
+    }
+
+    //  The newest segment may not have been written since a rotation
+    struct stat sb;
+    count_ = 1;
+    while (count_ < segments_ && stat(segment((newest_ - count_ + segments_) % segments_), &sb) == 0)
+    {
+        ++count_;
+    }
+
+    //  Build the line index
+    char buf[256];
+    for (int seg = 0; seg < count_; seg++)
     {
-        uint32_t nl = 0;
-        FILE *f = fopen(filename_, "r");
-        if (f)
+        int sl = slot(seg);
+        Segment &s = index_[sl];
+        clear_segment(sl);
+        if (stat(segment(sl), &sb) == 0 && reader_->open(segment(sl)))
         {
-            FILE *tmp = fopen("tmp.tmp", "w");
-            if (tmp)
+            s.stored = sb.st_size;
+            s.compressed = reader_->compressed() || (s.stored == 0 && compress_);
+            size_t n;
+            while ((n = reader_->read(buf, sizeof(buf))) > 0)
             {
-                fseek(f, pos, SEEK_SET);
-                while (fgets(linebuf, sizeof(linebuf), f))
+                for (const char *nl = buf; (nl = (const char *)memchr(nl, '\n', buf + n - nl)) != nullptr; ++nl)
                 {
-                    ret &= fprintf(tmp, "%s", linebuf) >= 0;
-                    ++nl;
+                    if (++s.lines % FILE_LOG_INDEX_LINES == 0)
+                    {
+                        marks_[sl].push_back(s.bytes + (nl - buf) + 1);
+                    }
                 }
-                ret &= fclose(tmp) == 0;
-            }
-            fclose(f);
-
-            if (ret)
-            {
-                remove(filename_);
-                rename("tmp.tmp", filename_);
-                printf("Reduced log file from %d to %d lines\n", line_count_, nl);
-                line_count_ = nl;
+                s.bytes += n;
             }
+            reader_->close();
         }
+        line_count_ += s.lines;
     }
-    return ret;
 }
 
-long FileLogger::find_line(int line, long from) const
+void FileLogger::save_index() const
 {
-    long ret = 0;
-    uint32_t ln = 0;
-    char linebuf[133];
+    FILE *f = fopen(index_file(), "w");
+    if (f)
+    {
+        fprintf(f, "%d %lu\n", newest_, (unsigned long)base_);
+        fclose(f);
+    }
+}
 
-    FILE *f = fopen(filename_, "r");
+void FileLogger::rotate()
+{
+    close_file();
+    if (count_ == segments_)
+    {
+        trim_file();
+    }
+    newest_ = (newest_ + 1) % segments_;
+    ++count_;
+    clear_segment(newest_);
+    FILE *f = fopen(segment(newest_), "w");
     if (f)
     {
-        fseek(f, from, SEEK_SET);
-        while (ln++ < line && fgets(linebuf, sizeof(linebuf), f))
+        fclose(f);
+    }
+    save_index();
+}
+
+bool FileLogger::trim_file()
+{
+    if (count_ < 2)
+    {
+        return false;
+    }
+    int oldest = slot(0);
+    remove(segment(oldest));
+    line_count_ -= index_[oldest].lines;
+    base_ += index_[oldest].bytes;
+    clear_segment(oldest);
+    --count_;
+    save_index();
+    return true;
+}
+
+void FileLogger::clear_segment(int slot)
+{
+    index_[slot].lines = 0;
+    index_[slot].bytes = 0;
+    index_[slot].stored = 0;
+    index_[slot].compressed = compress_;
+    marks_[slot].clear();
+    marks_[slot].reserve(segment_lines_ / FILE_LOG_INDEX_LINES + 1);
+}
+
+long FileLogger::skip_lines(int slot, long offset, uint32_t &lines) const
+{
+    if (lines == 0)
+    {
+        return offset;
+    }
+    if (reader_->open(segment(slot)))
+    {
+        char buf[256];
+        size_t n;
+        reader_->seek(offset);
+        while (lines > 0 && (n = reader_->read(buf, sizeof(buf))) > 0)
         {
-            ret = ftell(f);
-            if (ret == -1)
+            const char *nl = buf;
+            while (lines > 0 && (nl = (const char *)memchr(nl, '\n', buf + n - nl)) != nullptr)
             {
-                ret = file_size();
-                break;
+                ++nl;
+                --lines;
             }
+            offset += lines == 0 ? nl - buf : n;
         }
-        fclose(f);
+        reader_->close();
     }
-    return ret;
+    return offset;
 }
 
-long FileLogger::find_tail(int lines) const
+long FileLogger::seek_line(int slot, uint32_t line) const
 {
-    std::list<long> lineptrs;
-    int resolution = 1;
-    char linebuf[133];
+    const Segment &s = index_[slot];
+    if (line > s.lines)
+    {
+        return s.bytes;
+    }
+    uint32_t mark = line / FILE_LOG_INDEX_LINES;
+    long offset = mark > 0 ? marks_[slot][mark - 1] : 0;
+    line -= mark * FILE_LOG_INDEX_LINES;
+    return skip_lines(slot, offset, line);
+}
 
-    FILE *f = fopen(filename_, "r");
-    if (f)
+uint32_t FileLogger::line_at(int slot, long offset) const
+{
+    //  Count the lines from the index entry before the position
+    const std::vector<uint32_t> &marks = marks_[slot];
+    uint32_t mark = std::upper_bound(marks.begin(), marks.end(), (uint32_t)offset) - marks.begin();
+    uint32_t line = mark * FILE_LOG_INDEX_LINES;
+    long pos = mark > 0 ? marks[mark - 1] : 0;
+    if (pos < offset)
     {
-        lineptrs.emplace_back(ftell(f));
-        while (fgets(linebuf, sizeof(linebuf), f))
+        if (reader_->open(segment(slot)))
         {
-            if (lineptrs.size() == lines + 1)
+            char buf[256];
+            size_t n;
+            reader_->seek(pos);
+            while (pos < offset && (n = reader_->read(buf, sizeof(buf))) > 0)
             {
-                lineptrs.pop_front();
+                if ((long)n > offset - pos)
+                {
+                    n = offset - pos;
+                }
+                for (const char *nl = buf; (nl = (const char *)memchr(nl, '\n', buf + n - nl)) != nullptr; ++nl)
+                {
+                    ++line;
+                }
+                pos += n;
             }
-            lineptrs.emplace_back(ftell(f));
+            reader_->close();
         }
-        fclose(f);
     }
-    return lineptrs.front();
+    return line;
 }
 
-uint32_t FileLogger::file_size() const
+long FileLogger::find_line(int line, long from) const
 {
-    struct stat sb = {0};
-    stat(filename_, &sb);
-    return sb.st_size;
+    if (line <= 0)
+    {
+        return from;
+    }
+    write_buffer(true);
+
+    //  Find the segment containing the starting position
+    long start = 0;
+    int seg = 0;
+    while (seg < count_ - 1 && from >= start + (long)index_[slot(seg)].bytes)
+    {
+        start += index_[slot(seg)].bytes;
+        ++seg;
+    }
+
+    //  Line number in the segment, then in the segment containing it
+    uint32_t target = line_at(slot(seg), from - start) + line;
+    while (target > index_[slot(seg)].lines && seg < count_ - 1)
+    {
+        target -= index_[slot(seg)].lines;
+        start += index_[slot(seg)].bytes;
+        ++seg;
+    }
+    return start + seek_line(slot(seg), target);
 }
 
-void FileLogger::count_lines()
+long FileLogger::find_tail(int lines) const
 {
-    line_count_ = 0;
-    char linebuf[133];
+    write_buffer(true);
+    long pos = file_size();
+    uint32_t remaining = lines > 0 ? lines : 0;
+    for (int seg = count_ - 1; seg >= 0; --seg)
+    {
+        const Segment &s = index_[slot(seg)];
+        pos -= s.bytes;
+        if (remaining <= s.lines || seg == 0)
+        {
+            return pos + seek_line(slot(seg), s.lines > remaining ? s.lines - remaining : 0);
+        }
+        remaining -= s.lines;
+    }
+    return 0;
+}
 
-    FILE *f = fopen(filename_, "r");
-    if (f)
+uint32_t FileLogger::line_number(long pos) const
+{
+    write_buffer(true);
+    uint32_t line = 0;
+    for (int seg = 0; seg < count_; seg++)
     {
-        while (fgets(linebuf, sizeof(linebuf), f))
+        const Segment &s = index_[slot(seg)];
+        if (pos < (long)s.bytes || seg == count_ - 1)
         {
-            ++line_count_;
+            return line + line_at(slot(seg), pos);
         }
-        fclose(f);
+        line += s.lines;
+        pos -= s.bytes;
+    }
+    return line;
+}
+
+uint32_t FileLogger::file_size() const
+{
+    write_buffer(true);
+    uint32_t size = 0;
+    for (int seg = 0; seg < count_; seg++)
+    {
+        size += index_[slot(seg)].bytes;
+    }
+    return size;
+}
+
+uint32_t FileLogger::stored_size() const
+{
+    write_buffer(true);
+    uint32_t size = 0;
+    for (int seg = 0; seg < count_; seg++)
+    {
+        size += index_[slot(seg)].stored;
+    }
+    return size;
+}
+
+FILE *FileLogger::open() const
+{
+    write_buffer(true);
+
+    LogReader *r = new LogReader;
+    r->filename = filename_;
+    r->name = new char[strlen(filename_) + 12];
+    r->count = count_;
+    r->start[0] = 0;
+    for (int seg = 0; seg < count_; seg++)
+    {
+        r->slots[seg] = slot(seg);
+        r->start[seg + 1] = r->start[seg] + index_[slot(seg)].bytes;
+    }
+    r->seg = 0;
+    r->pos = 0;
+
+    cookie_io_functions_t io = {};
+    io.read = log_read;
+    io.seek = log_seek;
+    io.close = log_close;
+    FILE *f = fopencookie(r, "r", io);
+    if (!f)
+    {
+        log_close(r);
     }
+    return f;
 }
 
 void FileLogger::initialize_timestamps()
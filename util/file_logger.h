@@ -8,34 +8,146 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <time.h>
+#include <vector>
 
+#ifndef FILE_LOG_BUFFER
+#define FILE_LOG_BUFFER     4096        // Write behind buffer size
+#endif
+#ifndef FILE_LOG_PAGE
+#define FILE_LOG_PAGE       256         // Flash page size (power of 2)
+#endif
+#ifndef FILE_LOG_FLUSH_SIZE
+#define FILE_LOG_FLUSH_SIZE 2048        // Buffered bytes that start a write
+#endif
+#ifndef FILE_LOG_FLUSH_MS
+#define FILE_LOG_FLUSH_MS   10000       // Longest time a message stays buffered
+#endif
+#ifndef FILE_LOG_SEGMENTS
+#define FILE_LOG_SEGMENTS   16          // Maximum number of segment files
+#endif
+#ifndef FILE_LOG_INDEX_LINES
+#define FILE_LOG_INDEX_LINES 32         // Lines between line index entries
+#endif
+
+class LZBlock;
+class LogSegmentReader;
+
+/**
+ * @class   FileLogger
+ * 
+ * This class writes log messages to stdout and to a file.
+ * 
+ * The log is stored as a ring of segment files named filename.0,
+ * filename.1, ... Each segment holds up to max_lines - trimmed_lines lines and
+ * when the ring is full the oldest segment is deleted, so trimming never
+ * copies the log. The file filename.idx records the newest segment. A
+ * log file from an earlier version is renamed to the first segment.
+ * 
+ * The line count and size of each segment and the position of every
+ * FILE_LOG_INDEX_LINES line are kept in RAM, so find_line and find_tail
+ * read at most FILE_LOG_INDEX_LINES lines to locate any line. The index
+ * is built when the log is opened and updated as messages are added.
+ * The stream returned by open reads the segments as one file.
+ * 
+ * Messages are collected in a RAM buffer and written to the segment,
+ * which is kept open, in batches. A batch is written when
+ * FILE_LOG_FLUSH_SIZE bytes are buffered, and ends on a FILE_LOG_PAGE
+ * boundary of the file so that each flash page is written once. All
+ * buffered messages are written by print_error, when the oldest buffered
+ * message is older than FILE_LOG_FLUSH_MS or by sync. Messages are
+ * written before the log is read.
+ * 
+ * If compression is enabled new segments are written as blocks in the
+ * LZ4 block format, one per batch, and are decompressed when read. The
+ * log text, positions and line numbers are the same as for an
+ * uncompressed log. Each segment still holds the same number of lines,
+ * so max_lines can be raised by the compression ratio (typically 3 to 5
+ * for log messages) for the same storage. Segments written before
+ * compression was enabled or disabled are read in their own format.
+ * 
+ * A line started by print_error is stored with the prefix "E " and a
+ * line started by print_debug with "D<level> ", so that the log can be
+ * filtered by level (see LogQuery). The prefix is not printed to stdout.
+ * 
+ * The application should call sync periodically (for example from its
+ * main loop) so that messages are written when there is little logging.
+ */
 class FileLogger : public Logger
 {
 private:
-    char        *filename_;             // Log file name
-    uint32_t    max_lines_;             // Maximum number of lines in file
-    uint32_t    trimmed_lines_;         // Number of lines after trimming
-    uint32_t    line_count_;            // Lines in file
-    time_t      last_timestamp_;        // Last timestamp printed
+    struct Segment
+    {
+        uint32_t    lines;              // Lines in segment (including buffer)
+        uint32_t    bytes;              // Bytes of text written to segment
+        uint32_t    stored;             // Bytes in segment file
+        bool        compressed;         // Segment is compressed
+    };
+
+    char            *filename_;         // Log file name
+    mutable char    *name_;             // Segment file name
+    uint32_t        max_lines_;         // Maximum number of lines in log
+    bool            compress_;          // Compress new segments
+    uint32_t        segment_lines_;     // Lines in each segment
+    int             segments_;          // Number of segments in ring
+    int             newest_;            // Segment being written
+    int             count_;             // Segments in use
+    mutable Segment index_[FILE_LOG_SEGMENTS];  // Size of each segment
+    std::vector<uint32_t> marks_[FILE_LOG_SEGMENTS]; // Position of every FILE_LOG_INDEX_LINES line
+    uint32_t        line_count_;        // Lines in log and buffer
+    time_t          last_timestamp_;    // Last timestamp printed
+    mutable FILE    *file_;             // Newest segment open for append
+    mutable char    *buffer_;           // Write behind buffer
+    mutable uint32_t buffered_;         // Bytes in buffer
+    mutable uint64_t buffer_time_;      // Time (us) oldest buffered message was added
+    mutable LZBlock *lz_;               // Compressor (if writing a compressed segment)
+    mutable uint8_t *packed_;           // Compressed block
+    LogSegmentReader *reader_;          // Segment reader for index and searches
+    uint32_t        base_;              // Text removed from the start of the log
+    uint32_t        boot_;              // Absolute position of the first message logged
+    bool            line_start_;        // Next message starts a line
 
-    void count_lines();
+    const char *segment(int slot) const;
+    const char *index_file() const;
+    void load_segments();
+    void save_index() const;
+    void rotate();
+    int slot(int seg) const { return (newest_ - count_ + 1 + seg + segments_) % segments_; }
     const char *timestamp(const time_t *ts) const;
-    int vprint(const char *format, va_list ap);
+    int vprint(int level, const char *format, va_list ap);
+    void tag(int level);
+    void append(const char *text, int len);
+    void make_room(int len);
+    void echo(const char *text, int len, uint32_t offset);
+    void clear_segment(int slot);
+    void commit(int len);
+    bool open_file() const;
+    uint32_t write_block(const char *text, uint32_t len) const;
+    bool write_buffer(bool all) const;
+    void close_file() const;
+    long skip_lines(int slot, long offset, uint32_t &lines) const;
+    long seek_line(int slot, uint32_t line) const;
+    uint32_t line_at(int slot, long offset) const;
+
+protected:
+    int output(int level, const char *text) override;
 
 public:
+    static const int LEVEL_ERROR = -1;  // Level of print_error messages
+
     /**
      * @brief   Constructor
      * 
      * @param   filename        Name of log file
-     * @param   max_lines       Line count where trimming will be done
-     * @param   trimmed_lines   Lines to remain after trimming
+     * @param   max_lines       Largest line count kept
+     * @param   trimmed_lines   Smallest line count kept once the log is full
+     * @param   compress        Compress new segments
      */
-    FileLogger(const char *filename, uint32_t max_lines=2000, uint32_t trimmed_lines=1500);
+    FileLogger(const char *filename, uint32_t max_lines=2000, uint32_t trimmed_lines=1500, bool compress=false);
 
     /**
      * @brief   Destructor
      */
-    virtual ~FileLogger() {}
+    virtual ~FileLogger();
 
     /**
      * @brief   Print method with same function as printf
@@ -54,7 +166,19 @@ public:
     int print_error(const char *format, va_list ap);
 
     /**
-     * @brief   Trim file to trimmed_lines line count
+     * @brief   Write buffered messages to the file
+     * 
+     * @param   force   Write even if the oldest message is not yet
+     *                  FILE_LOG_FLUSH_MS old
+     * 
+     * @return  true if no error
+     */
+    bool sync(bool force = false);
+
+    /**
+     * @brief   Delete the oldest segment
+     * 
+     * @return  true if a segment was deleted
      */
     bool trim_file();
 
@@ -71,15 +195,35 @@ public:
     /**
      * @brief   Find the file position a number of lines from the end
      * 
-     * @details Actual line count may not be exactly as specified for
-     *          large files
-     * 
      * @param   lines       Number of lines before end
      * 
      * @return  File position for fseek to locate specified line
      */
     long find_tail(int lines) const;
 
+    /**
+     * @brief   Find the line number of a file position
+     * 
+     * @param   pos         File position
+     * 
+     * @return  Number of complete lines before the position
+     */
+    uint32_t line_number(long pos) const;
+
+    /**
+     * @brief   Getter for the absolute position of the start of the log
+     * 
+     * @details A file position plus this value is an absolute position
+     *          which does not change when the oldest segment is deleted
+     */
+    uint32_t base_position() const { return base_; }
+
+    /**
+     * @brief   Getter for the absolute position of the first message
+     *          logged since this object was created (normally since boot)
+     */
+    uint32_t boot_position() const { return boot_; }
+
     /**
      * @brief   Getter for current line count
      */
@@ -92,15 +236,22 @@ public:
 
     /**
      * @brief   Getter for file size
+     * 
+     * @details This is the size of the log text, as read with open
      */
     uint32_t file_size() const;
 
     /**
-     * @brief   Open log file for reading
+     * @brief   Getter for the bytes of storage used by the log
+     */
+    uint32_t stored_size() const;
+
+    /**
+     * @brief   Open log for reading
      * 
      * @return  File handle (null if failed)
      */
-    FILE *open() const { return fopen(filename_, "r"); }
+    FILE *open() const;
 
     /**
      * @brief   Position file to line
@@ -0,0 +1,17 @@
+//                  *****  JSONArena Implementation  *****
+
+#include "json_arena.h"
+
+void *JSONArena::alloc(uint32_t size, uint32_t align)
+{
+    uintptr_t addr = reinterpret_cast<uintptr_t>(base_) + used_;
+    uint32_t pad = (align - (addr & (align - 1))) & (align - 1);
+    if (pad + size > size_ - used_)
+    {
+        return nullptr;
+    }
+    used_ += pad;
+    void *ptr = base_ + used_;
+    used_ += size;
+    return ptr;
+}
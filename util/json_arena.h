@@ -0,0 +1,100 @@
+//                  *****  JSONArena Class  *****
+
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stdint.h>
+
+/**
+ * @class   JSONArena
+ * 
+ * A bump allocator for parsing JSON without using the heap. Space is
+ * taken from the end of a single buffer, which is either supplied by
+ * the caller (for example static) or allocated once by the arena, and
+ * is freed all at once by reset, or back to a mark by release.
+ * 
+ * A JSONMap using an arena takes its node array, and its copy of the
+ * text if one is needed, from the arena. When the map is cleared or
+ * reloaded the space is released again if nothing has been allocated
+ * from the arena since, so one arena serves a stream of messages:
+ * 
+ * @code
+ *    static char storage[2048];
+ *    static JSONArena arena(storage, sizeof(storage));
+ * 
+ *    void message(WEB *web, ClientHandle client, const std::string &msg, void *udata)
+ *    {
+ *        JSONMap cmd(arena);
+ *        cmd.loadString(msg.c_str());
+ *        ...
+ *    }
+ * @endcode
+ */
+class JSONArena
+{
+private:
+    char            *base_;                 // Start of buffer
+    uint32_t        size_;                  // Size of buffer
+    uint32_t        used_;                  // Bytes allocated
+    bool            owned_;                 // Buffer allocated by arena
+
+public:
+    /**
+     * @brief   Construct an arena in a caller supplied buffer
+     * 
+     * @param   buffer  Buffer, which must remain valid for the life of the arena
+     * @param   size    Size of buffer
+     */
+    JSONArena(void *buffer, uint32_t size)
+     : base_(static_cast<char *>(buffer)), size_(size), used_(0), owned_(false) {}
+
+    /**
+     * @brief   Construct an arena allocating its buffer
+     * 
+     * @param   size    Size of buffer
+     */
+    explicit JSONArena(uint32_t size)
+     : base_(new char[size]), size_(size), used_(0), owned_(true) {}
+
+    /**
+     * @brief   Destructor
+     */
+    ~JSONArena() { if (owned_) delete [] base_; }
+
+    JSONArena(const JSONArena &) = delete;
+    JSONArena &operator=(const JSONArena &) = delete;
+
+    /**
+     * @brief   Allocate space
+     * 
+     * @param   size    Number of bytes
+     * @param   align   Required alignment (a power of 2)
+     * 
+     * @return  Pointer to space, or nullptr if the arena is full
+     */
+    void *alloc(uint32_t size, uint32_t align = 1);
+
+    /**
+     * @brief   Number of bytes allocated, usable as a mark for release
+     */
+    uint32_t used() const { return used_; }
+
+    /**
+     * @brief   Size of the arena
+     */
+    uint32_t size() const { return size_; }
+
+    /**
+     * @brief   Free all space allocated after a mark
+     * 
+     * @param   mark    Value of used() before the allocations
+     */
+    void release(uint32_t mark) { if (mark < used_) used_ = mark; }
+
+    /**
+     * @brief   Free all space
+     */
+    void reset() { used_ = 0; }
+};
+
+#endif
@@ -0,0 +1,395 @@
+//                  *****  JSONConfig Implementation  *****
+
+#include "json_config.h"
+#include "json_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+JSONConfig::JSONConfig(const char *filename, uint32_t delay_ms)
+ : filename_(filename), journal_(filename_ + ".jnl"), temp_(filename_ + ".tmp"),
+   delay_ms_(delay_ms), journal_size_(0), dirty_(0), alarm_(-1), due_(false)
+{
+}
+
+JSONConfig::~JSONConfig()
+{
+    flush();
+}
+
+bool JSONConfig::load()
+{
+    entries_.clear();
+    dirty_ = 0;
+
+    //  A compaction file is complete if the settings file has gone,
+    //  otherwise it was interrupted before the swap
+    struct stat sb;
+    if (stat(temp_.c_str(), &sb) == 0)
+    {
+        if (stat(filename_.c_str(), &sb) == 0)
+        {
+            ::remove(temp_.c_str());
+        }
+        else
+        {
+            rename(temp_.c_str(), filename_.c_str());
+        }
+    }
+
+    JSONMap map;
+    bool ret = map.loadFile(filename_.c_str());
+    for (JSONMap::Node node : map.root())
+    {
+        load_node(node.name(), node);
+    }
+    map.clear();
+
+    journal_size_ = 0;
+    if (stat(journal_.c_str(), &sb) == 0 && sb.st_size > 0)
+    {
+        FILE *f = fopen(journal_.c_str(), "r");
+        if (f)
+        {
+            char *data = new char[sb.st_size + 1];
+            uint32_t len = fread(data, 1, sb.st_size, f);
+            fclose(f);
+            data[len] = '\0';
+            journal_size_ = len;
+            replay(data, len);
+            delete [] data;
+        }
+    }
+    return ret;
+}
+
+void JSONConfig::replay(char *data, uint32_t len)
+{
+    //  Each record is a line, parsed in place
+    JSONMap record;
+    char *end = data + len;
+    char *line = data;
+    char *nl;
+    while ((nl = (char *)memchr(line, '\n', end - line)) != nullptr)
+    {
+        *nl = '\0';
+        if (record.loadInPlace(line))
+        {
+            for (JSONMap::Node node : record.root())
+            {
+                load_node(node.name(), node);
+            }
+        }
+        line = nl + 1;
+    }
+    record.clear();
+    if (line < end)
+    {
+        //  A record was cut short, so later records would join it
+        printf("JSONConfig: incomplete record in %s\n", journal_.c_str());
+        compact();
+    }
+}
+
+void JSONConfig::load_node(const char *name, const JSONMap::Node &node)
+{
+    if (!name)
+    {
+        return;
+    }
+    switch (node.type())
+    {
+    case JSON_NULL:
+        entries_.erase(name);
+        break;
+
+    case JSON_TEXT:
+        entries_[name] = { STRING, node.strValue(""), false, false };
+        break;
+
+    case JSON_OBJ:
+    case JSON_ARRAY:
+    {
+        Entry &entry = entries_[name];
+        entry = { LITERAL, std::string(), false, false };
+        JSONWriter jw(entry.value);
+        node.write(jw);
+        break;
+    }
+
+    default:
+        entries_[name] = { LITERAL, node.strValue(""), false, false };
+        break;
+    }
+}
+
+const JSONConfig::Entry *JSONConfig::find(const char *name) const
+{
+    auto it = entries_.find(name);
+    return it == entries_.end() || it->second.removed ? nullptr : &it->second;
+}
+
+const char *JSONConfig::strValue(const char *name, const char *defVal) const
+{
+    const Entry *entry = find(name);
+    return entry ? entry->value.c_str() : defVal;
+}
+
+int JSONConfig::intValue(const char *name, int defVal) const
+{
+    const Entry *entry = find(name);
+    return entry ? strtol(entry->value.c_str(), nullptr, 10) : defVal;
+}
+
+double JSONConfig::realValue(const char *name, double defVal) const
+{
+    const Entry *entry = find(name);
+    return entry ? strtod(entry->value.c_str(), nullptr) : defVal;
+}
+
+bool JSONConfig::boolValue(const char *name, bool defVal) const
+{
+    const Entry *entry = find(name);
+    return entry ? entry->value[0] == 't' : defVal;
+}
+
+void JSONConfig::change(const char *name, Type type, const char *value)
+{
+    auto it = entries_.find(name);
+    bool exists = it != entries_.end() && !it->second.removed;
+    if (value)
+    {
+        if (exists && it->second.type == type && it->second.value == value)
+        {
+            return;
+        }
+        if (it == entries_.end())
+        {
+            it = entries_.emplace(name, Entry{ type, value, false, false }).first;
+        }
+        else
+        {
+            it->second.type = type;
+            it->second.value = value;
+            it->second.removed = false;
+        }
+    }
+    else
+    {
+        if (!exists)
+        {
+            return;
+        }
+        it->second.removed = true;
+    }
+    if (!it->second.dirty)
+    {
+        it->second.dirty = true;
+        ++dirty_;
+    }
+    if (alarm_ == -1 && !due_)
+    {
+        alarm_ = add_alarm_in_ms(delay_ms_, alarm_cb, this, true);
+        if (alarm_ <= 0)
+        {
+            //  No alarm available (or it has already fired), so write at
+            //  the next sync
+            alarm_ = -1;
+            due_ = true;
+        }
+    }
+}
+
+void JSONConfig::set(const char *name, const char *value)
+{
+    change(name, STRING, value);
+}
+
+void JSONConfig::set(const char *name, int value)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%d", value);
+    change(name, LITERAL, text);
+}
+
+void JSONConfig::set(const char *name, double value)
+{
+    char text[32];
+    JSONWriter jw(text, sizeof(text));
+    jw.value(value);
+    change(name, LITERAL, text);
+}
+
+void JSONConfig::set(const char *name, bool value)
+{
+    change(name, LITERAL, value ? "true" : "false");
+}
+
+void JSONConfig::remove(const char *name)
+{
+    change(name, LITERAL, nullptr);
+}
+
+int64_t JSONConfig::alarm_cb(alarm_id_t, void *udata)
+{
+    JSONConfig *self = static_cast<JSONConfig *>(udata);
+    self->alarm_ = -1;
+    self->due_ = true;
+    return 0;
+}
+
+bool JSONConfig::sync()
+{
+    return due_ ? flush() : true;
+}
+
+bool JSONConfig::flush()
+{
+    if (alarm_ != -1)
+    {
+        cancel_alarm(alarm_);
+        alarm_ = -1;
+    }
+    due_ = false;
+    if (dirty_ == 0)
+    {
+        return true;
+    }
+    bool ret = append_journal();
+    if (ret && journal_size_ > JSON_CONFIG_JOURNAL_MAX)
+    {
+        ret = compact();
+    }
+    return ret;
+}
+
+bool JSONConfig::append_journal()
+{
+    std::string record;
+    JSONWriter jw(record);
+    jw.beginObject();
+    for (const auto &it : entries_)
+    {
+        const Entry &entry = it.second;
+        if (entry.dirty)
+        {
+            jw.key(it.first);
+            if (entry.removed)
+            {
+                jw.null();
+            }
+            else if (entry.type == STRING)
+            {
+                jw.value(entry.value);
+            }
+            else
+            {
+                jw.raw(entry.value.data(), entry.value.size());
+            }
+        }
+    }
+    jw.endObject();
+    record += '\n';
+
+    //  The record is written in one piece so that a failure can only
+    //  leave it incomplete, which is detected on load
+    FILE *f = fopen(journal_.c_str(), "a");
+    if (!f)
+    {
+        printf("JSONConfig: unable to open %s\n", journal_.c_str());
+        return false;
+    }
+    bool ret = fwrite(record.data(), 1, record.size(), f) == record.size();
+    ret = (fclose(f) == 0) && ret;
+    if (ret)
+    {
+        journal_size_ += record.size();
+        for (auto it = entries_.begin(); it != entries_.end(); )
+        {
+            it->second.dirty = false;
+            if (it->second.removed)
+            {
+                it = entries_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        dirty_ = 0;
+    }
+    return ret;
+}
+
+void JSONConfig::write(JSONWriter &jw) const
+{
+    jw.beginObject();
+    for (const auto &it : entries_)
+    {
+        const Entry &entry = it.second;
+        if (!entry.removed)
+        {
+            jw.key(it.first);
+            if (entry.type == STRING)
+            {
+                jw.value(entry.value);
+            }
+            else
+            {
+                jw.raw(entry.value.data(), entry.value.size());
+            }
+        }
+    }
+    jw.endObject();
+}
+
+bool JSONConfig::compact()
+{
+    std::string text;
+    JSONWriter jw(text);
+    write(jw);
+
+    FILE *f = fopen(temp_.c_str(), "w");
+    if (!f)
+    {
+        printf("JSONConfig: unable to create %s\n", temp_.c_str());
+        return false;
+    }
+    bool ret = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ret = (fclose(f) == 0) && ret;
+    if (!ret)
+    {
+        ::remove(temp_.c_str());
+        return false;
+    }
+
+    //  The swap is atomic where rename replaces an existing file. If it
+    //  does not, the settings file is removed first and load completes
+    //  the swap if it is interrupted.
+    if (rename(temp_.c_str(), filename_.c_str()) != 0)
+    {
+        ::remove(filename_.c_str());
+        if (rename(temp_.c_str(), filename_.c_str()) != 0)
+        {
+            printf("JSONConfig: unable to replace %s\n", filename_.c_str());
+            return false;
+        }
+    }
+    ::remove(journal_.c_str());
+    journal_size_ = 0;
+    for (auto it = entries_.begin(); it != entries_.end(); )
+    {
+        it->second.dirty = false;
+        if (it->second.removed)
+        {
+            it = entries_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    dirty_ = 0;
+    return true;
+}
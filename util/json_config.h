@@ -0,0 +1,165 @@
+//                  *****  JSONConfig Class  *****
+
+#ifndef JSON_CONFIG_H
+#define JSON_CONFIG_H
+
+#include "jsonmap.h"
+#include <pico/time.h>
+#include <map>
+#include <string>
+
+#ifndef JSON_CONFIG_DELAY_MS
+#define JSON_CONFIG_DELAY_MS    2000        // Delay from a change to its write
+#endif
+#ifndef JSON_CONFIG_JOURNAL_MAX
+#define JSON_CONFIG_JOURNAL_MAX 4096        // Journal size that starts a compaction
+#endif
+
+class JSONWriter;
+
+/**
+ * @class   JSONConfig
+ * 
+ * Settings stored as a single level JSON object in a file, which is
+ * updated without rewriting the whole file for each change.
+ * 
+ * The file is the JSON read by JSONMap::loadFile, so an existing
+ * settings file may be used. Changes are appended to the journal
+ * filename.jnl as a line holding a JSON object of the changed settings
+ * (a removed setting has the value null). Changes made within
+ * JSON_CONFIG_DELAY_MS of the first are written as one record.
+ * 
+ * When the journal exceeds JSON_CONFIG_JOURNAL_MAX bytes the settings
+ * are compacted: they are written to filename.tmp, which is renamed to
+ * replace the file, and the journal is deleted. Replaying a journal
+ * record again gives the same settings, so the settings are complete at
+ * every step. A record that was not completely written is ignored.
+ * 
+ * The delay is timed by an alarm, but files are only written by sync,
+ * which the application should call from its main loop (not from
+ * interrupt or lwIP callbacks).
+ */
+class JSONConfig
+{
+private:
+    enum Type
+    {
+        STRING,                             // Text (unescaped)
+        LITERAL                             // Number, true, false or nested JSON
+    };
+
+    struct Entry
+    {
+        Type            type;               // Type of value
+        std::string     value;              // Value
+        bool            dirty;              // Changed since last write
+        bool            removed;            // Removed since last write
+    };
+
+    std::string             filename_;      // Settings file
+    std::string             journal_;       // Journal file
+    std::string             temp_;          // Compaction file
+    std::map<std::string, Entry> entries_;  // Current settings
+    uint32_t                delay_ms_;      // Coalescing delay
+    uint32_t                journal_size_;  // Bytes in journal
+    int                     dirty_;         // Number of entries to write
+    alarm_id_t              alarm_;         // Delay timer (-1 if not running)
+    volatile bool           due_;           // Delay has expired
+
+    static int64_t alarm_cb(alarm_id_t id, void *udata);
+    void change(const char *name, Type type, const char *value);
+    void load_node(const char *name, const JSONMap::Node &node);
+    void replay(char *data, uint32_t len);
+    bool append_journal();
+    const Entry *find(const char *name) const;
+
+public:
+    /**
+     * @brief   Constructor
+     * 
+     * @param   filename    Settings file
+     * @param   delay_ms    Time changes are collected before writing
+     */
+    JSONConfig(const char *filename, uint32_t delay_ms = JSON_CONFIG_DELAY_MS);
+
+    /**
+     * @brief   Destructor, writes any pending changes
+     */
+    ~JSONConfig();
+
+    JSONConfig(const JSONConfig &) = delete;
+    JSONConfig &operator=(const JSONConfig &) = delete;
+
+    /**
+     * @brief   Read the settings file and journal
+     * 
+     * @return  true if the settings file was read
+     */
+    bool load();
+
+    /**
+     * @brief   Test if a setting exists
+     */
+    bool hasProperty(const char *name) const { return find(name) != nullptr; }
+
+    /**
+     * @brief   Get the value of a setting
+     * 
+     * @param   name    Setting name
+     * @param   defVal  Default value if not set
+     * 
+     * @return  Value or default value
+     */
+    const char *strValue(const char *name, const char *defVal=nullptr) const;
+    int intValue(const char *name, int defVal=0) const;
+    double realValue(const char *name, double defVal=0.0) const;
+    bool boolValue(const char *name, bool defVal=false) const;
+
+    /**
+     * @brief   Change a setting
+     * 
+     * @details The change is written after the coalescing delay, by sync.
+     *          Setting the current value has no effect.
+     * 
+     * @param   name    Setting name
+     * @param   value   New value
+     */
+    void set(const char *name, const char *value);
+    void set(const char *name, int value);
+    void set(const char *name, double value);
+    void set(const char *name, bool value);
+
+    /**
+     * @brief   Remove a setting
+     */
+    void remove(const char *name);
+
+    /**
+     * @brief   Write changes if the coalescing delay has expired
+     * 
+     * @return  false if a write failed
+     */
+    bool sync();
+
+    /**
+     * @brief   Write changes now
+     * 
+     * @return  false if a write failed
+     */
+    bool flush();
+
+    /**
+     * @brief   Write all settings to the settings file and delete the journal
+     * 
+     * @return  false if a write failed
+     */
+    bool compact();
+
+    /**
+     * @brief   Write all settings as a JSON object, for example to send
+     *          to a web page
+     */
+    void write(JSONWriter &jw) const;
+};
+
+#endif
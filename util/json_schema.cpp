@@ -0,0 +1,134 @@
+//                  *****  JSONSchema Implementation  *****
+
+#include "json_schema.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+JSONSchema::JSONSchema(const Field *fields, int count)
+ : fields_(fields), count_(count), mask_(0), bmask_(0), linear_(false)
+{
+    //  Start with twice as many slots as names, then try larger tables
+    uint32_t slots = 1;
+    while (slots < 2 * (uint32_t)count)
+    {
+        slots <<= 1;
+    }
+    for (int tries = 0; tries < 4; ++tries, slots <<= 1)
+    {
+        if (build(slots))
+        {
+            return;
+        }
+    }
+    printf("JSONSchema: no perfect hash found for %d names\n", count);
+    linear_ = true;
+}
+
+JSONSchema::Hash JSONSchema::hash(const char *name, uint32_t len)
+{
+    //  64 bit FNV-1a, split into bucket, first slot and step
+    uint64_t hh = 14695981039346656037ull;
+    for (uint32_t ii = 0; ii < len; ++ii)
+    {
+        hh ^= (uint8_t)name[ii];
+        hh *= 1099511628211ull;
+    }
+    hh ^= hh >> 29;
+    return { (uint32_t)(hh >> 48), (uint32_t)hh, (uint32_t)(hh >> 24) | 1 };
+}
+
+bool JSONSchema::build(uint32_t slots)
+{
+    //  Hash and displace: buckets are placed largest first, each with the
+    //  first displacement that puts all its names in free slots
+    uint32_t buckets = 1;
+    while (buckets < (uint32_t)count_)
+    {
+        buckets <<= 1;
+    }
+    mask_ = slots - 1;
+    bmask_ = buckets - 1;
+    slots_.assign(slots, -1);
+    disp_.assign(buckets, 0);
+
+    std::vector<Hash> hashes(count_);
+    std::vector<std::vector<int16_t>> members(buckets);
+    for (int id = 0; id < count_; ++id)
+    {
+        hashes[id] = hash(fields_[id].name, strlen(fields_[id].name));
+        members[hashes[id].bucket & bmask_].push_back(id);
+    }
+    std::vector<uint32_t> order(buckets);
+    for (uint32_t bb = 0; bb < buckets; ++bb)
+    {
+        order[bb] = bb;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&members](uint32_t a, uint32_t b) { return members[a].size() > members[b].size(); });
+
+    std::vector<uint32_t> taken;
+    for (uint32_t bb : order)
+    {
+        const std::vector<int16_t> &ids = members[bb];
+        if (ids.empty())
+        {
+            break;
+        }
+        uint32_t dd = 0;
+        for ( ; dd <= 0xffff; ++dd)
+        {
+            taken.clear();
+            for (int16_t id : ids)
+            {
+                uint32_t slot = (hashes[id].base + dd * hashes[id].step) & mask_;
+                if (slots_[slot] >= 0 || std::find(taken.begin(), taken.end(), slot) != taken.end())
+                {
+                    break;
+                }
+                taken.push_back(slot);
+            }
+            if (taken.size() == ids.size())
+            {
+                break;
+            }
+        }
+        if (dd > 0xffff)
+        {
+            return false;
+        }
+        disp_[bb] = dd;
+        for (size_t ii = 0; ii < ids.size(); ++ii)
+        {
+            slots_[taken[ii]] = ids[ii];
+        }
+    }
+    return true;
+}
+
+int JSONSchema::find(const char *name, uint32_t len) const
+{
+    if (linear_)
+    {
+        for (int id = 0; id < count_; ++id)
+        {
+            if (strncmp(fields_[id].name, name, len) == 0 && fields_[id].name[len] == '\0')
+            {
+                return id;
+            }
+        }
+        return -1;
+    }
+    Hash hh = hash(name, len);
+    int id = slots_[(hh.base + disp_[hh.bucket & bmask_] * hh.step) & mask_];
+    if (id >= 0 && strncmp(fields_[id].name, name, len) == 0 && fields_[id].name[len] == '\0')
+    {
+        return id;
+    }
+    return -1;
+}
+
+int JSONSchema::find(const char *name) const
+{
+    return find(name, strlen(name));
+}
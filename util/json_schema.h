@@ -0,0 +1,131 @@
+//                  *****  JSONSchema Class  *****
+
+#ifndef JSON_SCHEMA_H
+#define JSON_SCHEMA_H
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @class   JSONSchema
+ * 
+ * A list of the properties expected in a JSON object, each with a type.
+ * The index of a property in the list is its id.
+ * 
+ * The names are placed in a perfect hash table when the schema
+ * is constructed, so finding the id of a name takes one pass over the
+ * name and one string compare. JSONMap::decode uses this to convert all
+ * the properties of a loaded object in one pass into a dense array of
+ * values indexed by id, which are then read without further lookup:
+ * 
+ * @code
+ *    enum { HOSTNAME, TZ, DST, REFRESH };
+ *    static const JSONSchema::Field fields[] = {
+ *        { "hostname", JSONSchema::STRING },
+ *        { "tz", JSONSchema::INTEGER },
+ *        { "dst", JSONSchema::BOOLEAN },
+ *        { "refresh", JSONSchema::REAL } };
+ *    static const JSONSchema schema(fields, 4);
+ * 
+ *    JSONSchema::Value values[4];
+ *    map.decode(schema, values);
+ *    int tz = values[TZ].intValue(0);
+ * @endcode
+ */
+class JSONSchema
+{
+public:
+    /**
+     * @brief   Type to which a property is converted
+     */
+    enum Type : uint8_t
+    {
+        STRING,                             // const char * (in the JSONMap data)
+        INTEGER,                            // int
+        REAL,                               // double
+        BOOLEAN                             // bool
+    };
+
+    /**
+     * @brief   Definition of a property
+     */
+    struct Field
+    {
+        const char  *name;                  // Property name
+        Type        type;                   // Type of value
+    };
+
+    /**
+     * @brief   Converted value of a property
+     */
+    struct Value
+    {
+        union
+        {
+            const char  *str;
+            int         integer;
+            double      real;
+            bool        boolean;
+        };
+        bool        present;                // Property found with a usable value
+
+        Value() : real(0.0), present(false) {}
+
+        const char *strValue(const char *defVal=nullptr) const { return present ? str : defVal; }
+        int intValue(int defVal=0) const { return present ? integer : defVal; }
+        double realValue(double defVal=0.0) const { return present ? real : defVal; }
+        bool boolValue(bool defVal=false) const { return present ? boolean : defVal; }
+    };
+
+private:
+    const Field             *fields_;       // Property definitions
+    int                     count_;         // Number of properties
+    uint32_t                mask_;          // Slots - 1
+    uint32_t                bmask_;         // Buckets - 1
+    std::vector<int16_t>    slots_;         // Property id in each slot, or -1
+    std::vector<uint16_t>   disp_;          // Displacement of each bucket
+    bool                    linear_;        // No perfect hash found, search the list
+
+    struct Hash
+    {
+        uint32_t    bucket;                 // Selects displacement
+        uint32_t    base;                   // First slot tried
+        uint32_t    step;                   // Odd step between slots
+    };
+
+    static Hash hash(const char *name, uint32_t len);
+    bool build(uint32_t slots);
+
+public:
+    /**
+     * @brief   Construct a schema
+     * 
+     * @param   fields  Property definitions, which must remain valid for
+     *                  the life of the schema (normally a static array)
+     * @param   count   Number of properties
+     */
+    JSONSchema(const Field *fields, int count);
+
+    /**
+     * @brief   Find the id of a property
+     * 
+     * @param   name    Property name
+     * @param   len     Length of name
+     * 
+     * @return  Property id or -1 if not in the schema
+     */
+    int find(const char *name, uint32_t len) const;
+    int find(const char *name) const;
+
+    /**
+     * @brief   Number of properties
+     */
+    int count() const { return count_; }
+
+    /**
+     * @brief   Definition of a property
+     */
+    const Field &field(int id) const { return fields_[id]; }
+};
+
+#endif
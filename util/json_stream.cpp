@@ -0,0 +1,583 @@
+//                  *****  JSONStream Implementation  *****
+
+#include "json_stream.h"
+#include <string.h>
+
+namespace
+{
+    inline bool is_space(char ch)
+    {
+        return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+    }
+
+    inline bool is_digit(char ch)
+    {
+        return ch >= '0' && ch <= '9';
+    }
+
+    inline bool is_number(char ch)
+    {
+        return is_digit(ch) || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+    }
+
+    /**
+     * Test a number against the JSON grammar:
+     * -? (0 | [1-9][0-9]*) (. [0-9]+)? ([eE] [+-]? [0-9]+)?
+     */
+    bool valid_number(const char *ptr)
+    {
+        if (*ptr == '-')
+        {
+            ++ptr;
+        }
+        if (*ptr == '0')
+        {
+            ++ptr;
+        }
+        else if (is_digit(*ptr))
+        {
+            while (is_digit(*ptr))
+            {
+                ++ptr;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        if (*ptr == '.')
+        {
+            if (!is_digit(*(++ptr)))
+            {
+                return false;
+            }
+            while (is_digit(*ptr))
+            {
+                ++ptr;
+            }
+        }
+        if (*ptr == 'e' || *ptr == 'E')
+        {
+            ++ptr;
+            if (*ptr == '+' || *ptr == '-')
+            {
+                ++ptr;
+            }
+            if (!is_digit(*ptr))
+            {
+                return false;
+            }
+            while (is_digit(*ptr))
+            {
+                ++ptr;
+            }
+        }
+        return *ptr == '\0';
+    }
+
+    int hex_digit(char ch)
+    {
+        if (is_digit(ch))
+        {
+            return ch - '0';
+        }
+        if (ch >= 'a' && ch <= 'f')
+        {
+            return ch - 'a' + 10;
+        }
+        if (ch >= 'A' && ch <= 'F')
+        {
+            return ch - 'A' + 10;
+        }
+        return -1;
+    }
+
+    const uint32_t REPLACEMENT = 0xfffd;    // Unicode replacement character
+}
+
+JSONStream::JSONStream(JSONHandler *handler) : handler_(handler)
+{
+    reset();
+}
+
+void JSONStream::reset()
+{
+    state_ = VALUE;
+    error_ = nullptr;
+    offset_ = 0;
+    depth_ = 0;
+    key_ = false;
+    literal_ = nullptr;
+    matched_ = 0;
+    unicode_ = 0;
+    high_ = 0;
+    toklen_ = 0;
+    memset(arrays_, 0, sizeof(arrays_));
+}
+
+bool JSONStream::fail(const char *error)
+{
+    state_ = FAILED;
+    error_ = error;
+    return false;
+}
+
+bool JSONStream::ended()
+{
+    state_ = depth_ == 0 ? DONE : NEXT;
+    return true;
+}
+
+bool JSONStream::open(bool array)
+{
+    if (depth_ + 1 >= JSON_STREAM_DEPTH)
+    {
+        return fail("too deeply nested");
+    }
+    ++depth_;
+    if (array)
+    {
+        arrays_[depth_ >> 5] |= 1u << (depth_ & 31);
+    }
+    else
+    {
+        arrays_[depth_ >> 5] &= ~(1u << (depth_ & 31));
+    }
+    state_ = array ? FIRST_VALUE : FIRST_KEY;
+    if (!(array ? handler_->beginArray() : handler_->beginObject()))
+    {
+        return fail("stopped by handler");
+    }
+    return true;
+}
+
+bool JSONStream::close(bool array)
+{
+    if (inArray() != array)
+    {
+        return fail(array ? "']' closes an object" : "'}' closes an array");
+    }
+    --depth_;
+    if (!(array ? handler_->endArray() : handler_->endObject()))
+    {
+        return fail("stopped by handler");
+    }
+    return ended();
+}
+
+bool JSONStream::value(char ch)
+{
+    switch (ch)
+    {
+    case '{':
+        return open(false);
+
+    case '[':
+        return open(true);
+
+    case '"':
+        key_ = false;
+        toklen_ = 0;
+        state_ = STRING;
+        return true;
+
+    case 't':
+        literal_ = "true";
+        break;
+
+    case 'f':
+        literal_ = "false";
+        break;
+
+    case 'n':
+        literal_ = "null";
+        break;
+
+    default:
+        if (ch == '-' || is_digit(ch))
+        {
+            token_[0] = ch;
+            toklen_ = 1;
+            state_ = NUMBER;
+            return true;
+        }
+        return fail("expected a value");
+    }
+    matched_ = 1;
+    state_ = LITERAL;
+    return true;
+}
+
+bool JSONStream::append(const char *data, uint32_t len)
+{
+    while (toklen_ + len > JSON_STREAM_TOKEN)
+    {
+        //  Pass on a full buffer of a long string value
+        if (key_)
+        {
+            return fail("key too long");
+        }
+        uint32_t nn = JSON_STREAM_TOKEN - toklen_;
+        memcpy(token_ + toklen_, data, nn);
+        token_[JSON_STREAM_TOKEN] = '\0';
+        toklen_ = 0;
+        data += nn;
+        len -= nn;
+        if (!handler_->stringPart(token_, JSON_STREAM_TOKEN))
+        {
+            return fail("string too long");
+        }
+    }
+    memcpy(token_ + toklen_, data, len);
+    toklen_ += len;
+    return true;
+}
+
+bool JSONStream::utf8(uint32_t code)
+{
+    char seq[4];
+    uint32_t len;
+    if (code < 0x80)
+    {
+        seq[0] = code;
+        len = 1;
+    }
+    else if (code < 0x800)
+    {
+        seq[0] = 0xc0 | (code >> 6);
+        seq[1] = 0x80 | (code & 0x3f);
+        len = 2;
+    }
+    else if (code < 0x10000)
+    {
+        seq[0] = 0xe0 | (code >> 12);
+        seq[1] = 0x80 | ((code >> 6) & 0x3f);
+        seq[2] = 0x80 | (code & 0x3f);
+        len = 3;
+    }
+    else
+    {
+        seq[0] = 0xf0 | (code >> 18);
+        seq[1] = 0x80 | ((code >> 12) & 0x3f);
+        seq[2] = 0x80 | ((code >> 6) & 0x3f);
+        seq[3] = 0x80 | (code & 0x3f);
+        len = 4;
+    }
+    return append(seq, len);
+}
+
+bool JSONStream::endString()
+{
+    if (high_ != 0)
+    {
+        high_ = 0;
+        if (!utf8(REPLACEMENT))
+        {
+            return false;
+        }
+    }
+    token_[toklen_] = '\0';
+    if (key_)
+    {
+        if (!handler_->key(token_, toklen_))
+        {
+            return fail("stopped by handler");
+        }
+        state_ = COLON;
+        return true;
+    }
+    if (!handler_->string(token_, toklen_))
+    {
+        return fail("stopped by handler");
+    }
+    return ended();
+}
+
+bool JSONStream::endNumber()
+{
+    token_[toklen_] = '\0';
+    if (!valid_number(token_))
+    {
+        return fail("invalid number");
+    }
+    if (!handler_->number(token_, toklen_))
+    {
+        return fail("stopped by handler");
+    }
+    return ended();
+}
+
+bool JSONStream::feed(const char *data, uint32_t len)
+{
+    const char *ptr = data;
+    const char *end = data + len;
+    while (ptr < end && state_ != FAILED)
+    {
+        char ch = *ptr;
+        switch (state_)
+        {
+        case VALUE:
+            if (!is_space(ch))
+            {
+                value(ch);
+            }
+            break;
+
+        case FIRST_VALUE:
+            if (ch == ']')
+            {
+                close(true);
+            }
+            else if (!is_space(ch))
+            {
+                value(ch);
+            }
+            break;
+
+        case FIRST_KEY:
+        case KEY:
+            if (ch == '"')
+            {
+                key_ = true;
+                toklen_ = 0;
+                state_ = STRING;
+            }
+            else if (ch == '}' && state_ == FIRST_KEY)
+            {
+                close(false);
+            }
+            else if (!is_space(ch))
+            {
+                fail("expected a key");
+            }
+            break;
+
+        case COLON:
+            if (ch == ':')
+            {
+                state_ = VALUE;
+            }
+            else if (!is_space(ch))
+            {
+                fail("expected ':'");
+            }
+            break;
+
+        case NEXT:
+            if (ch == ',')
+            {
+                state_ = inArray() ? VALUE : KEY;
+            }
+            else if (ch == ']' || ch == '}')
+            {
+                close(ch == ']');
+            }
+            else if (!is_space(ch))
+            {
+                fail("expected ',' or close");
+            }
+            break;
+
+        case STRING:
+        {
+            //  Copy the run of characters needing no attention
+            const char *run = ptr;
+            while (ptr < end && *ptr != '"' && *ptr != '\\' && (uint8_t)*ptr >= 0x20)
+            {
+                ++ptr;
+            }
+            if (ptr > run)
+            {
+                if (high_ != 0)
+                {
+                    high_ = 0;
+                    if (!utf8(REPLACEMENT))
+                    {
+                        break;
+                    }
+                }
+                if (!append(run, ptr - run))
+                {
+                    break;
+                }
+            }
+            if (ptr == end)
+            {
+                continue;
+            }
+            ch = *ptr;
+            if (ch == '"')
+            {
+                endString();
+            }
+            else if (ch == '\\')
+            {
+                state_ = ESCAPE;
+            }
+            else
+            {
+                fail("control character in string");
+            }
+            break;
+        }
+
+        case ESCAPE:
+        {
+            char esc;
+            switch (ch)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                esc = ch;
+                break;
+            case 'b':
+                esc = '\b';
+                break;
+            case 'f':
+                esc = '\f';
+                break;
+            case 'n':
+                esc = '\n';
+                break;
+            case 'r':
+                esc = '\r';
+                break;
+            case 't':
+                esc = '\t';
+                break;
+            case 'u':
+                unicode_ = 0;
+                matched_ = 0;
+                state_ = UNICODE;
+                esc = '\0';
+                break;
+            default:
+                fail("invalid escape");
+                esc = '\0';
+                break;
+            }
+            if (esc == '\0')
+            {
+                break;
+            }
+            state_ = STRING;
+            if (high_ != 0)
+            {
+                high_ = 0;
+                if (!utf8(REPLACEMENT))
+                {
+                    break;
+                }
+            }
+            append(&esc, 1);
+            break;
+        }
+
+        case UNICODE:
+        {
+            int digit = hex_digit(ch);
+            if (digit < 0)
+            {
+                fail("invalid \\u escape");
+                break;
+            }
+            unicode_ = (unicode_ << 4) | digit;
+            if (++matched_ < 4)
+            {
+                break;
+            }
+            state_ = STRING;
+            if (unicode_ >= 0xdc00 && unicode_ < 0xe000 && high_ != 0)
+            {
+                //  Second half of a surrogate pair
+                utf8(0x10000 + ((high_ - 0xd800) << 10) + (unicode_ - 0xdc00));
+                high_ = 0;
+                break;
+            }
+            if (high_ != 0)
+            {
+                high_ = 0;
+                if (!utf8(REPLACEMENT))
+                {
+                    break;
+                }
+            }
+            if (unicode_ >= 0xd800 && unicode_ < 0xdc00)
+            {
+                high_ = unicode_;
+            }
+            else
+            {
+                utf8(unicode_ >= 0xdc00 && unicode_ < 0xe000 ? REPLACEMENT : unicode_);
+            }
+            break;
+        }
+
+        case NUMBER:
+            if (!is_number(ch))
+            {
+                //  The character following the number is parsed in the next state
+                endNumber();
+                continue;
+            }
+            if (toklen_ >= JSON_STREAM_TOKEN)
+            {
+                fail("number too long");
+                break;
+            }
+            token_[toklen_++] = ch;
+            break;
+
+        case LITERAL:
+            if (ch != literal_[matched_])
+            {
+                fail("invalid literal");
+                break;
+            }
+            if (literal_[++matched_] == '\0')
+            {
+                if (literal_[0] == 'n' ? !handler_->null() : !handler_->boolean(literal_[0] == 't'))
+                {
+                    fail("stopped by handler");
+                    break;
+                }
+                ended();
+            }
+            break;
+
+        case DONE:
+            if (!is_space(ch))
+            {
+                fail("text after the value");
+            }
+            break;
+
+        case FAILED:
+            break;
+        }
+        if (state_ != FAILED)
+        {
+            ++ptr;
+        }
+    }
+    offset_ += ptr - data;
+    return state_ != FAILED;
+}
+
+bool JSONStream::finish()
+{
+    if (state_ == NUMBER && depth_ == 0)
+    {
+        endNumber();
+    }
+    if (state_ == DONE)
+    {
+        return true;
+    }
+    if (state_ != FAILED)
+    {
+        fail("incomplete text");
+    }
+    return false;
+}
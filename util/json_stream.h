@@ -0,0 +1,185 @@
+//                  *****  JSONStream Class  *****
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdint.h>
+
+#ifndef JSON_STREAM_DEPTH
+#define JSON_STREAM_DEPTH   32              // Maximum nesting of objects and arrays
+#endif
+
+#ifndef JSON_STREAM_TOKEN
+#define JSON_STREAM_TOKEN   256             // Longest key, number or string piece
+#endif
+
+/**
+ * @class   JSONHandler
+ * 
+ * Interface receiving the parts of a JSON document from a JSONStream as
+ * they are parsed. Text passed to the handler is null terminated and
+ * valid only during the call. Each function returns false to stop
+ * parsing.
+ */
+class JSONHandler
+{
+public:
+    virtual ~JSONHandler() {}
+
+    virtual bool beginObject() { return true; }
+    virtual bool endObject() { return true; }
+    virtual bool beginArray() { return true; }
+    virtual bool endArray() { return true; }
+
+    /**
+     * @brief   Property name, followed by the property value
+     * 
+     * @param   name    Name (unescaped)
+     * @param   len     Length of name
+     */
+    virtual bool key(const char * /*name*/, uint32_t /*len*/) { return true; }
+
+    /**
+     * @brief   String value
+     * 
+     * @param   str     Text (unescaped)
+     * @param   len     Length of text
+     */
+    virtual bool string(const char * /*str*/, uint32_t /*len*/) { return true; }
+
+    /**
+     * @brief   Leading piece of a string value longer than JSON_STREAM_TOKEN
+     * 
+     * @details The pieces are followed by a call of string with the rest
+     *          of the text. By default a long string stops parsing.
+     */
+    virtual bool stringPart(const char * /*str*/, uint32_t /*len*/) { return false; }
+
+    /**
+     * @brief   Number value
+     * 
+     * @param   text    Number as in the JSON text, for strtol or strtod
+     * @param   len     Length of text
+     */
+    virtual bool number(const char * /*text*/, uint32_t /*len*/) { return true; }
+
+    virtual bool boolean(bool /*value*/) { return true; }
+    virtual bool null() { return true; }
+};
+
+/**
+ * @class   JSONStream
+ * 
+ * An event driven JSON parser, which is given the text in pieces of any
+ * size as it is received and calls a JSONHandler for each part of the
+ * document. Unlike JSONMap the document is never held in memory: only the
+ * current key, number or string is buffered (up to JSON_STREAM_TOKEN
+ * bytes) along with one bit for each level of nesting, so a large body
+ * such as a batch of IR codes is processed in constant memory.
+ * 
+ * A body callback parsing a POST request as it arrives:
+ * @code
+ *    class CodeLoader : public HTTPBodySink, public JSONHandler
+ *    {
+ *        JSONStream  json_;
+ *    public:
+ *        CodeLoader() : json_(this) {}
+ *        bool body_data(const char *data, std::size_t len) { return json_.feed(data, len); }
+ *        bool body_end() { return json_.finish(); }
+ *        bool key(const char *name, uint32_t len) { ... }
+ *        bool number(const char *text, uint32_t len) { ... }
+ *    };
+ * @endcode
+ */
+class JSONStream
+{
+private:
+    enum State
+    {
+        VALUE,                              // Expecting a value
+        FIRST_VALUE,                        // After '[', value or ']'
+        FIRST_KEY,                          // After '{', key or '}'
+        KEY,                                // After ',' in an object
+        COLON,                              // After a key
+        NEXT,                               // After a value, ',' or end
+        STRING,                             // In a key or string
+        ESCAPE,                             // After a backslash
+        UNICODE,                            // In the hex digits of \u
+        NUMBER,                             // In a number
+        LITERAL,                            // In true, false or null
+        DONE,                               // After the top level value
+        FAILED                              // Error or stopped by handler
+    };
+
+    JSONHandler     *handler_;              // Receives the parts
+    State           state_;                 // Parser state
+    const char      *error_;                // Error description
+    uint32_t        offset_;                // Bytes parsed
+    int             depth_;                 // Nesting level
+    bool            key_;                   // String is a key
+    const char      *literal_;              // Literal being matched
+    int             matched_;               // Characters of literal or hex digits matched
+    uint32_t        unicode_;               // Code unit of \u escape
+    uint32_t        high_;                  // Pending high surrogate, or zero
+    uint32_t        toklen_;                // Characters in token
+    uint32_t        arrays_[(JSON_STREAM_DEPTH + 31) / 32];    // Bit set at each array level
+    char            token_[JSON_STREAM_TOKEN + 1];             // Current key, number or string
+
+    bool fail(const char *error);
+    bool value(char ch);
+    bool open(bool array);
+    bool close(bool array);
+    bool ended();
+    bool append(const char *data, uint32_t len);
+    bool utf8(uint32_t code);
+    bool endString();
+    bool endNumber();
+    bool inArray() const { return (arrays_[depth_ >> 5] >> (depth_ & 31)) & 1; }
+
+public:
+    /**
+     * @brief   Constructor
+     * 
+     * @param   handler     Handler to receive the document
+     */
+    JSONStream(JSONHandler *handler);
+
+    /**
+     * @brief   Prepare to parse another document
+     */
+    void reset();
+
+    /**
+     * @brief   Parse the next piece of the text
+     * 
+     * @param   data    Text
+     * @param   len     Length of text
+     * 
+     * @return  false if the text is not valid JSON or the handler stopped
+     */
+    bool feed(const char *data, uint32_t len);
+
+    /**
+     * @brief   Mark the end of the text
+     * 
+     * @return  true if a complete document was parsed
+     */
+    bool finish();
+
+    /**
+     * @brief   Test if the top level value is complete
+     */
+    bool complete() const { return state_ == DONE; }
+
+    /**
+     * @brief   Description of the error, or nullptr if none
+     */
+    const char *error() const { return error_; }
+
+    /**
+     * @brief   Number of bytes parsed, the position of an error
+     */
+    uint32_t offset() const { return offset_; }
+};
+
+#endif
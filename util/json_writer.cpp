@@ -0,0 +1,487 @@
+//                  *****  JSONWriter Implementation  *****
+
+#include "json_writer.h"
+#include "txt.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+    /**
+     * Escape needed for each character: 0 none, 'u' as \u00XX or the
+     * character following a backslash
+     */
+    struct EscapeTable
+    {
+        char    esc[256];
+
+        constexpr EscapeTable() : esc()
+        {
+            for (int ch = 0; ch < 0x20; ++ch)
+            {
+                esc[ch] = 'u';
+            }
+            esc['"'] = '"';
+            esc['\\'] = '\\';
+            esc['\b'] = 'b';
+            esc['\f'] = 'f';
+            esc['\n'] = 'n';
+            esc['\r'] = 'r';
+            esc['\t'] = 't';
+        }
+    };
+
+    constexpr EscapeTable escapes;
+
+    const char hex[] = "0123456789abcdef";
+
+    const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                              1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+    /**
+     * Format a real as printf "%.*g" would where it has a fixed point form
+     * of up to 15 significant digits, by scaling to an integer
+     * 
+     * @return  Length of text, or zero if printf is needed
+     */
+    int fixed_real(double num, int precision, char *out)
+    {
+        double mag = num < 0 ? -num : num;
+        if (precision < 1 || precision > 15 || mag < 1e-4 || mag >= 1e15)
+        {
+            return mag == 0 ? (*out = '0', 1) : 0;
+        }
+        int exp = 0;                        // Decimal exponent
+        if (mag >= 1)
+        {
+            while (exp < 15 && mag >= powers[exp + 1])
+            {
+                ++exp;
+            }
+        }
+        else
+        {
+            while (mag * powers[-exp] < 1)
+            {
+                --exp;
+            }
+        }
+        if (exp >= precision)
+        {
+            return 0;
+        }
+        int places = precision - 1 - exp;
+        double exact = mag * powers[places];
+        uint64_t scaled = (uint64_t)exact;
+        double frac = exact - scaled;
+        if (frac == 0.5)
+        {
+            //  The product may have been rounded to the tie, so use its error
+            double err = fma(mag, powers[places], -exact);
+            if (err > 0 || (err == 0 && (scaled & 1)))
+            {
+                ++scaled;                   // Ties to even, as printf
+            }
+        }
+        else if (frac > 0.5)
+        {
+            ++scaled;
+        }
+        if (scaled >= (uint64_t)powers[places + exp + 1])
+        {
+            //  Rounding carried into a new digit
+            if (++exp >= precision)
+            {
+                return 0;
+            }
+            scaled /= 10;
+            --places;
+        }
+
+        char digits[24];
+        char *cp = digits + sizeof(digits);
+        int count = 0;
+        do
+        {
+            *(--cp) = '0' + scaled % 10;
+            scaled /= 10;
+            ++count;
+        } while (scaled != 0 || count <= places);
+
+        //  Trailing zeros of the fraction are dropped, as by %g
+        char *end = digits + sizeof(digits);
+        while (places > 0 && end[-1] == '0')
+        {
+            --end;
+            --places;
+        }
+        char *ptr = out;
+        if (num < 0 && !(end - cp == 1 && *cp == '0'))
+        {
+            *ptr++ = '-';
+        }
+        int whole = end - cp - places;
+        memcpy(ptr, cp, whole);
+        ptr += whole;
+        if (places > 0)
+        {
+            *ptr++ = '.';
+            memcpy(ptr, cp + whole, places);
+            ptr += places;
+        }
+        return ptr - out;
+    }
+}
+
+JSONWriter::JSONWriter()
+{
+    init(COUNT);
+}
+
+JSONWriter::JSONWriter(TXT &txt)
+{
+    init(TEXT);
+    txt_ = &txt;
+    buffer_ = stage_;
+    bufsize_ = sizeof(stage_);
+}
+
+JSONWriter::JSONWriter(std::string &str)
+{
+    init(STRING);
+    str_ = &str;
+    buffer_ = stage_;
+    bufsize_ = sizeof(stage_);
+}
+
+JSONWriter::JSONWriter(char *buffer, uint32_t size)
+{
+    init(BUFFER);
+    buffer_ = buffer;
+    bufsize_ = size;
+}
+
+JSONWriter::JSONWriter(Sink sink, void *udata)
+{
+    init(SINK);
+    buffer_ = stage_;
+    bufsize_ = sizeof(stage_);
+    sink_ = sink;
+    udata_ = udata;
+}
+
+void JSONWriter::init(Target target)
+{
+    target_ = target;
+    buffer_ = nullptr;
+    bufsize_ = 0;
+    buflen_ = 0;
+    txt_ = nullptr;
+    str_ = nullptr;
+    sink_ = nullptr;
+    udata_ = nullptr;
+    size_ = 0;
+    ok_ = true;
+    key_ = false;
+    first_ = true;
+    depth_ = 0;
+    precision_ = JSON_WRITER_PRECISION;
+    memset(arrays_, 0, sizeof(arrays_));
+}
+
+void JSONWriter::drain()
+{
+    if (buflen_ > 0)
+    {
+        switch (target_)
+        {
+        case TEXT:
+            txt_->append(buffer_, buflen_);
+            break;
+
+        case STRING:
+            str_->append(buffer_, buflen_);
+            break;
+
+        case SINK:
+            ok_ = ok_ && sink_(buffer_, buflen_, udata_);
+            break;
+
+        default:
+            return;
+        }
+        buflen_ = 0;
+    }
+}
+
+void JSONWriter::put(const char *data, uint32_t len)
+{
+    size_ += len;
+    if (target_ == COUNT || !ok_)
+    {
+        return;
+    }
+    if (buflen_ + len <= bufsize_)
+    {
+        memcpy(buffer_ + buflen_, data, len);
+        buflen_ += len;
+    }
+    else if (target_ == BUFFER)
+    {
+        ok_ = false;
+    }
+    else
+    {
+        //  Fill and pass on the staging buffer, then stage the rest
+        uint32_t nn = bufsize_ - buflen_;
+        memcpy(buffer_ + buflen_, data, nn);
+        buflen_ = bufsize_;
+        data += nn;
+        len -= nn;
+        drain();
+        while (ok_ && len >= bufsize_)
+        {
+            memcpy(buffer_, data, bufsize_);
+            buflen_ = bufsize_;
+            data += bufsize_;
+            len -= bufsize_;
+            drain();
+        }
+        memcpy(buffer_, data, len);
+        buflen_ = len;
+    }
+}
+
+void JSONWriter::put(char ch)
+{
+    if (target_ == COUNT)
+    {
+        ++size_;
+    }
+    else if (buflen_ < bufsize_)
+    {
+        buffer_[buflen_++] = ch;
+        ++size_;
+    }
+    else
+    {
+        put(&ch, 1);
+    }
+}
+
+void JSONWriter::done()
+{
+    if (depth_ == 0)
+    {
+        flush();
+    }
+}
+
+void JSONWriter::separate()
+{
+    bool array = (arrays_[depth_ >> 5] >> (depth_ & 31)) & 1;
+    if (key_)
+    {
+        key_ = false;
+    }
+    else if (depth_ == 0 ? !first_ : !array)
+    {
+        //  Second top level value or object property without a key
+        ok_ = false;
+    }
+    else if (!first_)
+    {
+        put(',');
+    }
+    first_ = false;
+}
+
+JSONWriter &JSONWriter::begin(char ch, bool array)
+{
+    separate();
+    if (depth_ + 1 >= JSON_WRITER_DEPTH)
+    {
+        ok_ = false;
+        return *this;
+    }
+    ++depth_;
+    if (array)
+    {
+        arrays_[depth_ >> 5] |= 1u << (depth_ & 31);
+    }
+    else
+    {
+        arrays_[depth_ >> 5] &= ~(1u << (depth_ & 31));
+    }
+    first_ = true;
+    put(ch);
+    return *this;
+}
+
+JSONWriter &JSONWriter::end(char ch, bool array)
+{
+    if (depth_ == 0 || key_ || (bool)((arrays_[depth_ >> 5] >> (depth_ & 31)) & 1) != array)
+    {
+        ok_ = false;
+        return *this;
+    }
+    --depth_;
+    first_ = false;
+    put(ch);
+    done();
+    return *this;
+}
+
+JSONWriter &JSONWriter::key(std::string_view name)
+{
+    if (depth_ == 0 || key_ || ((arrays_[depth_ >> 5] >> (depth_ & 31)) & 1))
+    {
+        ok_ = false;
+        return *this;
+    }
+    if (!first_)
+    {
+        put(',');
+    }
+    first_ = false;
+    quoted(name.data(), name.size());
+    put(':');
+    key_ = true;
+    return *this;
+}
+
+void JSONWriter::quoted(const char *str, uint32_t len)
+{
+    put('"');
+    const char *end = str + len;
+    const char *run = str;              // Start of characters needing no escape
+    for ( ; str < end; ++str)
+    {
+        char esc = escapes.esc[(uint8_t)*str];
+        if (esc != 0)
+        {
+            put(run, str - run);
+            char seq[6] = { '\\', esc, '0', '0', hex[(uint8_t)*str >> 4], hex[*str & 15] };
+            put(seq, esc == 'u' ? 6 : 2);
+            run = str + 1;
+        }
+    }
+    put(run, end - run);
+    put('"');
+}
+
+JSONWriter &JSONWriter::value(const char *str)
+{
+    if (!str)
+    {
+        return null();
+    }
+    return value(std::string_view(str));
+}
+
+JSONWriter &JSONWriter::value(std::string_view str)
+{
+    separate();
+    quoted(str.data(), str.size());
+    done();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(bool flag)
+{
+    separate();
+    if (flag)
+    {
+        put("true", 4);
+    }
+    else
+    {
+        put("false", 5);
+    }
+    done();
+    return *this;
+}
+
+JSONWriter &JSONWriter::integer(uint64_t mag, bool neg)
+{
+    separate();
+    char digits[24];
+    char *cp = digits + sizeof(digits);
+    do
+    {
+        *(--cp) = '0' + mag % 10;
+        mag /= 10;
+    } while (mag != 0);
+    if (neg)
+    {
+        *(--cp) = '-';
+    }
+    put(cp, digits + sizeof(digits) - cp);
+    done();
+    return *this;
+}
+
+JSONWriter &JSONWriter::value(double num)
+{
+    if (!isfinite(num))
+    {
+        return null();
+    }
+    separate();
+    char digits[32];
+    int nn = fixed_real(num, precision_, digits);
+    if (nn == 0)
+    {
+        nn = snprintf(digits, sizeof(digits), "%.*g", precision_, num);
+    }
+    put(digits, nn);
+    done();
+    return *this;
+}
+
+JSONWriter &JSONWriter::null()
+{
+    separate();
+    put("null", 4);
+    done();
+    return *this;
+}
+
+JSONWriter &JSONWriter::raw(const char *json, uint32_t len)
+{
+    separate();
+    put(json, len);
+    done();
+    return *this;
+}
+
+bool JSONWriter::flush()
+{
+    if (target_ == BUFFER)
+    {
+        if (buflen_ < bufsize_)
+        {
+            buffer_[buflen_] = '\0';
+        }
+    }
+    else
+    {
+        drain();
+    }
+    return ok_;
+}
+
+uint32_t JSONWriter::stringSize(const char *str, uint32_t len)
+{
+    uint32_t size = len + 2;
+    for (const char *end = str + len; str < end; ++str)
+    {
+        char esc = escapes.esc[(uint8_t)*str];
+        if (esc != 0)
+        {
+            size += esc == 'u' ? 5 : 1;
+        }
+    }
+    return size;
+}
@@ -0,0 +1,236 @@
+//                  *****  JSONWriter Class  *****
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <stdint.h>
+
+class TXT;
+
+#ifndef JSON_WRITER_DEPTH
+#define JSON_WRITER_DEPTH   32              // Maximum nesting of objects and arrays
+#endif
+
+#ifndef JSON_WRITER_STAGE
+#define JSON_WRITER_STAGE   256             // Bytes collected before output
+#endif
+
+#ifndef JSON_WRITER_PRECISION
+#define JSON_WRITER_PRECISION   10          // Significant digits of real values
+#endif
+
+/**
+ * @class   JSONWriter
+ * 
+ * This class writes JSON text as it is described, without building a
+ * document or allocating per value. Objects and arrays may be nested,
+ * commas and colons are inserted as needed and strings are escaped.
+ * 
+ * The text is written to one of:
+ * 
+ *  - A TXT object (appended)
+ *  - A std::string (appended)
+ *  - A sink function, for example one calling WEB::send_data
+ *  - A fixed buffer. If it is too small the writer fails but continues
+ *    to count, so size() is the buffer size needed.
+ *  - Nothing. The writer only counts, so the same code may be run twice
+ *    to find the exact size and then to fill a buffer of that size.
+ * 
+ * Except for a fixed buffer, text is collected in an internal buffer and
+ * passed on in pieces of up to JSON_WRITER_STAGE bytes. This is done
+ * when the outermost object or array is closed, or by flush.
+ * 
+ * @code
+ *    void state(JSONWriter &jw)
+ *    {
+ *        jw.beginObject()
+ *          .property("temp", 21.5)
+ *          .property("on", true)
+ *          .key("zones").beginArray().value("attic").value("porch").endArray()
+ *          .endObject();
+ *    }
+ * 
+ *    JSONWriter count;
+ *    state(count);
+ *    TXT msg(count.size() + 1, WS::HEADROOM);
+ *    JSONWriter jw(msg);
+ *    state(jw);
+ *    web->broadcast_websocket(msg);
+ * @endcode
+ */
+class JSONWriter
+{
+public:
+    /**
+     * @brief   Function receiving written text
+     * 
+     * @param   data    Text
+     * @param   len     Length of text
+     * @param   udata   User data given to the constructor
+     * 
+     * @return  false to stop writing
+     */
+    typedef bool (*Sink)(const char *data, uint32_t len, void *udata);
+
+private:
+    enum Target
+    {
+        COUNT,                              // Count only
+        BUFFER,                             // Fixed buffer
+        TEXT,                               // TXT object
+        STRING,                             // std::string
+        SINK                                // Sink function
+    };
+
+    Target          target_;                // Output type
+    char            *buffer_;               // Fixed buffer or staging buffer
+    uint32_t        bufsize_;               // Size of buffer
+    uint32_t        buflen_;                // Bytes in buffer
+    TXT             *txt_;                  // TXT output
+    std::string     *str_;                  // std::string output
+    Sink            sink_;                  // Sink function
+    void            *udata_;                // Sink user data
+    uint32_t        size_;                  // Total bytes written
+    bool            ok_;                    // No errors
+    bool            key_;                   // Value follows a key
+    bool            first_;                 // No value yet at this level
+    int             depth_;                 // Nesting level
+    int             precision_;             // Significant digits of reals
+    uint32_t        arrays_[(JSON_WRITER_DEPTH + 31) / 32];    // Bit set at each array level
+    char            stage_[JSON_WRITER_STAGE];                 // Staging buffer
+
+    void init(Target target);
+    void drain();
+    void done();
+    void put(const char *data, uint32_t len);
+    void put(char ch);
+    void separate();
+    JSONWriter &begin(char ch, bool array);
+    JSONWriter &end(char ch, bool array);
+    JSONWriter &integer(uint64_t mag, bool neg);
+    void quoted(const char *str, uint32_t len);
+
+public:
+    /**
+     * @brief   Construct a writer that only counts
+     */
+    JSONWriter();
+
+    /**
+     * @brief   Construct a writer appending to a TXT object
+     */
+    JSONWriter(TXT &txt);
+
+    /**
+     * @brief   Construct a writer appending to a std::string
+     */
+    JSONWriter(std::string &str);
+
+    /**
+     * @brief   Construct a writer filling a fixed buffer
+     * 
+     * @param   buffer  Buffer
+     * @param   size    Size of buffer. The text is null terminated by
+     *                  flush if there is room.
+     */
+    JSONWriter(char *buffer, uint32_t size);
+
+    /**
+     * @brief   Construct a writer passing text to a sink
+     * 
+     * @param   sink    Sink function
+     * @param   udata   User data for sink
+     */
+    JSONWriter(Sink sink, void *udata);
+
+    JSONWriter(const JSONWriter &) = delete;
+    JSONWriter &operator=(const JSONWriter &) = delete;
+
+    /**
+     * @brief   Start and end an object or array
+     */
+    JSONWriter &beginObject() { return begin('{', false); }
+    JSONWriter &endObject() { return end('}', false); }
+    JSONWriter &beginArray() { return begin('[', true); }
+    JSONWriter &endArray() { return end(']', true); }
+
+    /**
+     * @brief   Write the name of the next property of an object
+     * 
+     * @param   name    Property name
+     */
+    JSONWriter &key(std::string_view name);
+
+    /**
+     * @brief   Write a value
+     * 
+     * @details A null string pointer is written as null. Reals that are
+     *          not finite, which JSON cannot represent, are written as null.
+     */
+    JSONWriter &value(const char *str);
+    JSONWriter &value(std::string_view str);
+    JSONWriter &value(const std::string &str) { return value(std::string_view(str)); }
+    JSONWriter &value(bool flag);
+    JSONWriter &value(int num) { return integer(num < 0 ? -(uint64_t)num : num, num < 0); }
+    JSONWriter &value(unsigned num) { return integer(num, false); }
+    JSONWriter &value(long num) { return integer(num < 0 ? -(uint64_t)num : num, num < 0); }
+    JSONWriter &value(unsigned long num) { return integer(num, false); }
+    JSONWriter &value(long long num) { return integer(num < 0 ? -(uint64_t)num : num, num < 0); }
+    JSONWriter &value(unsigned long long num) { return integer(num, false); }
+    JSONWriter &value(double num);
+    JSONWriter &null();
+
+    /**
+     * @brief   Write text that is already JSON, for example a cached fragment
+     * 
+     * @param   json    JSON value
+     * @param   len     Length of value
+     */
+    JSONWriter &raw(const char *json, uint32_t len);
+
+    /**
+     * @brief   Write a property (key and value)
+     */
+    template<typename T> JSONWriter &property(std::string_view name, const T &val) { key(name); return value(val); }
+
+    /**
+     * @brief   Set the number of significant digits of real values
+     */
+    void precision(int digits) { precision_ = digits; }
+
+    /**
+     * @brief   Pass on any staged text or terminate a fixed buffer
+     * 
+     * @return  true if all text has been written without error
+     */
+    bool flush();
+
+    /**
+     * @brief   Test if text has been written without error
+     */
+    bool ok() const { return ok_; }
+
+    /**
+     * @brief   Test if a complete value has been written
+     */
+    bool complete() const { return ok_ && depth_ == 0 && !first_; }
+
+    /**
+     * @brief   Number of bytes written (or needed if a fixed buffer was too small)
+     */
+    uint32_t size() const { return size_; }
+
+    /**
+     * @brief   Length of a string once escaped and quoted
+     * 
+     * @param   str     String
+     * @param   len     Length of string
+     * 
+     * @return  Number of bytes written by value
+     */
+    static uint32_t stringSize(const char *str, uint32_t len);
+};
+
+#endif
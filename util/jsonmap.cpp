@@ -1,10 +1,13 @@
 //                  *****  JSONMap Implementation  *****
 
 #include "jsonmap.h"
+#include "json_writer.h"
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
+uint32_t JSONMap::loads_ = 0;
+
 bool JSONMap::loadFile(const char *filename)
 {
     clear();
@@ -14,7 +17,7 @@ bool JSONMap::loadFile(const char *filename)
     {
         struct stat sb;
         stat(filename, &sb);
-        data_ = new char[sb.st_size + 1];
+        data_ = allocData(sb.st_size + 1);
         fread(data_, sb.st_size, 1, f);
         data_[sb.st_size] = 0;
         fclose(f);
@@ -22,9 +25,7 @@ bool JSONMap::loadFile(const char *filename)
     }
     else
     {
-        data_ = new char[8];
-        strncpy(data_, "{}", 8);
-        load();
+        setEmpty();
         ret = false;
     }
     return ret;
@@ -34,30 +35,94 @@ bool JSONMap::loadString(const char *str)
 {
     clear();
     int len = strlen(str);
-    data_ = new char[len + 1];
-    strncpy(data_, str, len + 1);
+    data_ = allocData(len + 1);
+    memcpy(data_, str, len + 1);
+    return load();
+}
+
+bool JSONMap::loadInPlace(char *str)
+{
+    clear();
+    data_ = str;
     return load();
 }
 
+char *JSONMap::allocData(uint32_t size)
+{
+    char *data = arena_ ? static_cast<char *>(arena_->alloc(size)) : nullptr;
+    dataHeap_ = data == nullptr;
+    if (dataHeap_)
+    {
+        data = new char[size];
+    }
+    else
+    {
+        end_ = arena_->used();
+    }
+    return data;
+}
+
+json_t *JSONMap::allocNodes(int count)
+{
+    json_t *json = arena_ ? static_cast<json_t *>(arena_->alloc(count * sizeof(json_t), alignof(json_t))) : nullptr;
+    jsonHeap_ = json == nullptr;
+    if (jsonHeap_)
+    {
+        json = new json_t[count];
+    }
+    else
+    {
+        end_ = arena_->used();
+    }
+    return json;
+}
+
+void JSONMap::setEmpty()
+{
+    if (dataHeap_)
+    {
+        delete [] data_;
+    }
+    data_ = allocData(8);
+    strncpy(data_, "{}", 8);
+    if (!json_)
+    {
+        json_ = allocNodes(1);
+    }
+    json_create(data_, json_, 1);
+    load_ = ++loads_;
+}
+
 bool JSONMap::load()
 {
     int jsz = itemCount(data_) + 1;
-    json_ = new json_t[jsz];
+    json_ = allocNodes(jsz);
     json_t const* json = json_create(data_, json_, jsz);
     bool ret = json != nullptr;
-    if (!ret)
+    if (ret)
     {
-        delete [] data_;
-        data_ = new char[8];
-        strncpy(data_, "{}", 8);
-        json = json_create(data_, json_, jsz);
+        load_ = ++loads_;
+    }
+    else
+    {
+        setEmpty();
     }
     return ret;
 }
 
 const json_t *JSONMap::findProperty(const char *name) const
 {
-    return json_getProperty(json_, name);
+    return root().find(name).json();
+}
+
+JSONMap::Node JSONMap::node(const Path &path) const
+{
+    if (load_ == 0 || path.load_ != load_)
+    {
+        path.node_ = root().find(path.path_);
+        path.load_ = load_;
+    }
+    return path.node_;
 }
 
 bool JSONMap::hasProperty(const char *name) const
@@ -109,22 +174,33 @@ bool JSONMap::boolValue(const char *name, bool defVal) const
     return ret;
 }
 
+int JSONMap::decode(const JSONSchema &schema, JSONSchema::Value *values) const
+{
+    return root().decode(schema, values);
+}
+
 bool JSONMap::fromMap(const JMAP &jmap, std::string &str)
 {
-    bool ret = false;
     str.clear();
-    if (jmap.size() > 0)
+    if (jmap.size() == 0)
     {
-        ret = true;
-        std::string sep("{\"");
-        for (auto it = jmap.cbegin(); it != jmap.cend(); ++it)
-        {
-            str += sep + it->first + "\":\"" + it->second + "\"";
-            sep = ",\"";
-        }
-        str += "}";
+        return false;
     }
-    return ret;
+    uint32_t size = 1 + jmap.size() * 2;
+    for (auto it = jmap.cbegin(); it != jmap.cend(); ++it)
+    {
+        size += JSONWriter::stringSize(it->first.c_str(), it->first.size())
+              + JSONWriter::stringSize(it->second.c_str(), it->second.size());
+    }
+    str.reserve(size);
+    JSONWriter jw(str);
+    jw.beginObject();
+    for (auto it = jmap.cbegin(); it != jmap.cend(); ++it)
+    {
+        jw.property(it->first, it->second);
+    }
+    jw.endObject();
+    return jw.complete();
 }
 
 int JSONMap::itemCount(const char *jsonstr)
@@ -151,29 +227,33 @@ int JSONMap::itemCount(const char *jsonstr)
     ret += 2;
     while (*str != '\0' && depth > 0)
     {
-        if (!quoted && (*str == '{' || *str == '['))
+        if (quoted)
+        {
+            if (*str == '\\' && str[1] != '\0')
+            {
+                ++str;                      // Escaped character
+            }
+            else if (*str == '"')
+            {
+                quoted = false;
+            }
+        }
+        else if (*str == '{' || *str == '[')
         {
             ++depth;
             ret += 1;
         }
-        else if (!quoted && (*str == '}' || *str == ']'))
+        else if (*str == '}' || *str == ']')
         {
             --depth;
         }
-        else if (!quoted && *str == ',')
+        else if (*str == ',')
         {
             ret += 1;
         }
-        else if (!quoted && *str == '"')
+        else if (*str == '"')
         {
-            quoted == true;
-        }
-        else if (quoted && *str == '"')
-        {
-            if (str [-1] != '\\')
-            {
-                quoted = false;
-            }
+            quoted = true;
         }
         ++str;
     }
@@ -197,8 +277,208 @@ int JSONMap::itemCount(const char *jsonstr)
 
 void JSONMap::clear()
 {
-    if (data_) delete [] data_;
+    if (dataHeap_) delete [] data_;
     data_ = nullptr;
-    if (json_) delete [] json_;
+    dataHeap_ = false;
+    if (jsonHeap_) delete [] json_;
     json_ = nullptr;
+    jsonHeap_ = false;
+    load_ = 0;
+    if (arena_)
+    {
+        //  Return the space to the arena unless it has since been used by another
+        if (end_ > mark_ && arena_->used() == end_)
+        {
+            arena_->release(mark_);
+        }
+        mark_ = end_ = arena_->used();
+    }
+}
+
+namespace
+{
+    /**
+     * Compare a property name with a JSON Pointer reference token, in
+     * which "~1" stands for '/' and "~0" for '~'
+     */
+    bool token_equal(const char *name, const char *token, const char *end)
+    {
+        while (token < end)
+        {
+            char ch = *token++;
+            if (ch == '~' && token < end && (*token == '0' || *token == '1'))
+            {
+                ch = *token++ == '1' ? '/' : '~';
+            }
+            if (*name++ != ch)
+            {
+                return false;
+            }
+        }
+        return *name == '\0';
+    }
+}
+
+JSONMap::Node JSONMap::Node::find(const char *path) const
+{
+    if (!json_ || *path != '/')
+    {
+        //  Property name, or an empty path
+        if (*path == '\0' || !json_ || json_getType(json_) != JSON_OBJ)
+        {
+            return *path == '\0' ? *this : Node();
+        }
+        return Node(json_getProperty(json_, path));
+    }
+    const json_t *node = json_;
+    while (node && *path == '/')
+    {
+        const char *token = ++path;
+        while (*path != '\0' && *path != '/')
+        {
+            ++path;
+        }
+        const json_t *child = json_getType(node) == JSON_OBJ || json_getType(node) == JSON_ARRAY ? json_getChild(node) : nullptr;
+        if (json_getType(node) == JSON_ARRAY)
+        {
+            //  Array index: decimal digits without leading zeros
+            int index = 0;
+            const char *cp = token;
+            for ( ; cp < path && *cp >= '0' && *cp <= '9' && index < 100000; ++cp)
+            {
+                index = 10 * index + (*cp - '0');
+            }
+            if (cp == token || cp < path || (*token == '0' && path - token > 1))
+            {
+                return Node();
+            }
+            for ( ; child && index > 0; --index)
+            {
+                child = json_getSibling(child);
+            }
+        }
+        else
+        {
+            while (child && !token_equal(json_getName(child), token, path))
+            {
+                child = json_getSibling(child);
+            }
+        }
+        node = child;
+    }
+    return Node(node);
+}
+
+int JSONMap::Node::size() const
+{
+    int count = 0;
+    for (Iterator it = begin(); it != end(); ++it)
+    {
+        ++count;
+    }
+    return count;
+}
+
+const char *JSONMap::Node::strValue(const char *defVal) const
+{
+    return isContainer() || type() == JSON_NULL ? defVal : json_getValue(json_);
+}
+
+int JSONMap::Node::intValue(int defVal) const
+{
+    return isContainer() || type() == JSON_NULL ? defVal : json_getInteger(json_);
+}
+
+double JSONMap::Node::realValue(double defVal) const
+{
+    return isContainer() || type() == JSON_NULL ? defVal : json_getReal(json_);
+}
+
+bool JSONMap::Node::boolValue(bool defVal) const
+{
+    return isContainer() || type() == JSON_NULL ? defVal : json_getBoolean(json_);
+}
+
+int JSONMap::Node::decode(const JSONSchema &schema, JSONSchema::Value *values) const
+{
+    for (int id = 0; id < schema.count(); ++id)
+    {
+        values[id].present = false;
+    }
+    if (!json_ || json_getType(json_) != JSON_OBJ)
+    {
+        return 0;
+    }
+    int found = 0;
+    for (const json_t *prop = json_getChild(json_); prop; prop = json_getSibling(prop))
+    {
+        int id = schema.find(json_getName(prop));
+        jsonType_t type = json_getType(prop);
+        if (id < 0 || type == JSON_OBJ || type == JSON_ARRAY || type == JSON_NULL)
+        {
+            continue;
+        }
+        JSONSchema::Value &val = values[id];
+        switch (schema.field(id).type)
+        {
+        case JSONSchema::STRING:
+            val.str = json_getValue(prop);
+            break;
+
+        case JSONSchema::INTEGER:
+            val.integer = json_getInteger(prop);
+            break;
+
+        case JSONSchema::REAL:
+            val.real = json_getReal(prop);
+            break;
+
+        case JSONSchema::BOOLEAN:
+            val.boolean = type == JSON_BOOLEAN ? json_getBoolean(prop) : json_getInteger(prop) != 0;
+            break;
+        }
+        if (!val.present)
+        {
+            val.present = true;
+            ++found;
+        }
+    }
+    return found;
+}
+
+void JSONMap::Node::write(JSONWriter &jw) const
+{
+    switch (type())
+    {
+    case JSON_OBJ:
+        jw.beginObject();
+        for (Node member : *this)
+        {
+            jw.key(member.name());
+            member.write(jw);
+        }
+        jw.endObject();
+        break;
+
+    case JSON_ARRAY:
+        jw.beginArray();
+        for (Node member : *this)
+        {
+            member.write(jw);
+        }
+        jw.endArray();
+        break;
+
+    case JSON_TEXT:
+        jw.value(json_getValue(json_));
+        break;
+
+    case JSON_NULL:
+        jw.null();
+        break;
+
+    default:
+        jw.raw(json_getValue(json_), strlen(json_getValue(json_)));
+        break;
+    }
 }
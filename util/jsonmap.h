@@ -4,23 +4,188 @@
 #define JSONMAP_H
 
 #include <tiny-json.h>
+#include "json_arena.h"
+#include "json_schema.h"
 #include <map>
 #include <string>
 
+class JSONWriter;
+
 /**
  * @class JSONMap
  * 
- * Manage a map of a single level JSON clsss definition.
+ * Manage a map of a JSON clsss definition.
+ * 
+ * Properties of the top level object are found by name. Nested objects
+ * and arrays are reached by JSON Pointer paths (RFC 6901), for example
+ * "/wifi/ssid" or "/ir/codes/3", given in place of a name or to node.
+ * A Path object caches its lookup until the map is reloaded, and a Node
+ * iterates over the members of an object or array without allocation:
+ * 
+ * @code
+ *    static JSONMap::Path ssid("/wifi/ssid");
+ *    const char *name = config.node(ssid).strValue("");
+ * 
+ *    for (JSONMap::Node code : config.node("/ir/codes"))
+ *    {
+ *        send(code.intValue("/address"), code.intValue("/command"));
+ *    }
+ * @endcode
+ * 
+ * By default the nodes and a copy of the JSON text are allocated on the
+ * heap for each load. If an arena is given they are taken from it
+ * instead (falling back to the heap if it is full), and loadInPlace
+ * parses a caller's buffer without copying it.
  */
 class JSONMap
 {
+public:
+    /**
+     * @class   Node
+     * 
+     * A value in a loaded JSON document, which remains valid until the
+     * map is cleared or reloaded. An invalid node (not found) returns
+     * default values and has no members.
+     */
+    class Node
+    {
+    private:
+        const json_t    *json_;             // tiny-json property (nullptr if not found)
+
+    public:
+        class Iterator
+        {
+        private:
+            const json_t    *json_;         // Current member
+
+        public:
+            Iterator(const json_t *json) : json_(json) {}
+            Node operator*() const { return Node(json_); }
+            Iterator &operator++() { json_ = json_getSibling(json_); return *this; }
+            bool operator!=(const Iterator &other) const { return json_ != other.json_; }
+        };
+
+        Node(const json_t *json = nullptr) : json_(json) {}
+
+        /**
+         * @brief   Test if the node exists
+         */
+        bool valid() const { return json_ != nullptr; }
+
+        /**
+         * @brief   tiny-json property, for direct use of the tiny-json functions
+         */
+        const json_t *json() const { return json_; }
+
+        /**
+         * @brief   Property name (nullptr for an array element)
+         */
+        const char *name() const { return json_ ? json_getName(json_) : nullptr; }
+
+        /**
+         * @brief   Type of value (JSON_NULL if not found)
+         */
+        jsonType_t type() const { return json_ ? json_getType(json_) : JSON_NULL; }
+
+        /**
+         * @brief   Test if the node is an object or array
+         */
+        bool isContainer() const { return type() == JSON_OBJ || type() == JSON_ARRAY; }
+
+        /**
+         * @brief   Find a member of an object or array
+         * 
+         * @param   path    JSON Pointer relative to this node, starting with
+         *                  '/' (an empty path is this node), or a property name
+         * 
+         * @return  Node found, which is invalid if there is none
+         */
+        Node find(const char *path) const;
+
+        /**
+         * @brief   Number of members of an object or array
+         */
+        int size() const;
+
+        /**
+         * @brief   Iterate over the members of an object or array
+         */
+        Iterator begin() const { return Iterator(isContainer() ? json_getChild(json_) : nullptr); }
+        Iterator end() const { return Iterator(nullptr); }
+
+        /**
+         * @brief   Get the value of the node or of a member
+         * 
+         * @param   path    JSON Pointer or property name of member
+         * @param   defVal  Default value if not found or not a value
+         * 
+         * @return  Value or default value
+         */
+        const char *strValue(const char *defVal=nullptr) const;
+        int intValue(int defVal=0) const;
+        double realValue(double defVal=0.0) const;
+        bool boolValue(bool defVal=false) const;
+        const char *strValue(const char *path, const char *defVal) const { return find(path).strValue(defVal); }
+        int intValue(const char *path, int defVal=0) const { return find(path).intValue(defVal); }
+        double realValue(const char *path, double defVal=0.0) const { return find(path).realValue(defVal); }
+        bool boolValue(const char *path, bool defVal=false) const { return find(path).boolValue(defVal); }
+
+        /**
+         * @brief   Convert the properties of an object in a schema in one pass
+         * 
+         * @see     JSONMap::decode
+         */
+        int decode(const JSONSchema &schema, JSONSchema::Value *values) const;
+
+        /**
+         * @brief   Write the node, including any members, as JSON
+         */
+        void write(JSONWriter &jw) const;
+    };
+
+    /**
+     * @class   Path
+     * 
+     * A JSON Pointer whose lookup is cached. The cache is checked against
+     * the load that filled it, so a Path may be kept (for example static)
+     * and used with any map.
+     */
+    class Path
+    {
+    private:
+        friend class JSONMap;
+        const char          *path_;         // JSON Pointer
+        mutable Node        node_;          // Node found
+        mutable uint32_t    load_;          // Load in which node_ was found (0 = none)
+
+    public:
+        /**
+         * @brief   Construct a path
+         * 
+         * @param   path    JSON Pointer, which must remain valid for the life
+         *                  of the Path (normally a literal)
+         */
+        Path(const char *path) : path_(path), load_(0) {}
+    };
+
 private:
     json_t          *json_;             // JSON properties
     char            *data_;             // Data buffer
+    JSONArena       *arena_;            // Arena for nodes and data (optional)
+    uint32_t        mark_;              // Arena position before load
+    uint32_t        end_;               // Arena position after load
+    bool            jsonHeap_;          // json_ allocated on heap
+    bool            dataHeap_;          // data_ allocated on heap
+    uint32_t        load_;              // Number identifying the current load
+
+    static uint32_t loads_;             // Loads by all maps
 
     JSONMap(const JSONMap &other);
     const JSONMap &operator = (const JSONMap &other);
 
+    char *allocData(uint32_t size);
+    json_t *allocNodes(int count);
+    void setEmpty();
     bool load();
     const json_t *findProperty(const char *name) const;
 
@@ -30,10 +195,25 @@ public:
      * 
      * @param   json    Pointr to JSON string
      */
-    JSONMap() : json_(nullptr), data_(nullptr) {}
-    JSONMap(const char *json) : json_(nullptr), data_(nullptr) { loadString(json); }
+    JSONMap() : json_(nullptr), data_(nullptr), arena_(nullptr), mark_(0), end_(0), jsonHeap_(false), dataHeap_(false), load_(0) {}
+    JSONMap(const char *json) : JSONMap() { loadString(json); }
     ~JSONMap() { clear(); }
 
+    /**
+     * @brief   Construct using an arena
+     * 
+     * @param   arena   Arena for nodes and copies of JSON text, which must
+     *                  outlive the map
+     */
+    JSONMap(JSONArena &arena) : JSONMap() { arena_ = &arena; }
+
+    /**
+     * @brief   Set the arena used by subsequent loads
+     * 
+     * @param   arena   Arena, or nullptr to use the heap
+     */
+    void useArena(JSONArena *arena) { clear(); arena_ = arena; }
+
     /**
      * @brief Load class from file
      * 
@@ -52,10 +232,38 @@ public:
      */
     bool loadString(const char *str);
 
+    /**
+     * @brief Load class from a buffer without copying it
+     * 
+     * The buffer is modified by parsing and values refer to it, so it
+     * must remain valid and unchanged while the map is in use.
+     * 
+     * @param   str         Null terminated buffer containing JSON data
+     * 
+     * @return  true if successful
+     */
+    bool loadInPlace(char *str);
+
+    /**
+     * @brief   Find a value in the document
+     * 
+     * @param   path    JSON Pointer (an empty path is the top level object)
+     *                  or a property name of the top level object
+     * 
+     * @return  Node found, which is invalid if there is none
+     */
+    Node node(const char *path) const { return root().find(path); }
+    Node node(const Path &path) const;
+
+    /**
+     * @brief   The top level object
+     */
+    Node root() const { return Node(json_); }
+
     /**
      * @brief   Test if object has a property
      * 
-     * @param   name    Property name
+     * @param   name    Property name or JSON Pointer
      * 
      * @return  true if property exists
      */
@@ -64,7 +272,7 @@ public:
     /**
      * @brief   Get the value of a property (string, integer, real) or boolean
      * 
-     * @param   name    Property name
+     * @param   name    Property name or JSON Pointer
      * @param   defval  Default value if property not defined
      * 
      * @return  Property value or default value if not defined
@@ -74,9 +282,28 @@ public:
     double realValue(const char *name, double defVal=0.0) const;
     bool boolValue(const char *name, bool defVal=false) const;
 
+    /**
+     * @brief   Convert the properties in a schema in one pass
+     * 
+     * Each property of the object is found in the schema by its perfect
+     * hash and converted to the type given there. Properties not in the
+     * schema are ignored. A property that is null, an object or an array
+     * is treated as missing. String values point into the map's data, so
+     * are valid until it is cleared or reloaded.
+     * 
+     * @param   schema  Expected properties
+     * @param   values  Array of schema.count() values, indexed by property id
+     * 
+     * @return  Number of values found
+     */
+    int decode(const JSONSchema &schema, JSONSchema::Value *values) const;
+
     /**
      * @brief   Create JSON string from a std::map of keys and values
      * 
+     * @details The values are written as strings, escaped as needed,
+     *          into a string reserved at the exact size
+     * 
      * @param   jmap    Map of keys and values
      * @param   str     String to receive JSON
      * 
@@ -0,0 +1,270 @@
+//                  *****  LogQuery Implementation  *****
+
+#include "log_query.h"
+#include "file_logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char time_init[] = "Time initialized at ";
+
+LogQuery::LogQuery()
+ : level_(0x7fffffff), since_(0), until_(0), boot_(false), client_(0),
+   limit_(LOG_QUERY_LIMIT), budget_(LOG_QUERY_BUDGET), resume_(false),
+   start_(0), time_(0), next_(0), next_time_(0), more_(false)
+{
+}
+
+bool LogQuery::cursor(const char *cursor)
+{
+    char *end;
+    unsigned long pos = strtoul(cursor, &end, 10);
+    if (end == cursor || *end != ':')
+    {
+        return false;
+    }
+    const char *tm = end + 1;
+    unsigned long when = strtoul(tm, &end, 10);
+    if (end == tm || *end != '\0')
+    {
+        return false;
+    }
+    start_ = pos;
+    time_ = when;
+    resume_ = true;
+    return true;
+}
+
+std::string LogQuery::next() const
+{
+    char cursor[32];
+    snprintf(cursor, sizeof(cursor), "%lu:%lu", (unsigned long)next_, (unsigned long)next_time_);
+    return std::string(cursor);
+}
+
+int LogQuery::line_level(const char *line, const char **text)
+{
+    *text = line;
+    if (line[0] == 'E' && line[1] == ' ')
+    {
+        *text = line + 2;
+        return FileLogger::LEVEL_ERROR;
+    }
+    if (line[0] == 'D' && isdigit(line[1]))
+    {
+        char *end;
+        long level = strtol(line + 1, &end, 10);
+        if (*end == ' ')
+        {
+            *text = end + 1;
+            return level;
+        }
+    }
+    return 0;
+}
+
+time_t LogQuery::line_time(const char *line)
+{
+    //  Timestamp lines are written by FileLogger::timestamp ("%c %Z"),
+    //  either alone or following initialize_timestamps' message
+    if (strncmp(line, time_init, sizeof(time_init) - 1) == 0)
+    {
+        line += sizeof(time_init) - 1;
+    }
+    if (!isalpha(line[0]))
+    {
+        return 0;
+    }
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(line, "%c", &tm);
+    if (end == nullptr)
+    {
+        return 0;
+    }
+    while (*end == ' ')
+    {
+        ++end;
+    }
+    while (isalnum(*end) || *end == '+' || *end == '-')
+    {
+        ++end;
+    }
+    if (*end != '\n' && *end != '\0')
+    {
+        return 0;
+    }
+    tm.tm_isdst = -1;
+    time_t ret = mktime(&tm);
+    return ret > 0 ? ret : 0;
+}
+
+bool LogQuery::glob(const char *pattern, const char *text, int len)
+{
+    //  Iterative match, backtracking only to the last '*'
+    const char *end = text + len;
+    const char *star = nullptr;
+    const char *resume = nullptr;
+    while (text < end)
+    {
+        if (*pattern == '*')
+        {
+            star = ++pattern;
+            resume = text;
+        }
+        else if (*pattern != '\0' && (*pattern == '?' || *pattern == *text))
+        {
+            ++pattern;
+            ++text;
+        }
+        else if (star)
+        {
+            pattern = star;
+            text = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+    {
+        ++pattern;
+    }
+    return *pattern == '\0';
+}
+
+bool LogQuery::has_client(const char *line) const
+{
+    static const char *forms[] = { "(%d)", "(handle %d)", "(client %d)" };
+    char text[24];
+    for (const char *form : forms)
+    {
+        snprintf(text, sizeof(text), form, client_);
+        if (strstr(line, text))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LogQuery::select(const char *line, int len, time_t now) const
+{
+    const char *text;
+    int level = line_level(line, &text);
+    if (level_ == FileLogger::LEVEL_ERROR ? level != FileLogger::LEVEL_ERROR : level > level_)
+    {
+        return false;
+    }
+    if (since_ != 0 && (now == 0 || now < since_))
+    {
+        return false;
+    }
+    if (client_ != 0 && !has_client(line))
+    {
+        return false;
+    }
+    if (!contains_.empty() && !strstr(line, contains_.c_str()))
+    {
+        return false;
+    }
+    if (!match_.empty())
+    {
+        len -= text - line;
+        if (len > 0 && text[len - 1] == '\n')
+        {
+            --len;
+        }
+        return glob(match_.c_str(), text, len);
+    }
+    return true;
+}
+
+bool LogQuery::run(FileLogger &log, Emit emit, void *udata)
+{
+    uint32_t base = log.base_position();
+    uint32_t size = log.file_size();
+    uint32_t start = resume_ ? start_ : boot_ ? log.boot_position() : base;
+    time_t now = resume_ ? time_ : 0;
+    if (start < base)
+    {
+        //  Start of query has been deleted, so its time is no longer known
+        start = base;
+        now = 0;
+    }
+    if (start > base + size)
+    {
+        start = base + size;
+    }
+    next_ = start;
+    next_time_ = now;
+    more_ = false;
+
+    FILE *f = log.open();
+    if (!f)
+    {
+        return false;
+    }
+    log.position(f, start - base);
+
+    char line[LOG_QUERY_LINE];
+    uint32_t pos = start;
+    uint32_t scanned = 0;
+    int lines = 0;
+    bool begin = true;              // Next read starts a line
+    bool selected = false;          // Current line selected
+    while (true)
+    {
+        if (begin && (lines >= limit_ || scanned >= budget_))
+        {
+            more_ = pos < base + size;
+            break;
+        }
+        if (!log.read(f, line, sizeof(line)))
+        {
+            break;
+        }
+        int len = strlen(line);
+        bool end = len > 0 && line[len - 1] == '\n';
+        if (!end && len < (int)sizeof(line) - 1)
+        {
+            //  Incomplete last line, still being written
+            break;
+        }
+        if (begin)
+        {
+            time_t ts = line_time(line);
+            if (ts != 0)
+            {
+                now = ts;
+            }
+            if (until_ != 0 && now > until_)
+            {
+                break;
+            }
+            selected = select(line, len, now);
+            if (selected)
+            {
+                ++lines;
+            }
+        }
+        if (selected && !emit(line, len, udata))
+        {
+            //  Resume from the start of this line
+            more_ = true;
+            break;
+        }
+        pos += len;
+        scanned += len;
+        begin = end;
+        if (begin)
+        {
+            next_ = pos;
+            next_time_ = now;
+        }
+    }
+    log.close(f);
+    return true;
+}
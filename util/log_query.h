@@ -0,0 +1,170 @@
+//                  *****  LogQuery Class  *****
+
+#ifndef LOG_QUERY_H
+#define LOG_QUERY_H
+
+#include <string>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef LOG_QUERY_LIMIT
+#define LOG_QUERY_LIMIT     100     // Default maximum lines returned by a query
+#endif
+#ifndef LOG_QUERY_BUDGET
+#define LOG_QUERY_BUDGET    32768   // Default maximum bytes scanned by a query
+#endif
+#ifndef LOG_QUERY_LINE
+#define LOG_QUERY_LINE      256     // Line buffer size
+#endif
+
+class FileLogger;
+
+/**
+ * @class   LogQuery
+ * 
+ * This class selects lines from a FileLogger log by level, time, text
+ * and client handle. All the filters given must match for a line to be
+ * returned.
+ * 
+ * The log is read a line at a time from a fixed buffer, stopping when
+ * the line limit is reached or the scan budget is used, so a query takes
+ * a bounded time however large the log. The cursor returned by next()
+ * continues the query from where it stopped. A cursor is an absolute log
+ * position (see FileLogger::base_position) and the time in effect at that
+ * position, so it remains valid when old segments are deleted.
+ * 
+ * Lines have no time of their own. A line is given the time of the last
+ * timestamp before it, and lines before the first timestamp have no time
+ * and do not match a since filter. Only the first line of a message has
+ * a level tag, so further lines of a message are treated as level 0.
+ */
+class LogQuery
+{
+public:
+    /**
+     * @brief   Function receiving selected lines
+     * 
+     * @param   line    Line text (not null terminated, includes any newline)
+     * @param   len     Length of line
+     * @param   udata   User data given to run
+     * 
+     * @return  false to stop the query
+     */
+    typedef bool (*Emit)(const char *line, int len, void *udata);
+
+private:
+    int             level_;             // Highest debug level returned (LEVEL_ERROR for errors only)
+    time_t          since_;             // Earliest time returned (0 for no limit)
+    time_t          until_;             // Latest time returned (0 for no limit)
+    bool            boot_;              // Start at the first message since boot
+    std::string     contains_;          // Text to be found in line
+    std::string     match_;             // Pattern to match line
+    int             client_;            // Client handle (0 for any)
+    int             limit_;             // Maximum lines returned
+    uint32_t        budget_;            // Maximum bytes scanned
+    bool            resume_;            // Continue from cursor
+    uint32_t        start_;             // Absolute position to start
+    time_t          time_;              // Time at start position
+    uint32_t        next_;              // Absolute position to continue
+    time_t          next_time_;         // Time at continue position
+    bool            more_;              // Query stopped before end of log
+
+    static int line_level(const char *line, const char **text);
+    static time_t line_time(const char *line);
+    static bool glob(const char *pattern, const char *text, int len);
+    bool select(const char *line, int len, time_t now) const;
+    bool has_client(const char *line) const;
+
+public:
+    /**
+     * @brief   Constructor: query for all lines of the log
+     */
+    LogQuery();
+
+    /**
+     * @brief   Set the highest debug level returned
+     * 
+     * @param   level   Debug level (FileLogger::LEVEL_ERROR for errors only).
+     *                  Errors and level 0 messages are always returned.
+     */
+    void level(int level) { level_ = level; }
+
+    /**
+     * @brief   Set the time range returned
+     * 
+     * @param   since   Earliest time (0 for no limit)
+     * @param   until   Latest time (0 for no limit)
+     */
+    void time_range(time_t since, time_t until) { since_ = since; until_ = until; }
+
+    /**
+     * @brief   Start at the first message logged since boot
+     * 
+     * @details Ignored if a cursor is given
+     */
+    void since_boot() { boot_ = true; }
+
+    /**
+     * @brief   Return lines containing a string
+     */
+    void contains(const std::string &text) { contains_ = text; }
+
+    /**
+     * @brief   Return lines matching a pattern
+     * 
+     * @param   pattern Pattern to match the whole message text (without
+     *                  level tag or newline). '*' matches any text and
+     *                  '?' any character.
+     */
+    void match(const std::string &pattern) { match_ = pattern; }
+
+    /**
+     * @brief   Return lines for a client connection
+     * 
+     * @param   handle  Client handle, as logged in the form "(n)",
+     *                  "(handle n)" or "(client n)"
+     */
+    void client(int handle) { client_ = handle; }
+
+    /**
+     * @brief   Set the maximum lines returned
+     */
+    void limit(int lines) { limit_ = lines; }
+
+    /**
+     * @brief   Set the maximum bytes of log scanned
+     */
+    void budget(uint32_t bytes) { budget_ = bytes; }
+
+    /**
+     * @brief   Continue a previous query
+     * 
+     * @param   cursor  Cursor returned by next()
+     * 
+     * @return  false if the cursor is invalid
+     */
+    bool cursor(const char *cursor);
+
+    /**
+     * @brief   Run the query
+     * 
+     * @param   log     Log to read
+     * @param   emit    Function receiving selected lines
+     * @param   udata   User data for emit
+     * 
+     * @return  false if the log could not be read
+     */
+    bool run(FileLogger &log, Emit emit, void *udata);
+
+    /**
+     * @brief   Cursor to continue the query after run
+     */
+    std::string next() const;
+
+    /**
+     * @brief   Test if run stopped before the end of the log
+     */
+    bool more() const { return more_; }
+};
+
+#endif
@@ -3,12 +3,252 @@
 #include "logger.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+static_assert(LOG_RECORD_MAX <= LOG_RING_SIZE, "LOG_RECORD_MAX larger than LOG_RING_SIZE");
+
+namespace
+{
+    /*
+     * A deferred message record is a sequence of words:
+     * 
+     *      header      Record length in words, flags and debug level
+     *      format      Format string pointer
+     *      arguments   Each argument in the words needed for its type. A string
+     *                  is its length followed by its characters.
+     */
+    const uint32_t  LOG_WORDS = 0xffff;             // Header record length bits
+    const uint32_t  LOG_TRUNCATED = 0x10000;        // Header flag for arguments omitted
+    const int       LOG_LEVEL_SHIFT = 24;           // Header debug level bits (signed)
+    const uint32_t  STR_TRUNCATED = 0x80000000;     // String length flag for characters omitted
+
+    enum ArgType
+    {
+        ARG_INT,                    // int (and promoted char and short)
+        ARG_LONG,                   // long
+        ARG_LLONG,                  // long long
+        ARG_INTMAX,                 // intmax_t
+        ARG_SIZE,                   // size_t
+        ARG_PTRDIFF,                // ptrdiff_t
+        ARG_DOUBLE,                 // double (and promoted float)
+        ARG_LDOUBLE,                // long double
+        ARG_PTR,                    // void *
+        ARG_STRING,                 // char *
+        ARG_NONE,                   // Argument not recorded (%n)
+        ARG_END                     // Unsupported conversion. Stop.
+    };
+
+    /**
+     * @brief   Parse the conversion specification following a '%'
+     * 
+     * @param   p       Character after the '%'
+     * @param   stars   Receives number of '*' width and precision arguments
+     * @param   type    Receives the argument type
+     * 
+     * @return  Pointer to the conversion character
+     */
+    const char *parse_spec(const char *p, int &stars, ArgType &type)
+    {
+        stars = 0;
+        p += strspn(p, "-+ #0");
+        if (*p == '*')
+        {
+            ++stars;
+            ++p;
+        }
+        while (isdigit(*p)) ++p;
+        if (*p == '.')
+        {
+            ++p;
+            if (*p == '*')
+            {
+                ++stars;
+                ++p;
+            }
+            while (isdigit(*p)) ++p;
+        }
+
+        char length = 0;
+        switch (*p)
+        {
+        case 'h':
+            if (*++p == 'h') ++p;
+            break;
+        case 'l':
+            length = 'l';
+            if (*++p == 'l')
+            {
+                length = 'q';
+                ++p;
+            }
+            break;
+        case 'j':
+        case 'z':
+        case 't':
+        case 'L':
+            length = *p++;
+            break;
+        }
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            switch (length)
+            {
+            case 'l': type = ARG_LONG; break;
+            case 'q': type = ARG_LLONG; break;
+            case 'j': type = ARG_INTMAX; break;
+            case 'z': type = ARG_SIZE; break;
+            case 't': type = ARG_PTRDIFF; break;
+            default:  type = ARG_INT; break;
+            }
+            break;
+        case 'c':
+            type = ARG_INT;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            type = length == 'L' ? ARG_LDOUBLE : ARG_DOUBLE;
+            break;
+        case 's':
+            type = length == 0 ? ARG_STRING : ARG_END;
+            break;
+        case 'p':
+            type = ARG_PTR;
+            break;
+        case 'n':
+            type = ARG_NONE;
+            break;
+        default:
+            type = ARG_END;
+            break;
+        }
+        return p;
+    }
+
+    class RecordWriter
+    {
+    private:
+        uint32_t    *rec_;          // Record
+        int         words_;         // Words written
+        bool        full_;          // Record full
+
+    public:
+        RecordWriter(uint32_t *rec) : rec_(rec), words_(1), full_(false) {}
+
+        template<typename T> bool put(const T &value)
+        {
+            int n = (sizeof(T) + 3) / 4;
+            if (full_ || words_ + n > LOG_RECORD_MAX)
+            {
+                full_ = true;
+                return false;
+            }
+            rec_[words_ + n - 1] = 0;
+            memcpy(&rec_[words_], &value, sizeof(T));
+            words_ += n;
+            return true;
+        }
+
+        bool put_string(const char *str)
+        {
+            if (!str)
+            {
+                str = "(null)";
+            }
+            uint32_t len = strnlen(str, LOG_STRING_MAX);
+            int n = 1 + (len + 3) / 4;
+            if (full_ || words_ + n > LOG_RECORD_MAX)
+            {
+                full_ = true;
+                return false;
+            }
+            rec_[words_ + n - 1] = 0;
+            rec_[words_] = len | (str[len] != 0 ? STR_TRUNCATED : 0);
+            memcpy(&rec_[words_ + 1], str, len);
+            words_ += n;
+            return true;
+        }
+
+        int finish(int level)
+        {
+            rec_[0] = words_ | (full_ ? LOG_TRUNCATED : 0) | ((uint32_t)(level & 0xff) << LOG_LEVEL_SHIFT);
+            return words_;
+        }
+    };
+
+    class RecordReader
+    {
+    private:
+        const uint32_t  *rec_;      // Record
+        int             words_;     // Words in record
+        int             pos_;       // Next word to read
+
+    public:
+        RecordReader(const uint32_t *rec) : rec_(rec), words_(rec[0] & LOG_WORDS), pos_(1) {}
+
+        template<typename T> T get()
+        {
+            T value = T();
+            int n = (sizeof(T) + 3) / 4;
+            if (pos_ + n <= words_)
+            {
+                memcpy(&value, &rec_[pos_], sizeof(T));
+            }
+            pos_ += n;
+            return value;
+        }
+
+        void get_string(char *str)
+        {
+            uint32_t len = pos_ < words_ ? rec_[pos_] : 0;
+            bool truncated = (len & STR_TRUNCATED) != 0;
+            len &= ~STR_TRUNCATED;
+            if (len > LOG_STRING_MAX || pos_ + 1 + (int)(len + 3) / 4 > words_)
+            {
+                len = 0;
+            }
+            memcpy(str, &rec_[pos_ + 1], len);
+            str[len] = 0;
+            if (truncated)
+            {
+                strcpy(str + len, "...");
+            }
+            pos_ += 1 + (len + 3) / 4;
+        }
+
+        bool more() const { return pos_ < words_; }
+    };
+}
+
+Logger::~Logger()
+{
+    delete [] ring_;
+    if (critical_section_is_initialized(&lock_))
+    {
+        critical_section_deinit(&lock_);
+    }
+}
 
 int Logger::print(const char *format, ...)
 {
     va_list ap;
     va_start(ap, format);
-    int ret = vprintf(format, ap);
+    int ret = ring_ ? record(0, format, ap) : vprintf(format, ap);
     va_end(ap);
     return ret;
 }
@@ -20,8 +260,234 @@ int Logger::print_debug(int level, const char *format, ...)
     {
         va_list ap;
         va_start(ap, format);
-        ret = vprintf(format, ap);
+        ret = ring_ ? record(level, format, ap) : vprintf(format, ap);
         va_end(ap);
     }
     return ret;
-}
\ No newline at end of file
+}
+
+int Logger::output(int, const char *text)
+{
+    return printf("%s", text);
+}
+
+void Logger::setDeferred(bool deferred)
+{
+    if (deferred && !ring_)
+    {
+        if (!critical_section_is_initialized(&lock_))
+        {
+            critical_section_init(&lock_);
+        }
+        head_ = 0;
+        tail_ = 0;
+        dropped_ = 0;
+        ring_ = new uint32_t[LOG_RING_SIZE];
+    }
+    else if (!deferred && ring_)
+    {
+        flush();
+        critical_section_enter_blocking(&lock_);
+        uint32_t *ring = ring_;
+        ring_ = nullptr;
+        critical_section_exit(&lock_);
+        delete [] ring;
+    }
+}
+
+int Logger::record(int level, const char *format, va_list ap)
+{
+    uint32_t rec[LOG_RECORD_MAX];
+    int words = encode(rec, level, format, ap);
+
+    critical_section_enter_blocking(&lock_);
+    if (ring_ && head_ - tail_ + words <= LOG_RING_SIZE)
+    {
+        for (int ii = 0; ii < words; ii++)
+        {
+            ring_[(head_ + ii) & (LOG_RING_SIZE - 1)] = rec[ii];
+        }
+        head_ += words;
+    }
+    else
+    {
+        ++dropped_;
+    }
+    critical_section_exit(&lock_);
+    return 0;
+}
+
+int Logger::flush(int max_messages)
+{
+    if (!ring_)
+    {
+        return 0;
+    }
+
+    char line[LOG_LINE_MAX];
+    uint32_t rec[LOG_RECORD_MAX];
+    int count = 0;
+
+    critical_section_enter_blocking(&lock_);
+    uint32_t dropped = dropped_;
+    dropped_ = 0;
+    critical_section_exit(&lock_);
+    if (dropped > 0)
+    {
+        snprintf(line, sizeof(line), "** %u log messages dropped **\n", dropped);
+        output(0, line);
+    }
+
+    while (max_messages == 0 || count < max_messages)
+    {
+        //  Only this method removes records so the record at the tail
+        //  cannot change once it is written
+        critical_section_enter_blocking(&lock_);
+        bool empty = tail_ == head_;
+        if (!empty)
+        {
+            int words = ring_[tail_ & (LOG_RING_SIZE - 1)] & LOG_WORDS;
+            for (int ii = 0; ii < words; ii++)
+            {
+                rec[ii] = ring_[(tail_ + ii) & (LOG_RING_SIZE - 1)];
+            }
+            tail_ += words;
+        }
+        critical_section_exit(&lock_);
+        if (empty)
+        {
+            break;
+        }
+
+        decode(rec, line, sizeof(line));
+        output((int8_t)(rec[0] >> LOG_LEVEL_SHIFT), line);
+        ++count;
+    }
+    return count;
+}
+
+int Logger::encode(uint32_t *rec, int level, const char *format, va_list ap)
+{
+    RecordWriter w(rec);
+    w.put(format);
+
+    const char *p = format;
+    while ((p = strchr(p, '%')) != nullptr)
+    {
+        if (*++p == '%')
+        {
+            ++p;
+            continue;
+        }
+        int stars;
+        ArgType type;
+        p = parse_spec(p, stars, type);
+        while (stars-- > 0)
+        {
+            w.put(va_arg(ap, int));
+        }
+        switch (type)
+        {
+        case ARG_INT:       w.put(va_arg(ap, int)); break;
+        case ARG_LONG:      w.put(va_arg(ap, long)); break;
+        case ARG_LLONG:     w.put(va_arg(ap, long long)); break;
+        case ARG_INTMAX:    w.put(va_arg(ap, intmax_t)); break;
+        case ARG_SIZE:      w.put(va_arg(ap, size_t)); break;
+        case ARG_PTRDIFF:   w.put(va_arg(ap, ptrdiff_t)); break;
+        case ARG_DOUBLE:    w.put(va_arg(ap, double)); break;
+        case ARG_LDOUBLE:   w.put(va_arg(ap, long double)); break;
+        case ARG_PTR:       w.put(va_arg(ap, void *)); break;
+        case ARG_STRING:    w.put_string(va_arg(ap, const char *)); break;
+        case ARG_NONE:      (void)va_arg(ap, void *); break;
+        case ARG_END:       return w.finish(level);
+        }
+        ++p;
+    }
+    return w.finish(level);
+}
+
+int Logger::decode(const uint32_t *rec, char *line, int size)
+{
+    RecordReader r(rec);
+    const char *format = r.get<const char *>();
+    char str[LOG_STRING_MAX + 4];
+    char spec[32];
+    int len = 0;
+
+    const char *p = format;
+    while (*p && len < size - 1)
+    {
+        //  Literal text
+        const char *pct = strchr(p, '%');
+        int n = pct ? pct - p : strlen(p);
+        if (n > size - 1 - len)
+        {
+            n = size - 1 - len;
+        }
+        memcpy(line + len, p, n);
+        len += n;
+        if (!pct)
+        {
+            break;
+        }
+        if (pct[1] == '%')
+        {
+            line[len++] = '%';
+            p = pct + 2;
+            continue;
+        }
+
+        //  Rebuild the conversion specification with the '*' values
+        int stars;
+        ArgType type;
+        const char *conv = parse_spec(pct + 1, stars, type);
+        p = conv + 1;
+        if (type == ARG_END)
+        {
+            break;
+        }
+        if (!r.more())
+        {
+            len += snprintf(line + len, size - len, "...\n");
+            break;
+        }
+        int sl = 0;
+        for (const char *s = pct; s <= conv && sl < (int)sizeof(spec) - 12; s++)
+        {
+            if (*s == '*')
+            {
+                sl += snprintf(spec + sl, sizeof(spec) - sl, "%d", r.get<int>());
+            }
+            else
+            {
+                spec[sl++] = *s;
+            }
+        }
+        spec[sl] = 0;
+
+        switch (type)
+        {
+        case ARG_INT:       n = snprintf(line + len, size - len, spec, r.get<int>()); break;
+        case ARG_LONG:      n = snprintf(line + len, size - len, spec, r.get<long>()); break;
+        case ARG_LLONG:     n = snprintf(line + len, size - len, spec, r.get<long long>()); break;
+        case ARG_INTMAX:    n = snprintf(line + len, size - len, spec, r.get<intmax_t>()); break;
+        case ARG_SIZE:      n = snprintf(line + len, size - len, spec, r.get<size_t>()); break;
+        case ARG_PTRDIFF:   n = snprintf(line + len, size - len, spec, r.get<ptrdiff_t>()); break;
+        case ARG_DOUBLE:    n = snprintf(line + len, size - len, spec, r.get<double>()); break;
+        case ARG_LDOUBLE:   n = snprintf(line + len, size - len, spec, r.get<long double>()); break;
+        case ARG_PTR:       n = snprintf(line + len, size - len, spec, r.get<void *>()); break;
+        case ARG_STRING:    r.get_string(str); n = snprintf(line + len, size - len, spec, str); break;
+        default:            n = 0; break;
+        }
+        len += n > 0 ? n : 0;
+    }
+
+    if (len >= size - 1)
+    {
+        //  Truncated message
+        len = size - 1;
+        line[len - 1] = '\n';
+    }
+    line[len] = 0;
+    return len;
+}
@@ -3,6 +3,23 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <stdarg.h>
+#include <stdint.h>
+#include <pico/sync.h>
+
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE   2048        // Words in deferred message ring (power of 2)
+#endif
+#ifndef LOG_RECORD_MAX
+#define LOG_RECORD_MAX  64          // Largest deferred message record in words
+#endif
+#ifndef LOG_STRING_MAX
+#define LOG_STRING_MAX  48          // Characters of a %s argument kept when deferred
+#endif
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX    256         // Largest formatted deferred message
+#endif
+
 /**
  * @class   Logger
  * 
@@ -11,22 +28,78 @@
  * It can be subclassed (e.g. FileLogger class) to direct logs
  * to persistent storage. This base class writes messages to
  * stdout.
+ * 
+ * In deferred mode print and print_debug do not format the message.
+ * The format string pointer and the raw argument values are copied to
+ * a RAM ring and formatted later by flush, which is normally called
+ * from the main loop:
+ * 
+ * @code
+ *    log->setDeferred(true);
+ *    ...
+ *    while (true)
+ *    {
+ *        log->flush();
+ *        ...
+ *    }
+ * @endcode
+ * 
+ * The format string must remain valid until the message is flushed,
+ * which is true of string literals. String arguments are copied (up
+ * to LOG_STRING_MAX characters, followed by "..." if longer). If the
+ * ring is full the message is dropped and the number of dropped
+ * messages is reported by the next flush.
  */
 class Logger
 {
 protected:
     int         debug_level_;           // Debug level
 
+private:
+    uint32_t    *ring_;                 // Deferred message ring (null if not deferred)
+    uint32_t    head_;                  // Words written to ring
+    uint32_t    tail_;                  // Words formatted from ring
+    uint32_t    dropped_;               // Messages dropped since last flush
+    critical_section_t  lock_;          // Ring lock
+
+    static int encode(uint32_t *rec, int level, const char *format, va_list ap);
+    static int decode(const uint32_t *rec, char *line, int size);
+
+protected:
+    /**
+     * @brief   Add a message to the deferred ring
+     * 
+     * @param   level   Debug level (0 for print)
+     * @param   format  printf format string
+     * @param   ap      Arguments
+     * 
+     * @return  0
+     */
+    int record(int level, const char *format, va_list ap);
+
+    /**
+     * @brief   Output a message formatted by flush
+     * 
+     * @param   level   Debug level (0 for print)
+     * @param   text    Formatted message
+     * 
+     * @return  Number of characters written
+     */
+    virtual int output(int level, const char *text);
+
 public:
     /**
      * @brief   Constructor
      */
-    Logger() : debug_level_(0) {}
+    Logger() : debug_level_(0), ring_(nullptr), head_(0), tail_(0), dropped_(0), lock_() {}
 
     /**
      * @brief   Destructor
      */
-    virtual ~Logger() {}
+    virtual ~Logger();
+
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
 
     /**
      * @brief   Print data usig pritf semantics
@@ -57,6 +130,31 @@ public:
      * @param   level   New debug level
      */
     void setDebug(int level) { debug_level_ = level; }
+
+    /**
+     * @brief   Enable or disable deferred formatting
+     * 
+     * @details Disabling flushes any messages in the ring
+     * 
+     * @param   deferred    true to record messages for flush
+     */
+    void setDeferred(bool deferred);
+
+    /**
+     * @brief   Test if messages are deferred
+     */
+    bool isDeferred() const { return ring_ != nullptr; }
+
+    /**
+     * @brief   Format and output deferred messages
+     * 
+     * @details Call from a low priority context such as the main loop
+     * 
+     * @param   max_messages    Maximum number of messages to output (0 for all)
+     * 
+     * @return  Number of messages output
+     */
+    int flush(int max_messages = 0);
 };
 
 #endif
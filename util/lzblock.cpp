@@ -0,0 +1,186 @@
+//                  *****  LZBlock Class Implementation  *****
+
+#include "lzblock.h"
+#include <string.h>
+
+#define MIN_MATCH       4           // Shortest match
+#define LAST_LITERALS   5           // Block always ends with literals
+#define MATCH_LIMIT     12          // Last match starts this far from the end
+#define MAX_OFFSET      65535       // Largest match offset
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static inline uint8_t *put_length(uint8_t *op, int len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+int LZBlock::compress(const char *src, int len, uint8_t *dst, int cap)
+{
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *end = base + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + cap;
+
+    if (len > MATCH_LIMIT)
+    {
+        const uint8_t *mflimit = end - MATCH_LIMIT;
+        const uint8_t *matchlimit = end - LAST_LITERALS;
+        memset(table_, 0, sizeof(uint16_t) << LZ_HASH_BITS);
+        ++ip;
+        while (ip < mflimit)
+        {
+            uint32_t h = hash(read32(ip));
+            const uint8_t *ref = base + table_[h];
+            table_[h] = ip - base;
+            if (ip - ref > MAX_OFFSET || read32(ref) != read32(ip))
+            {
+                ++ip;
+                continue;
+            }
+
+            int mlen = MIN_MATCH;
+            while (ip + mlen < matchlimit && ip[mlen] == ref[mlen])
+            {
+                ++mlen;
+            }
+
+            //  Token, literals, offset and match length
+            int lit = ip - anchor;
+            if (op + 1 + lit + lit / 255 + 1 + 2 + (mlen - MIN_MATCH) / 255 + 1 > oend)
+            {
+                return 0;
+            }
+            uint8_t *token = op++;
+            *token = (lit < 15 ? lit : 15) << 4;
+            if (lit >= 15)
+            {
+                op = put_length(op, lit - 15);
+            }
+            memcpy(op, anchor, lit);
+            op += lit;
+            int offset = ip - ref;
+            *op++ = offset & 0xff;
+            *op++ = offset >> 8;
+            int ml = mlen - MIN_MATCH;
+            *token |= ml < 15 ? ml : 15;
+            if (ml >= 15)
+            {
+                op = put_length(op, ml - 15);
+            }
+
+            ip += mlen;
+            anchor = ip;
+        }
+    }
+
+    //  Last literals
+    int lit = end - anchor;
+    if (op + 1 + lit + lit / 255 + 1 > oend)
+    {
+        return 0;
+    }
+    *op++ = (lit < 15 ? lit : 15) << 4;
+    if (lit >= 15)
+    {
+        op = put_length(op, lit - 15);
+    }
+    memcpy(op, anchor, lit);
+    op += lit;
+    return op - dst;
+}
+
+int LZBlock::decompress(const uint8_t *src, int len, char *dst, int cap)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + len;
+    uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+    uint8_t *op = out;
+    uint8_t *oend = out + cap;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+        int lit = token >> 4;
+        if (lit == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > iend - ip || lit > oend - op)
+        {
+            return -1;
+        }
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip >= iend)
+        {
+            break;
+        }
+
+        if (iend - ip < 2)
+        {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - out)
+        {
+            return -1;
+        }
+        int mlen = token & 15;
+        if (mlen == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= iend)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += MIN_MATCH;
+        if (mlen > oend - op)
+        {
+            return -1;
+        }
+
+        //  Byte copy as the match may overlap the output
+        const uint8_t *ref = op - offset;
+        while (mlen-- > 0)
+        {
+            *op++ = *ref++;
+        }
+    }
+    return op - out;
+}
@@ -0,0 +1,74 @@
+//                  *****  LZBlock Class  *****
+
+#ifndef LZBLOCK_H
+#define LZBLOCK_H
+
+#include <stdint.h>
+
+#ifndef LZ_HASH_BITS
+#define LZ_HASH_BITS    10          // Log2 of compressor hash table entries
+#endif
+
+/**
+ * @class   LZBlock
+ * 
+ * This class compresses and decompresses single blocks in the LZ4 block
+ * format, so blocks can also be decoded on a host with the lz4 library.
+ * 
+ * The compressor is a greedy single pass over the block using a small
+ * hash table of earlier positions (2^LZ_HASH_BITS entries). It is fast
+ * and compresses repetitive text such as log messages well. Blocks must
+ * be smaller than 64K bytes.
+ */
+class LZBlock
+{
+private:
+    uint16_t    *table_;                // Hash table of positions
+
+public:
+    /**
+     * @brief   Constructor
+     */
+    LZBlock() : table_(new uint16_t[1 << LZ_HASH_BITS]) {}
+
+    /**
+     * @brief   Destructor
+     */
+    ~LZBlock() { delete [] table_; }
+
+    LZBlock(const LZBlock &) = delete;
+    LZBlock &operator=(const LZBlock &) = delete;
+
+    /**
+     * @brief   Largest compressed size of a block
+     * 
+     * @param   len     Uncompressed size
+     */
+    static int bound(int len) { return len + len / 255 + 16; }
+
+    /**
+     * @brief   Compress a block
+     * 
+     * @param   src     Data to compress
+     * @param   len     Length of data (less than 64K)
+     * @param   dst     Buffer to receive compressed data
+     * @param   cap     Size of buffer
+     * 
+     * @return  Compressed length or zero if it would not fit in the buffer
+     */
+    int compress(const char *src, int len, uint8_t *dst, int cap);
+
+    /**
+     * @brief   Decompress a block
+     * 
+     * @param   src     Compressed data
+     * @param   len     Length of compressed data
+     * @param   dst     Buffer to receive data
+     * @param   cap     Size of buffer
+     * 
+     * @return  Decompressed length or -1 if the data is not valid
+     */
+    static int decompress(const uint8_t *src, int len, char *dst, int cap);
+};
+
+#endif
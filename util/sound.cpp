@@ -8,6 +8,7 @@
 #include <pico/time.h>
 #include <stdio.h>
 #include <math.h>
+#include "trace.h"
 
 Sound *Sound::singleton_ = nullptr;
 
@@ -164,6 +165,7 @@ void Sound::handler()
 void Sound::next_pulse()
 {
     pwm_clear_irq(slice_num_);
+    TRACE_MARK(SOUND_PULSE, idx_);
     if (count_ == 0)
     {
         //  Playing Sound sound.  Set next sample level.
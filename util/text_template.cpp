@@ -0,0 +1,282 @@
+//                  *****  TextTemplate Implementation  *****
+
+#include "text_template.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static const char content_length[] = "\r\nContent-Length:";
+
+void TextTemplate::clear()
+{
+    delete [] copy_;
+    copy_ = nullptr;
+    text_ = nullptr;
+    segments_.clear();
+    names_.clear();
+    body_ = -1;
+}
+
+void TextTemplate::literal(uint32_t offset, uint32_t length)
+{
+    if (length > 0)
+    {
+        segments_.push_back({offset, length, LITERAL});
+    }
+}
+
+void TextTemplate::placeholder(const char *name, uint32_t len)
+{
+    int slot = 0;
+    while (slot < (int)names_.size() && names_[slot].compare(0, std::string::npos, name, len) != 0)
+    {
+        ++slot;
+    }
+    if (slot == (int)names_.size())
+    {
+        names_.emplace_back(name, len);
+    }
+    segments_.push_back({0, 0, (int16_t)slot});
+}
+
+void TextTemplate::compile(const char *text, uint32_t len, bool stat)
+{
+    compile(text, len, nullptr, 0, stat);
+}
+
+void TextTemplate::compile(const char *text, uint32_t len, const char *const *names, int count, bool stat)
+{
+    clear();
+    if (stat)
+    {
+        text_ = text;
+    }
+    else
+    {
+        copy_ = new char[len];
+        memcpy(copy_, text, len);
+        text_ = copy_;
+    }
+    scan(len, names, count);
+}
+
+void TextTemplate::scan(uint32_t len, const char *const *names, int count)
+{
+    //  Locate the header end and Content-Length value of an HTTP response
+    uint32_t header = len + 1;
+    uint32_t number = len + 1;
+    uint32_t digits = 0;
+    if (len > 5 && strncmp(text_, "HTTP/", 5) == 0)
+    {
+        const char *end = std::search(text_, text_ + len, "\r\n\r\n", "\r\n\r\n" + 4);
+        if (end < text_ + len)
+        {
+            header = end + 4 - text_;
+            const char *cl = std::search(text_, end, content_length, content_length + sizeof(content_length) - 1);
+            if (cl < end)
+            {
+                number = cl + sizeof(content_length) - 1 - text_;
+                while (text_[number] == ' ')
+                {
+                    ++number;
+                }
+                while (text_[number + digits] >= '0' && text_[number + digits] <= '9')
+                {
+                    ++digits;
+                }
+            }
+        }
+    }
+
+    //  Placeholders are tried longest first, after a check of their first character
+    std::vector<int> order(count);
+    bool first[256] = { false };
+    for (int ii = 0; ii < count; ++ii)
+    {
+        order[ii] = ii;
+        first[(uint8_t)names[ii][0]] = true;
+    }
+    std::sort(order.begin(), order.end(), [names](int a, int b) { return strlen(names[a]) > strlen(names[b]); });
+
+    uint32_t start = 0;             // Start of current literal
+    uint32_t pos = 0;
+    while (pos < len)
+    {
+        if (pos == header)
+        {
+            literal(start, pos - start);
+            start = pos;
+            body_ = segments_.size();
+        }
+        if (pos == number && digits > 0)
+        {
+            literal(start, pos - start);
+            segments_.push_back({0, 0, LENGTH});
+            pos += digits;
+            start = pos;
+            continue;
+        }
+        const char *cp = text_ + pos;
+        if (names == nullptr)
+        {
+            if (*cp == '%')
+            {
+                uint32_t end = pos + 1;
+                while (end < len && ((text_[end] >= 'A' && text_[end] <= 'Z') || (text_[end] >= '0' && text_[end] <= '9') || text_[end] == '_'))
+                {
+                    ++end;
+                }
+                if (end > pos + 1 && end < len && text_[end] == '%')
+                {
+                    literal(start, pos - start);
+                    placeholder(cp + 1, end - pos - 1);
+                    pos = end + 1;
+                    start = pos;
+                    continue;
+                }
+            }
+        }
+        else if (first[(uint8_t)*cp])
+        {
+            bool found = false;
+            for (int ii : order)
+            {
+                uint32_t nl = strlen(names[ii]);
+                if (nl > 0 && nl <= len - pos && memcmp(cp, names[ii], nl) == 0)
+                {
+                    literal(start, pos - start);
+                    placeholder(names[ii], nl);
+                    pos += nl;
+                    start = pos;
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+            {
+                continue;
+            }
+        }
+        ++pos;
+    }
+    literal(start, len - start);
+    if (header == len)
+    {
+        body_ = segments_.size();
+    }
+    if (body_ < 0 && digits > 0)
+    {
+        //  A header that was split by a placeholder is left unchanged
+        for (Segment &seg : segments_)
+        {
+            if (seg.slot == LENGTH)
+            {
+                seg = {number, digits, LITERAL};
+            }
+        }
+    }
+}
+
+int TextTemplate::slot(const char *name) const
+{
+    for (int slot = 0; slot < (int)names_.size(); ++slot)
+    {
+        if (names_[slot] == name)
+        {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+uint32_t TextTemplate::resolve(Provider provider, void *udata, std::vector<std::string_view> &values, char *length) const
+{
+    values.resize(names_.size());
+    for (int slot = 0; slot < (int)names_.size(); ++slot)
+    {
+        values[slot] = provider(slot, names_[slot].c_str(), udata);
+    }
+    uint32_t header = 0;
+    uint32_t body = 0;
+    for (int ii = 0; ii < (int)segments_.size(); ++ii)
+    {
+        const Segment &seg = segments_[ii];
+        uint32_t size = seg.slot == LITERAL ? seg.length : seg.slot >= 0 ? values[seg.slot].size() : 0;
+        if (body_ >= 0 && ii >= body_)
+        {
+            body += size;
+        }
+        else
+        {
+            header += size;
+        }
+    }
+    length[0] = '\0';
+    if (body_ >= 0)
+    {
+        header += snprintf(length, 12, "%lu", (unsigned long)body);
+    }
+    return header + body;
+}
+
+char *TextTemplate::render(Provider provider, void *udata, uint32_t &len) const
+{
+    std::vector<std::string_view> values;
+    char length[12];
+    len = resolve(provider, udata, values, length);
+    char *buffer = new char[len];
+    char *out = buffer;
+    for (const Segment &seg : segments_)
+    {
+        if (seg.slot == LITERAL)
+        {
+            memcpy(out, text_ + seg.offset, seg.length);
+            out += seg.length;
+        }
+        else if (seg.slot == LENGTH)
+        {
+            uint32_t nn = strlen(length);
+            memcpy(out, length, nn);
+            out += nn;
+        }
+        else
+        {
+            memcpy(out, values[seg.slot].data(), values[seg.slot].size());
+            out += values[seg.slot].size();
+        }
+    }
+    return buffer;
+}
+
+uint32_t TextTemplate::render(Provider provider, void *pdata, Sink sink, void *sdata) const
+{
+    std::vector<std::string_view> values;
+    char length[12];
+    uint32_t len = resolve(provider, pdata, values, length);
+    for (const Segment &seg : segments_)
+    {
+        bool ok;
+        if (seg.slot == LITERAL)
+        {
+            ok = sink(text_ + seg.offset, seg.length, true, sdata);
+        }
+        else if (seg.slot == LENGTH)
+        {
+            ok = sink(length, strlen(length), false, sdata);
+        }
+        else
+        {
+            ok = values[seg.slot].empty() || sink(values[seg.slot].data(), values[seg.slot].size(), false, sdata);
+        }
+        if (!ok)
+        {
+            return 0;
+        }
+    }
+    return len;
+}
+
+std::string_view TextTemplate::array_provider(int slot, const char *, void *udata)
+{
+    return static_cast<const std::string *>(udata)[slot];
+}
@@ -0,0 +1,174 @@
+//                  *****  TextTemplate Class  *****
+
+#ifndef TEXT_TEMPLATE_H
+#define TEXT_TEMPLATE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @class   TextTemplate
+ * 
+ * This class fills placeholders in a page with values in a single pass.
+ * It replaces repeated calls of TXT::substitute, each of which searches
+ * the page from the start and moves the rest of the page.
+ * 
+ * The text is scanned once by compile into a list of literal segments
+ * and slots. By default a placeholder is a name of upper case letters,
+ * digits and underscores between '%' characters, for example %TEMP%.
+ * Alternatively a list of placeholder strings may be given. Each
+ * distinct placeholder is a slot, numbered in order of first use.
+ * 
+ * render asks a provider for the value of each slot once and either
+ * returns the result in a buffer of exactly the required size or passes
+ * the segments and values in order to a sink, for example to send them
+ * without assembling the page.
+ * 
+ * If the text is an HTTP response (as stored by WEB_FILES) the value of
+ * the Content-Length header is replaced by the rendered body size.
+ */
+class TextTemplate
+{
+public:
+    /**
+     * @brief   Function providing the value of a slot
+     * 
+     * @param   slot    Slot number
+     * @param   name    Placeholder (without '%' delimiters)
+     * @param   udata   User data given to render
+     * 
+     * @return  Value, which must remain valid until render returns
+     */
+    typedef std::string_view (*Provider)(int slot, const char *name, void *udata);
+
+    /**
+     * @brief   Function receiving rendered text
+     * 
+     * @param   data    Text
+     * @param   len     Length of text
+     * @param   literal true if data is part of the template text
+     * @param   udata   User data given to render
+     * 
+     * @return  false to stop rendering
+     */
+    typedef bool (*Sink)(const char *data, uint32_t len, bool literal, void *udata);
+
+private:
+    static const int16_t LITERAL = -1;      // Segment is template text
+    static const int16_t LENGTH = -2;       // Segment is Content-Length value
+
+    struct Segment
+    {
+        uint32_t    offset;                 // Offset of literal in text
+        uint32_t    length;                 // Length of literal
+        int16_t     slot;                   // Slot number, LITERAL or LENGTH
+    };
+
+    const char              *text_;         // Template text
+    char                    *copy_;         // Copy of text if not static
+    std::vector<Segment>    segments_;      // Literals and slots in order
+    std::vector<std::string> names_;        // Placeholder of each slot
+    int                     body_;          // First segment of HTTP body (-1 if not HTTP)
+
+    void clear();
+    void literal(uint32_t offset, uint32_t length);
+    void placeholder(const char *name, uint32_t len);
+    void scan(uint32_t len, const char *const *names, int count);
+    uint32_t resolve(Provider provider, void *udata, std::vector<std::string_view> &values, char *length) const;
+
+public:
+    /**
+     * @brief   Construct an empty template
+     */
+    TextTemplate() : text_(nullptr), copy_(nullptr), body_(-1) {}
+
+    /**
+     * @brief   Destructor
+     */
+    ~TextTemplate() { delete [] copy_; }
+
+    TextTemplate(const TextTemplate &) = delete;
+    TextTemplate &operator=(const TextTemplate &) = delete;
+
+    /**
+     * @brief   Scan text for %NAME% placeholders
+     * 
+     * @param   text    Template text
+     * @param   len     Length of text
+     * @param   stat    true if the text remains valid for the life of the
+     *                  template (it is copied otherwise)
+     */
+    void compile(const char *text, uint32_t len, bool stat = true);
+
+    /**
+     * @brief   Scan text for given placeholders
+     * 
+     * @param   text    Template text
+     * @param   len     Length of text
+     * @param   names   Placeholder strings. The longest is used where more
+     *                  than one matches.
+     * @param   count   Number of placeholders
+     * @param   stat    true if the text remains valid for the life of the
+     *                  template (it is copied otherwise)
+     */
+    void compile(const char *text, uint32_t len, const char *const *names, int count, bool stat = true);
+
+    /**
+     * @brief   Test if no text has been compiled
+     */
+    bool empty() const { return segments_.empty(); }
+
+    /**
+     * @brief   Number of slots
+     */
+    int slots() const { return names_.size(); }
+
+    /**
+     * @brief   Find the slot of a placeholder
+     * 
+     * @param   name    Placeholder (without '%' delimiters)
+     * 
+     * @return  Slot number or -1 if not used in the template
+     */
+    int slot(const char *name) const;
+
+    /**
+     * @brief   Placeholder of a slot
+     */
+    const char *name(int slot) const { return names_[slot].c_str(); }
+
+    /**
+     * @brief   Render into a buffer
+     * 
+     * @param   provider    Function providing slot values
+     * @param   udata       User data for provider
+     * @param   len         Receives the length of the result
+     * 
+     * @return  Buffer allocated with new[] of exactly len bytes, which the
+     *          caller must delete[] (or pass to WEB::send_data as PREALL)
+     */
+    char *render(Provider provider, void *udata, uint32_t &len) const;
+
+    /**
+     * @brief   Render to a sink
+     * 
+     * @param   provider    Function providing slot values
+     * @param   pdata       User data for provider
+     * @param   sink        Function receiving the text in order
+     * @param   sdata       User data for sink
+     * 
+     * @return  Length of result, or zero if stopped by the sink
+     */
+    uint32_t render(Provider provider, void *pdata, Sink sink, void *sdata) const;
+
+    /**
+     * @brief   Provider returning values from an array indexed by slot
+     * 
+     * @details The user data is a pointer to the first std::string
+     */
+    static std::string_view array_provider(int slot, const char *name, void *udata);
+};
+
+#endif
@@ -0,0 +1,89 @@
+//                  *****  Trace Implementation  *****
+
+#include "trace.h"
+#include <stdio.h>
+#include <pico/platform.h>
+#include <pico/sync.h>
+#include <hardware/timer.h>
+
+static_assert((TRACE_SIZE & (TRACE_SIZE - 1)) == 0, "TRACE_SIZE must be a power of 2");
+static_assert(static_cast<int>(TRACE_COUNT) <= static_cast<int>(Trace::ID_MASK), "Too many trace points");
+
+Trace::Event        Trace::ring_[TRACE_CORES][TRACE_SIZE];
+uint32_t            Trace::head_[TRACE_CORES];
+uint32_t            Trace::mask_ = 0;
+volatile bool       Trace::paused_ = false;
+
+const char *Trace::names_[TRACE_COUNT] =
+{
+#define TRACE_NAME(name) #name,
+    TRACE_POINTS(TRACE_NAME)
+    TRACE_APP_POINTS(TRACE_NAME)
+#undef TRACE_NAME
+};
+
+void Trace::record(uint16_t code, uint32_t arg)
+{
+    uint32_t time = time_us_32();
+    unsigned int core = get_core_num();
+
+    //  Only interrupts on this core can write to this ring
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t idx = head_[core]++;
+    restore_interrupts(save);
+
+    Event &ev = ring_[core][idx & (TRACE_SIZE - 1)];
+    ev.time = time;
+    ev.code = code;
+    ev.arg = arg;
+}
+
+void Trace::clear()
+{
+    for (int core = 0; core < TRACE_CORES; core++)
+    {
+        head_[core] = 0;
+    }
+}
+
+void Trace::emit(std::string *out, const char *line)
+{
+    if (out)
+    {
+        *out += line;
+    }
+    else
+    {
+        fputs(line, stdout);
+    }
+}
+
+void Trace::write(std::string *out)
+{
+    char line[64];
+    paused_ = true;
+    snprintf(line, sizeof(line), "TRACE 1 %u %d\n", time_us_32(), TRACE_CORES);
+    emit(out, line);
+    for (int id = 0; id < TRACE_COUNT; id++)
+    {
+        snprintf(line, sizeof(line), "N %d %s\n", id, names_[id]);
+        emit(out, line);
+    }
+    for (int core = 0; core < TRACE_CORES; core++)
+    {
+        uint32_t head = head_[core];
+        uint32_t idx = head > TRACE_SIZE ? head - TRACE_SIZE : 0;
+        if (out)
+        {
+            out->reserve(out->size() + (head - idx) * 24);
+        }
+        for ( ; idx < head; idx++)
+        {
+            const Event &ev = ring_[core][idx & (TRACE_SIZE - 1)];
+            snprintf(line, sizeof(line), "E %d %u %u %u\n", core, ev.time, ev.code, ev.arg);
+            emit(out, line);
+        }
+    }
+    emit(out, "END\n");
+    paused_ = false;
+}
@@ -0,0 +1,160 @@
+//                  *****  Trace Class  *****
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <stdint.h>
+#include "dbgflag.h"
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE  256         // Events in each core's ring (power of 2)
+#endif
+#ifndef TRACE_CORES
+#define TRACE_CORES 2           // Number of cores
+#endif
+
+/**
+ * Library trace points. Each point can be recorded as the beginning or end
+ * of an interval or as a single instant.
+ * 
+ * An application adds its own points by providing a trace_points.h file in
+ * its include path that defines TRACE_APP_POINTS in the same form:
+ * 
+ * @code
+ *    #define TRACE_APP_POINTS(X) \
+ *        X(SENSOR_READ)          \
+ *        X(DISPLAY_UPDATE)
+ * @endcode
+ */
+#define TRACE_POINTS(X)     \
+    X(WEB_RECV)             \
+    X(WEB_WRITE)            \
+    X(WEB_RQST)             \
+    X(IR_EDGE)              \
+    X(SOUND_PULSE)
+
+#if defined(__has_include)
+#if __has_include("trace_points.h")
+#include "trace_points.h"
+#endif
+#endif
+#ifndef TRACE_APP_POINTS
+#define TRACE_APP_POINTS(X)
+#endif
+
+enum TraceId : uint16_t
+{
+#define TRACE_ID(name) TRACE_##name,
+    TRACE_POINTS(TRACE_ID)
+    TRACE_APP_POINTS(TRACE_ID)
+#undef TRACE_ID
+    TRACE_COUNT
+};
+
+/**
+ * @class   Trace
+ * 
+ * This static class records timestamped events in a RAM ring buffer for
+ * each core. Recording an event takes well under a microsecond and does
+ * not print, so it can be used in interrupt handlers and other timing
+ * sensitive code. The ring keeps the most recent TRACE_SIZE events.
+ * 
+ * Tracing is active while any of the DBGFlag bits given to enable() are
+ * set. Events are recorded with the TRACE_BEGIN, TRACE_END and TRACE_MARK
+ * macros, which compile to nothing if TRACE_DISABLE is defined:
+ * 
+ * @code
+ *    Trace::enable(0x100);        // Trace while DBGFlag 0x100 is set
+ *    ...
+ *    TRACE_BEGIN(WEB_RECV, p->tot_len);
+ *    ...
+ *    TRACE_END(WEB_RECV, 0);
+ * @endcode
+ * 
+ * The rings are written with print() (USB stdio) or dump() (for example
+ * as an HTTP response) and converted to Chrome trace / Perfetto JSON on
+ * the host with trace_to_chrome.py.
+ */
+class Trace
+{
+public:
+    /**
+     * @brief   Event kind stored in the top bits of the event code
+     */
+    enum Kind : uint16_t
+    {
+        MARK    = 0x0000,           // Instant event
+        BEGIN   = 0x4000,           // Start of interval
+        END     = 0x8000,           // End of interval
+        ID_MASK = 0x3fff            // Trace id bits
+    };
+
+private:
+    struct Event
+    {
+        uint32_t    time;           // time_us_32 timestamp
+        uint16_t    code;           // Trace id and kind
+        uint16_t    reserved;       // Padding
+        uint32_t    arg;            // Event argument
+    };
+
+    static Event        ring_[TRACE_CORES][TRACE_SIZE]; // Event rings
+    static uint32_t     head_[TRACE_CORES];             // Events written to each ring
+    static uint32_t     mask_;                          // DBGFlag bits enabling trace
+    static volatile bool paused_;                       // Paused while dumping
+    static const char   *names_[TRACE_COUNT];           // Trace point names
+
+    static void emit(std::string *out, const char *line);
+    static void write(std::string *out);
+
+public:
+    /**
+     * @brief   Set the DBGFlag bits that enable tracing
+     * 
+     * @param   dbg_mask    DBGFlag bits (0 disables tracing)
+     */
+    static void enable(uint32_t dbg_mask) { mask_ = dbg_mask; }
+
+    /**
+     * @brief   Test if tracing is active
+     */
+    static bool active() { return !paused_ && DBGFlag::isSet(mask_); }
+
+    /**
+     * @brief   Record an event on the current core
+     * 
+     * @param   code    Trace id or'ed with event kind
+     * @param   arg     Event argument
+     */
+    static void record(uint16_t code, uint32_t arg);
+
+    /**
+     * @brief   Discard all recorded events
+     */
+    static void clear();
+
+    /**
+     * @brief   Print recorded events to stdout
+     */
+    static void print() { write(nullptr); }
+
+    /**
+     * @brief   Append recorded events to a string
+     * 
+     * @param   out     String to receive events
+     */
+    static void dump(std::string &out) { write(&out); }
+};
+
+#ifndef TRACE_DISABLE
+#define TRACE_BEGIN(name, arg)  do { if (Trace::active()) Trace::record(TRACE_##name | Trace::BEGIN, (arg)); } while (0)
+#define TRACE_END(name, arg)    do { if (Trace::active()) Trace::record(TRACE_##name | Trace::END, (arg)); } while (0)
+#define TRACE_MARK(name, arg)   do { if (Trace::active()) Trace::record(TRACE_##name | Trace::MARK, (arg)); } while (0)
+#else
+#define TRACE_BEGIN(name, arg)  do {} while (0)
+#define TRACE_END(name, arg)    do {} while (0)
+#define TRACE_MARK(name, arg)   do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,63 @@
+#      *****  trace_to_chrome  *****
+#
+#   Convert the output of Trace::print() or Trace::dump() to the Chrome trace
+#   event JSON format, which can be opened in chrome://tracing or
+#   https://ui.perfetto.dev
+#
+#   Lines before the TRACE header (other USB stdio output) are ignored.
+
+import sys
+import argparse
+import json
+
+BEGIN = 0x4000
+END = 0x8000
+ID_MASK = 0x3fff
+
+parser = argparse.ArgumentParser(
+                    prog='trace_to_chrome',
+                    description='Convert a pico trace dump to Chrome trace JSON',
+                    epilog='')
+parser.add_argument("-o", nargs='?', type=argparse.FileType('w'), default=sys.stdout)
+parser.add_argument("dump", nargs='?', type=argparse.FileType('r'), default=sys.stdin)
+p = parser.parse_args(sys.argv[1:])
+
+names = {}
+events = []
+last = {}           # Last raw timestamp for each core
+offset = {}         # Added to timestamps after time_us_32 wraps
+started = False
+for line in p.dump:
+    fields = line.split()
+    if not started:
+        started = len(fields) > 0 and fields[0] == 'TRACE'
+        continue
+    if len(fields) == 0:
+        continue
+    if fields[0] == 'END':
+        break
+    if fields[0] == 'N' and len(fields) >= 3:
+        names[int(fields[1])] = fields[2]
+    elif fields[0] == 'E' and len(fields) >= 5:
+        core, time, code, arg = (int(f) for f in fields[1:5])
+        if core in last and time < last[core] and last[core] - time > 0x80000000:
+            offset[core] = offset.get(core, 0) + 0x100000000
+        last[core] = time
+        ev = {'name': names.get(code & ID_MASK, 'id%d' % (code & ID_MASK)),
+              'ph': 'B' if code & BEGIN else 'E' if code & END else 'i',
+              'ts': time + offset.get(core, 0),
+              'pid': 0,
+              'tid': core,
+              'args': {'arg': arg}}
+        if ev['ph'] == 'i':
+            ev['s'] = 't'
+        events.append(ev)
+
+if not started:
+    sys.exit('No TRACE header found')
+
+for core in sorted(last):
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': core, 'args': {'name': 'core %d' % core}})
+events.sort(key=lambda ev: ev.get('ts', -1))
+json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, p.o, indent=1)
+p.o.write('\n')
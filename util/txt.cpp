@@ -2,41 +2,87 @@
 #include <string.h>
 #include <stdio.h>
 
-TXT::TXT(const char *data, uint32_t datalen, uint32_t size)
+TXT::TXT(uint32_t size, uint32_t headroom)
+ : base_(new char[headroom + size]), buffer_(base_ + headroom), bufsiz_(headroom + size), endptr_(0), owned_(true)
+{
+    if (size > 0)
+    {
+        *buffer_ = 0;
+    }
+}
+
+TXT::TXT(const Arena &arena, uint32_t headroom)
+ : base_(arena.buffer), buffer_(arena.buffer), bufsiz_(arena.size), endptr_(0), owned_(false)
+{
+    if (headroom < bufsiz_)
+    {
+        buffer_ += headroom;
+        *buffer_ = 0;
+    }
+    else if (bufsiz_ > 0)
+    {
+        *buffer_ = 0;
+    }
+}
+
+TXT::TXT(const char *data, uint32_t datalen, uint32_t size, uint32_t headroom)
 {
     if (size <= datalen)
     {
         size = (datalen + 256) / 256 * 256;
     }
-    bufsiz_ = size;
-    buffer_ = new char[bufsiz_];
+    bufsiz_ = headroom + size;
+    base_ = new char[bufsiz_];
+    buffer_ = base_ + headroom;
     endptr_ = datalen;
-    strncpy(buffer_, data, datalen);
+    owned_ = true;
+    memcpy(buffer_, data, datalen);
     buffer_[endptr_] = 0;
 }
 
-char *TXT::expand(uint32_t offset, uint32_t amount)
+void TXT::reserve(uint32_t size)
 {
-    if (endptr_ + amount >= bufsiz_)
+    uint32_t head = buffer_ - base_;
+    if (head + size > bufsiz_)
     {
-        uint32_t newsz = endptr_ + amount + 2048;
-        newsz /= 2048;
-        newsz *= 2048;
-        printf("TXT buffer expanded from %d to %d for expansion by %d from %d to %d\n", bufsiz_, newsz, amount, endptr_, endptr_ + amount);
+        //  Grow by half again, so repeated appends take amortized constant time
+        uint32_t newsz = bufsiz_ < 64 ? 64 : bufsiz_;
+        while (newsz < head + size)
+        {
+            newsz += newsz / 2;
+        }
         char *newbuf = new char[newsz];
-        memcpy(newbuf, buffer_, endptr_ + 1);
-        delete [] buffer_;
-        buffer_ = newbuf;
+        if (bufsiz_ > head)
+        {
+            memcpy(newbuf + head, buffer_, endptr_ + 1);
+        }
+        else
+        {
+            newbuf[head] = 0;
+        }
+        if (owned_)
+        {
+            delete [] base_;
+        }
+        base_ = newbuf;
+        buffer_ = newbuf + head;
         bufsiz_ = newsz;
+        owned_ = true;
     }
+}
 
-    char *src = buffer_ + endptr_;
-    char *dst = buffer_ + endptr_ + amount;
-    uint32_t nn = endptr_ - offset;
-    for (uint32_t ii = 0; ii < nn; ii++)
+char *TXT::expand(uint32_t offset, uint32_t amount)
+{
+    if (amount > 0 && amount <= headroom() && offset < endptr_ - offset)
     {
-        *--dst = *--src;
+        //  Move the shorter part before the offset into the headroom
+        buffer_ -= amount;
+        memmove(buffer_, buffer_ + amount, offset);
+        endptr_ += amount;
+        return buffer_ + offset;
     }
+    reserve(endptr_ + amount + 1);
+    memmove(buffer_ + offset + amount, buffer_ + offset, endptr_ - offset);
     endptr_ += amount;
     buffer_[endptr_] = 0;
     return buffer_ + offset;
@@ -44,13 +90,7 @@ char *TXT::expand(uint32_t offset, uint32_t amount)
 
 char *TXT::contract(uint32_t offset, uint32_t amount)
 {
-    char *src = buffer_ + offset + amount; 
-    char *dst = buffer_ + offset;
-    uint32_t nn = endptr_ - offset - amount;
-    for (uint32_t ii = 0; ii < nn; ii++)
-    {
-        *dst++ = *src++;
-    }
+    memmove(buffer_ + offset, buffer_ + offset + amount, endptr_ - offset - amount);
     endptr_ -= amount;
     buffer_[endptr_] = 0;
     return buffer_ + offset;
@@ -58,50 +98,58 @@ char *TXT::contract(uint32_t offset, uint32_t amount)
 
 TXT &TXT::operator =(const char *assign)
 {
-    size_t la = strlen(assign);
     endptr_ = 0;
-    expand(0, la);
-    strncpy(buffer_, assign, la);
-    buffer_[endptr_] = 0;
-    return *this;
+    return append(assign, strlen(assign));
 }
 
 TXT &TXT::operator =(const std::string &assign)
 {
-    size_t la = assign.length();
     endptr_ = 0;
-    expand(0, la);
-    strncpy(buffer_, assign.c_str(), la);
-    buffer_[endptr_] = 0;
-    return *this;
+    return append(assign.data(), assign.length());
 }
 
 TXT &TXT::operator +=(const char *append)
 {
-    size_t la = strlen(append);
-    char *dst = expand(endptr_, la);
-    strncpy(dst, append, la);
-    buffer_[endptr_] = 0;
-    return *this;
+    return this->append(append, strlen(append));
 }
 
 TXT &TXT::operator +=(const std::string &append)
 {
-    size_t la = append.length();
-    char *dst = expand(endptr_, la);
-    memcpy(dst, append.c_str(), la);
-    buffer_[endptr_] = 0;
+    return this->append(append.data(), append.length());
+}
+
+TXT &TXT::append(const char *data, uint32_t len)
+{
+    char *dst = expand(endptr_, len);
+    memcpy(dst, data, len);
     return *this;
 }
 
-uint32_t TXT::find(const char *str) const
+uint32_t TXT::find(const char *str, uint32_t len, uint32_t from) const
 {
-    char *s = strstr(buffer_, str);
-    if (s)
+    //  memchr skips to each candidate first character, then the rest is compared
+    if (len == 0)
+    {
+        return from <= endptr_ ? from : (uint32_t)std::string::npos;
+    }
+    if (from >= endptr_ || len > endptr_ - from)
     {
-        return s - buffer_;
+        return (uint32_t)std::string::npos;
     }
-    return std::string::npos;
+    const char *last = buffer_ + endptr_ - len;
+    const char *s = buffer_ + from;
+    while ((s = (const char *)memchr(s, str[0], last - s + 1)) != nullptr)
+    {
+        if (memcmp(s + 1, str + 1, len - 1) == 0)
+        {
+            return s - buffer_;
+        }
+        if (++s > last)
+        {
+            break;
+        }
+    }
+    return (uint32_t)std::string::npos;
 }
 
 uint32_t TXT::insert(uint32_t offset, const char *str, size_t len)
@@ -110,9 +158,8 @@ uint32_t TXT::insert(uint32_t offset, const char *str, size_t len)
     {
         len = strlen(str);
     }
-    expand(offset, len);
-    memcpy(buffer_ + offset, str, len);
-    buffer_[endptr_] = 0;
+    char *dst = expand(offset, len);
+    memcpy(dst, str, len);
     return offset + len;
 }
 
@@ -127,21 +174,16 @@ void TXT::replace(uint32_t offset, uint32_t size, const char *replacement)
     {
         contract(offset + lr, size -  lr);
     }
-    for (uint32_t ii = 0; ii < lr; ii++)
-    {
-        buffer_[offset + ii] = replacement[ii];
-    }
+    memcpy(buffer_ + offset, replacement, lr);
 }
 
 bool TXT::substitute(const char *placeholder, const char *replacement)
 {
     bool ret = false;
-    char *found = strstr(buffer_, placeholder);
-    if (found)
+    uint32_t offset = find(placeholder);
+    if (offset != (uint32_t)std::string::npos)
     {
-        uint32_t offset = found - buffer_;
-        uint32_t size = strlen(placeholder);
-        replace(offset, size, replacement);
+        replace(offset, strlen(placeholder), replacement);
         ret = true;
     }
     return ret;
@@ -181,39 +223,65 @@ bool TXT::substitute(std::string &target, const std::string &placeholder, int va
     return substitute(target, placeholder, std::to_string(value));
 }
 
+bool TXT::Tokenizer::next(std::string_view &token)
+{
+    if (done_)
+    {
+        return false;
+    }
+    std::size_t end = pos_;
+    while (end < src_.size() && !seps_.contains(src_[end]))
+    {
+        ++end;
+    }
+    token = src_.substr(pos_, end - pos_);
+    if (end < src_.size())
+    {
+        pos_ = end + 1;
+    }
+    else
+    {
+        done_ = true;
+    }
+    return true;
+}
+
 void TXT::split(const std::string &src, const std::string &separators, std::vector<std::string> &tokens)
 {
+    Separators seps(separators.c_str());
+    Tokenizer tok(src, seps);
+    std::string_view token;
     tokens.clear();
-    std::size_t i1 = 0;
-    std::size_t i2 = src.find_first_of(separators, i1);
-    if (i2 == std::string::npos)
+    while (tok.next(token))
     {
-        tokens.push_back(src);
+        tokens.emplace_back(token);
     }
-    else
+}
+
+int TXT::split(std::string_view src, const Separators &separators, std::string_view *tokens, int max)
+{
+    Tokenizer tok(src, separators);
+    int count = 0;
+    while (count < max - 1 && tok.next(tokens[count]))
     {
-        tokens.push_back(src.substr(i1, i2 - i1));
-        do
-        {
-            i1 = i2 + 1;
-            if (i1 < src.length())
-            {
-                i2 = src.find_first_of(separators, i1);
-                tokens.push_back(src.substr(i1, i2 - i1));
-            }
-            else
-            {
-                i2 = std::string::npos;
-                tokens.push_back("");
-            }
-        }
-        while (i2 != std::string::npos);
+        ++count;
     }
+    if (count == max - 1 && !tok.done())
+    {
+        tokens[count++] = tok.rest();
+    }
+    return count;
 }
 
 std::string TXT::join(const std::vector<std::string> &tokens, const std::string &separator)
 {
     std::string ret;
+    std::size_t size = 0;
+    for (auto it = tokens.cbegin(); it != tokens.cend(); ++it)
+    {
+        size += it->length() + separator.length();
+    }
+    ret.reserve(size);
     for (auto it = tokens.cbegin(); it != tokens.cend(); ++it)
     {
         if (!ret.empty()) ret += separator;
@@ -222,6 +290,21 @@ std::string TXT::join(const std::vector<std::string> &tokens, const std::string
     return ret;
 }
 
+void TXT::join(TXT &out, const std::string_view *tokens, int count, std::string_view separator)
+{
+    uint32_t size = out.datasize();
+    for (int ii = 0; ii < count; ++ii)
+    {
+        size += tokens[ii].size() + separator.size();
+    }
+    out.reserve(size + 1);
+    for (int ii = 0; ii < count; ++ii)
+    {
+        if (ii > 0) out.append(separator.data(), separator.size());
+        out.append(tokens[ii].data(), tokens[ii].size());
+    }
+}
+
 void TXT::trim_back(std::string &str)
 {
     std::size_t ii = str.find_last_not_of(" \t\r\n");
@@ -2,8 +2,10 @@
 #define TXT_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdint.h>
+#include <string.h>
 
 /**
  * @class   TXT
@@ -11,15 +13,118 @@
  * This class provides some functionality similar to the std::string class but
  * has different memory management useful to the WEB class.
  * 
+ * The string is held in one contiguous, null terminated buffer so it can
+ * be passed to WEB::send_data. The buffer grows geometrically, so a
+ * series of appends takes amortized constant time, and contents are
+ * moved with memmove. Lengths are used throughout, so the string may
+ * contain binary data including nulls.
+ * 
+ * The buffer may be an application supplied arena (for example static
+ * or on the stack). If the string outgrows the arena it is moved to the
+ * heap.
+ * 
+ * Space may be reserved in front of the string (headroom), like lwIP pbuf
+ * headroom, so that a protocol header can be inserted at the start by
+ * moving the start of the string back rather than moving the string.
+ * The string then does not start at the beginning of the allocated
+ * buffer, which is returned by base().
+ * 
  * There are also some specialized methods for std::string onjects
  */
 class TXT
 {
+public:
+    /**
+     * @class   Separators
+     * 
+     * Set of separator characters as a 256 bit table, so testing a
+     * character is a single lookup. Can be constructed at compile time:
+     * 
+     * @code
+     *    static constexpr TXT::Separators seps(",; ");
+     * @endcode
+     */
+    class Separators
+    {
+    private:
+        uint32_t    bits_[8];               // One bit per character
+
+    public:
+        constexpr Separators(const char *chars) : bits_()
+        {
+            for ( ; *chars; ++chars)
+            {
+                bits_[(uint8_t)*chars >> 5] |= 1u << ((uint8_t)*chars & 31);
+            }
+        }
+
+        /**
+         * @brief   Test if a character is a separator
+         */
+        bool contains(char c) const { return (bits_[(uint8_t)c >> 5] >> ((uint8_t)c & 31)) & 1; }
+    };
+
+    /**
+     * @class   Tokenizer
+     * 
+     * Returns the tokens of a string one at a time as views of the string,
+     * without allocation. Tokens are as for split: multiple adjacent
+     * separators each create a separate empty token.
+     */
+    class Tokenizer
+    {
+    private:
+        std::string_view    src_;           // String being split
+        const Separators    &seps_;         // Separator characters
+        std::size_t         pos_;           // Start of next token
+        bool                done_;          // Last token returned
+
+    public:
+        /**
+         * @brief   Constructor
+         * 
+         * @param   src     String to split (must remain valid while tokens are used)
+         * @param   seps    Separator characters (must remain valid while tokenizing)
+         */
+        Tokenizer(std::string_view src, const Separators &seps) : src_(src), seps_(seps), pos_(0), done_(false) {}
+
+        /**
+         * @brief   Get the next token
+         * 
+         * @param   token   Receives the token
+         * 
+         * @return  false if there are no more tokens
+         */
+        bool next(std::string_view &token);
+
+        /**
+         * @brief   Test if the last token has been returned
+         */
+        bool done() const { return done_; }
+
+        /**
+         * @brief   Return the rest of the string after the tokens returned
+         */
+        std::string_view rest() const { return done_ ? std::string_view() : src_.substr(pos_); }
+    };
+
+    /**
+     * @brief   Application buffer used by a TXT object
+     */
+    struct Arena
+    {
+        char        *buffer;                // Buffer pointer
+        uint32_t    size;                   // Buffer size
+    };
+
 private:
-    char            *buffer_;               // Buffer pointer
-    uint32_t        bufsiz_;                // Buffer size
+    char            *base_;                 // Allocated buffer
+    char            *buffer_;               // Start of string (after headroom)
+    uint32_t        bufsiz_;                // Allocated buffer size
     uint32_t        endptr_;                // End of data offset
+    bool            owned_;                 // Buffer allocated by TXT (not an arena)
 
+    void reserve(uint32_t size);
     char *expand(uint32_t offset, uint32_t amount);
     char *contract(uint32_t offset, uint32_t amount);
     
@@ -27,28 +132,41 @@ public:
     /**
      * @brief   Construct an empty TXT object
      */
-    TXT() : buffer_(nullptr), bufsiz_(0), endptr_(0) {}
+    TXT() : base_(nullptr), buffer_(nullptr), bufsiz_(0), endptr_(0), owned_(true) {}
 
     /**
      * @brief   Construct a TXT object with preallocated buffer
      * 
-     * @param   size    Size of preallocated buffer
+     * @param   size        Size of preallocated buffer
+     * @param   headroom    Space reserved in front of the string
+     */
+    TXT(uint32_t size, uint32_t headroom = 0);
+
+    /**
+     * @brief   Construct an empty TXT object in an application buffer
+     * 
+     * @param   arena       Buffer, which must remain valid while used by the TXT object
+     * @param   headroom    Space reserved in front of the string (within the arena)
      */
-    TXT(uint32_t size) : buffer_(new char[size]), bufsiz_(size), endptr_(0) { if (size > 0) *buffer_ = 0; }
+    TXT(const Arena &arena, uint32_t headroom = 0);
 
     /**
      * @brief   Construct a TXT object with an initial string
      * 
-     * @param   data    Pointr to initial string
-     * @param   datalen Length of initial string
-     * @param   size    Initial size of data buffer (if larger than datalen)
+     * @param   data        Pointr to initial string
+     * @param   datalen     Length of initial string
+     * @param   size        Initial size of data buffer (if larger than datalen)
+     * @param   headroom    Space reserved in front of the string
      */
-    TXT(const char *data, uint32_t datalen, uint32_t size=0);
+    TXT(const char *data, uint32_t datalen, uint32_t size=0, uint32_t headroom=0);
 
     /**
      * @brief   Destructor
      */
-    ~TXT() { if (buffer_) delete [] buffer_; }
+    ~TXT() { if (owned_) delete [] base_; }
+
+    TXT(const TXT &) = delete;
+    TXT &operator=(const TXT &) = delete;
 
     /**
      * @brief   Return pointer to string
@@ -61,18 +179,38 @@ public:
      */
     uint32_t datasize() const { return endptr_; }
 
+    /**
+     * @brief   Return the space free in front of the string
+     */
+    uint32_t headroom() const { return buffer_ - base_; }
+
+    /**
+     * @brief   Return pointer to the allocated buffer, which contains the
+     *          headroom followed by the string
+     */
+    char *base() { return base_; }
+
     /**
      * @brief   Release ownership of string
      * 
      * This method resets the TXT object to empty but does not release the
      * buffer allocated to contain the string. The string should have been
      * accessed by the data() method before calling this method and it is
-     * then the responsibilty of the application to delete[] it.  This is
+     * then the responsibilty of the application to delete[] the buffer,
+     * given by base() (the same as data() if there is no headroom).  This is
      * useful with the WEB class's send_data() method thth the Allocation
      * parametr set to WEB::PREALL where that class will free the buffer
-     * after it has been sent
+     * after it has been sent (see also WEB::send_data for a TXT).
+     * 
+     * A string in an arena (see in_arena) remains in the application's
+     * buffer, which must not be deleted.
      */
-    void release() { buffer_ = nullptr; bufsiz_ = 0; endptr_ = 0; }
+    void release() { base_ = nullptr; buffer_ = nullptr; bufsiz_ = 0; endptr_ = 0; owned_ = true; }
+
+    /**
+     * @brief   Test if the string is in the application buffer
+     */
+    bool in_arena() const { return !owned_; }
 
     /**
      * @brief   Assign new value to the string
@@ -86,14 +224,25 @@ public:
     TXT &operator +=(const char *append);
     TXT &operator +=(const std::string &append);
 
+    /**
+     * @brief   Append data which may contain nulls
+     * 
+     * @param   data    Pointer to data
+     * @param   len     Number of bytes
+     */
+    TXT &append(const char *data, uint32_t len);
+
     /**
      * @brief   Find a substring
      * 
      * @param   str     Substring to be found
+     * @param   len     Length of substring
+     * @param   from    Offset to start search
      * 
      * @return  Offset in string or std::string::npos if not found
      */
-    uint32_t find(const char *str) const;
+    uint32_t find(const char *str) const { return find(str, strlen(str)); }
+    uint32_t find(const char *str, uint32_t len, uint32_t from = 0) const;
 
     /**
      * @brief   Insert substring
@@ -102,6 +251,9 @@ public:
      * @param   str     String to be inserted
      * @param   len     Length of string (use strlen(str) if zero)
      * 
+     * @details If there is enough headroom, the part of the string before
+     *          the offset is moved back rather than the part after it.
+     * 
      * @return  Offset to next character after end of inserted string
      */
     uint32_t insert(uint32_t offset, const char *str, size_t len=0);
@@ -142,6 +294,22 @@ public:
      */
     static void split(const std::string &src, const std::string &separators, std::vector<std::string> &tokens);
 
+    /**
+     * @brief   Split string into an array of tokens without allocation
+     * 
+     * @param   src         Source string to be split
+     * @param   separators  Separator characters
+     * @param   tokens      Array to receive views of the substrings
+     * @param   max         Size of array
+     * 
+     * Multiple adjacent separators each create a separate empty token. If
+     * there are more than max tokens, the last contains the rest of the
+     * source string.
+     * 
+     * @return  Number of tokens
+     */
+    static int split(std::string_view src, const Separators &separators, std::string_view *tokens, int max);
+
     /**
      * @brief   Join tokens into a string
      * 
@@ -152,6 +320,16 @@ public:
      */
     static std::string join(const std::vector<std::string> &tokens, const std::string &separator);
 
+    /**
+     * @brief   Join tokens, appending them to a TXT object
+     * 
+     * @param   out         TXT object receiving the tokens
+     * @param   tokens      Array of tokens
+     * @param   count       Number of tokens
+     * @param   separator   String to be inserted between tokens
+     */
+    static void join(TXT &out, const std::string_view *tokens, int count, std::string_view separator);
+
     /**
      * @brief   Trim whitespace from end of string in place
      */